@@ -0,0 +1,211 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <charconv>
+
+#include "directdb.hpp"
+
+using namespace std;
+
+namespace ddb {
+
+// -------------------------------------------------------------------------------------------------
+// Strings are always quoted. Backslash escapes are understood by both PostgreSQL and JSON.
+static void
+quoteString(const string& value, bool json, string& out)
+{
+    out += '"';
+    for (char ch : value) {
+        if (ch == '"' || ch == '\\') {
+            out += '\\';
+            out += ch;
+        } else if (json && (unsigned char)ch < 0x20) {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\u%04x", ch);
+            out += buffer;
+        } else
+            out += ch;
+    }
+    out += '"';
+}
+
+void
+FormatArray(DT type, const void* values, bool json, string& out)
+{
+    char buffer[64];
+    out += json ? '[' : '{';
+    size_t count = 0;
+    switch (type) {
+    case DT::VEC_LONG:
+        for (long value : *(const vector<long>*)values) {
+            if (count++)
+                out += ',';
+            out.append(buffer, to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+        }
+        break;
+    case DT::VEC_NUM:
+        for (double value : *(const vector<double>*)values) {
+            if (count++)
+                out += ',';
+            out.append(buffer, to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+        }
+        break;
+    case DT::VEC_STR:
+        for (const string& value : *(const vector<string>*)values) {
+            if (count++)
+                out += ',';
+            quoteString(value, json, out);
+        }
+        break;
+    default:
+        break;
+    }
+    out += json ? ']' : '}';
+}
+
+// -------------------------------------------------------------------------------------------------
+// Reads the four hex digits of a JSON \u escape. Fails at the end of the text.
+static bool
+readHex4(const char* text, unsigned int& code)
+{
+    code = 0;
+    for (int ndx = 0; ndx < 4; ndx++) {
+        char ch = text[ndx];
+        unsigned int digit;
+        if (ch >= '0' && ch <= '9')
+            digit = ch - '0';
+        else if (ch >= 'a' && ch <= 'f')
+            digit = ch - 'a' + 10;
+        else if (ch >= 'A' && ch <= 'F')
+            digit = ch - 'A' + 10;
+        else
+            return false;
+        code = code * 16 + digit;
+    }
+    return true;
+}
+
+static void
+appendUtf8(string& out, unsigned int code)
+{
+    if (code < 0x80)
+        out += (char)code;
+    else if (code < 0x800) {
+        out += (char)(0xc0 | code >> 6);
+        out += (char)(0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+        out += (char)(0xe0 | code >> 12);
+        out += (char)(0x80 | (code >> 6 & 0x3f));
+        out += (char)(0x80 | (code & 0x3f));
+    } else {
+        out += (char)(0xf0 | code >> 18);
+        out += (char)(0x80 | (code >> 12 & 0x3f));
+        out += (char)(0x80 | (code >> 6 & 0x3f));
+        out += (char)(0x80 | (code & 0x3f));
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+ParseArray(DT type, const char* text, void* values)
+/*!
+  Accepts the PostgreSQL array text and JSON arrays of one dimension.
+  \retval bool False if the text is not an array. Vector has the elements parsed so far.
+*/
+{
+    vector<long>* longs = (vector<long>*)values;
+    vector<double>* nums = (vector<double>*)values;
+    vector<string>* strs = (vector<string>*)values;
+    switch (type) {
+    case DT::VEC_LONG:
+        longs->clear();
+        break;
+    case DT::VEC_NUM:
+        nums->clear();
+        break;
+    case DT::VEC_STR:
+        strs->clear();
+        break;
+    default:
+        return false;
+    }
+    while (*text == ' ')
+        text++;
+    char close = *text == '[' ? ']' : '}';
+    if (*text != '[' && *text != '{')
+        return false;
+    text++;
+    string element;
+    for (size_t count = 0;; count++) {
+        while (*text == ' ')
+            text++;
+        if (!count && *text == close)
+            return true;
+        element.clear();
+        bool quoted = *text == '"';
+        if (quoted) {
+            for (text++; *text && *text != '"'; text++) {
+                if (*text == '\\' && text[1]) {
+                    text++;
+                    if (*text == 'u' && close == ']') {
+                        unsigned int code, low;
+                        if (!readHex4(text + 1, code))
+                            return false;
+                        text += 4;
+                        // Characters outside the BMP come as UTF-16 surrogate pairs.
+                        if (code >= 0xd800 && code < 0xdc00 && text[1] == '\\' && text[2] == 'u'
+                            && readHex4(text + 3, low) && low >= 0xdc00 && low < 0xe000) {
+                            code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                            text += 6;
+                        }
+                        appendUtf8(element, code);
+                        continue;
+                    }
+                    if (close == ']' && (*text == 'n' || *text == 't' || *text == 'r')) {
+                        element += *text == 'n' ? '\n' : *text == 't' ? '\t' : '\r';
+                        continue;
+                    }
+                }
+                element += *text;
+            }
+            if (*text != '"')
+                return false;
+            text++;
+        } else {
+            for (; *text && *text != ',' && *text != close; text++)
+                element += *text;
+            while (!element.empty() && element.back() == ' ')
+                element.pop_back();
+        }
+        bool is_null = !quoted && (element == "NULL" || element == "null");
+        switch (type) {
+        case DT::VEC_LONG:
+            longs->push_back(is_null ? 0 : strtol(element.c_str(), 0, 10));
+            break;
+        case DT::VEC_NUM:
+            nums->push_back(is_null ? 0 : strtod(element.c_str(), 0));
+            break;
+        default:
+            if (is_null)
+                element.clear();
+            strs->push_back(element);
+        }
+        while (*text == ' ')
+            text++;
+        if (*text == close)
+            return true;
+        if (*text != ',')
+            return false;
+        text++;
+    }
+}
+
+}; // namespace ddb
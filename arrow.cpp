@@ -0,0 +1,512 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "directdb.hpp"
+
+using namespace std;
+
+namespace ddb {
+
+// -------------------------------------------------------------------------------------------------
+// Minimal FlatBuffers writer for the Arrow metadata. Objects are written front to back: a table
+// is written before the strings, vectors and tables it refers to so that the offsets point
+// forward as the format requires. Vtables are written right before their tables.
+class FlatBuffer
+{
+  public:
+    struct Slot
+    {
+        int id;         //!< Field id in the schema, i.e. the vtable index.
+        size_t size;    //!< Value size in bytes. Offsets to other objects are 4 bytes.
+        uint64_t value; //!< Scalar value. Offsets are linked after the table is written.
+        size_t pos;     //!< Set by table: position of the value in data.
+    };
+
+    FlatBuffer() { put<uint32_t>(0); } // Root table offset, linked later.
+
+    template <class T>
+    void put(T value)
+    {
+        data.append((const char*)&value, sizeof(value));
+    }
+    void align(size_t size) { data.append((size - data.size() % size) % size, '\0'); }
+    //! Sets the offset at 'field' to point to 'target'.
+    void link(size_t field, size_t target)
+    {
+        uint32_t offset = target - field;
+        memcpy(&data[field], &offset, sizeof(offset));
+    }
+    size_t table(vector<Slot>& slots);
+    size_t text(const string& value);
+    //! Vector of offsets. Element n is at the returned position + 4 + 4 * n.
+    size_t offsets(size_t count);
+    //! Vector of 8 byte aligned structs.
+    size_t structs(const void* items, size_t count, size_t size);
+
+    string data;
+};
+
+size_t
+FlatBuffer::table(vector<Slot>& slots)
+/*!
+  Fields are placed largest first so that they stay aligned with little padding.
+  \retval size_t Position of the table.
+*/
+{
+    vector<Slot*> order;
+    for (Slot& slot : slots)
+        order.push_back(&slot);
+    stable_sort(order.begin(), order.end(), [](Slot* a, Slot* b) { return a->size > b->size; });
+    size_t inline_size = sizeof(int32_t), max_align = sizeof(int32_t);
+    int fields = 0;
+    for (Slot* slot : order) {
+        inline_size = (inline_size + slot->size - 1) / slot->size * slot->size;
+        slot->pos = inline_size;
+        inline_size += slot->size;
+        max_align = max(max_align, slot->size);
+        fields = max(fields, slot->id + 1);
+    }
+    align(2);
+    size_t vtable = data.size();
+    put<uint16_t>(4 + 2 * fields);
+    put<uint16_t>(inline_size);
+    for (int id = 0; id < fields; id++) {
+        uint16_t pos = 0;
+        for (Slot& slot : slots) {
+            if (slot.id == id)
+                pos = slot.pos;
+        }
+        put<uint16_t>(pos);
+    }
+    align(max_align);
+    size_t table = data.size();
+    put<int32_t>(table - vtable);
+    data.resize(table + inline_size, '\0');
+    for (Slot& slot : slots) {
+        memcpy(&data[table + slot.pos], &slot.value, slot.size);
+        slot.pos += table;
+    }
+    return table;
+}
+size_t
+FlatBuffer::text(const string& value)
+{
+    align(4);
+    size_t pos = data.size();
+    put<uint32_t>(value.size());
+    data.append(value.c_str(), value.size() + 1);
+    return pos;
+}
+size_t
+FlatBuffer::offsets(size_t count)
+{
+    align(4);
+    size_t pos = data.size();
+    put<uint32_t>(count);
+    data.append(4 * count, '\0');
+    return pos;
+}
+size_t
+FlatBuffer::structs(const void* items, size_t count, size_t size)
+{
+    while ((data.size() + 4) % 8)
+        data += '\0';
+    size_t pos = data.size();
+    put<uint32_t>(count);
+    if (count)
+        data.append((const char*)items, count * size);
+    return pos;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Arrow format constants (Schema.fbs, Message.fbs and File.fbs).
+const uint16_t METADATA_V5 = 4;
+const uint8_t HEADER_SCHEMA = 1;
+const uint8_t HEADER_RECORD_BATCH = 3;
+const uint8_t TYPE_INT = 2;
+const uint8_t TYPE_FLOAT = 3;
+const uint8_t TYPE_UTF8 = 5;
+const uint8_t TYPE_BOOL = 6;
+const uint8_t TYPE_DATE = 8;
+const uint8_t TYPE_TIMESTAMP = 10;
+const uint16_t PRECISION_DOUBLE = 2;
+const uint16_t DATE_DAY = 0;
+const uint16_t TIME_SECOND = 0;
+
+struct FieldNode
+{
+    int64_t length;
+    int64_t null_count;
+};
+struct BufferRef
+{
+    int64_t offset;
+    int64_t length;
+};
+struct Block
+{
+    int64_t offset;
+    int32_t meta_length;
+    int32_t padding;
+    int64_t body_length;
+};
+
+static uint8_t
+arrowType(DT type)
+{
+    switch (type) {
+    case DT::INT:
+    case DT::LONG:
+        return TYPE_INT;
+    case DT::NUM:
+        return TYPE_FLOAT;
+    case DT::STR:
+        return TYPE_UTF8;
+    case DT::BOOL:
+        return TYPE_BOOL;
+    case DT::DAY:
+        return TYPE_DATE;
+    case DT::TIME:
+        return TYPE_TIMESTAMP;
+    default:
+        return 0;
+    }
+}
+
+static size_t
+typeTable(FlatBuffer& fb, DT type)
+{
+    vector<FlatBuffer::Slot> slots;
+    switch (type) {
+    case DT::INT:
+        slots = { { 0, 4, 32, 0 }, { 1, 1, 1, 0 } }; // bitWidth, is_signed
+        break;
+    case DT::LONG:
+        slots = { { 0, 4, 64, 0 }, { 1, 1, 1, 0 } };
+        break;
+    case DT::NUM:
+        slots = { { 0, 2, PRECISION_DOUBLE, 0 } };
+        break;
+    case DT::DAY:
+        slots = { { 0, 2, DATE_DAY, 0 } };
+        break;
+    case DT::TIME:
+        slots = { { 0, 2, TIME_SECOND, 0 } }; // No time zone
+        break;
+    default:
+        break;
+    }
+    return fb.table(slots);
+}
+
+static size_t
+schemaTable(FlatBuffer& fb, const vector<DT>& types, const vector<string>& names)
+{
+    vector<FlatBuffer::Slot> schema = { { 1, 4, 0, 0 } }; // fields
+    size_t pos = fb.table(schema);
+    size_t fields = fb.offsets(types.size());
+    fb.link(schema[0].pos, fields);
+    for (size_t col = 0; col < types.size(); col++) {
+        // name, nullable, type_type, type, children
+        vector<FlatBuffer::Slot> field = { { 0, 4, 0, 0 },
+                                           { 1, 1, 1, 0 },
+                                           { 2, 1, arrowType(types[col]), 0 },
+                                           { 3, 4, 0, 0 },
+                                           { 5, 4, 0, 0 } };
+        fb.link(fields + 4 + 4 * col, fb.table(field));
+        fb.link(field[0].pos, fb.text(names[col]));
+        fb.link(field[3].pos, typeTable(fb, types[col]));
+        fb.link(field[4].pos, fb.offsets(0));
+    }
+    return pos;
+}
+
+// Returns the position of the header offset.
+static size_t
+messageTable(FlatBuffer& fb, uint8_t header_type, int64_t body_length)
+{
+    // version, header_type, header, bodyLength
+    vector<FlatBuffer::Slot> message = { { 0, 2, METADATA_V5, 0 },
+                                         { 1, 1, header_type, 0 },
+                                         { 2, 4, 0, 0 },
+                                         { 3, 8, (uint64_t)body_length, 0 } };
+    fb.link(0, fb.table(message));
+    return message[2].pos;
+}
+
+// Encapsulated message: continuation marker, metadata size, metadata padded to 8 and the body.
+static Block
+writeMessage(ostream& out, size_t& written, const string& meta, const string& body)
+{
+    static const char zeros[8] = { 0 };
+    uint32_t marker = 0xFFFFFFFF;
+    int32_t size = (meta.size() + 7) / 8 * 8;
+    out.write((const char*)&marker, sizeof(marker));
+    out.write((const char*)&size, sizeof(size));
+    out.write(meta.data(), meta.size());
+    out.write(zeros, size - meta.size());
+    out.write(body.data(), body.size());
+    Block block = { (int64_t)written, 8 + size, 0, (int64_t)body.size() };
+    written += 8 + size + body.size();
+    return block;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Values of one column in the current batch.
+struct ArrowColumn
+{
+    DT type;
+    string validity;
+    string values;           //!< Fixed width values, bits for bool or the utf8 bytes.
+    vector<int32_t> offsets; //!< Utf8 value offsets.
+    size_t nulls;
+
+    void clear()
+    {
+        validity.clear();
+        values.clear();
+        offsets.assign(1, 0);
+        nulls = 0;
+    }
+    void append(size_t row, const void* value, bool is_null);
+};
+
+// Days from 1970-01-01. Valid for all Gregorian dates (H. Hinnant's days_from_civil).
+static int64_t
+epochDays(const tm& date)
+{
+    int64_t year = date.tm_year + 1900;
+    int64_t month = date.tm_mon + 1;
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yoe = year - era * 400;
+    int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + date.tm_mday - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void
+ArrowColumn::append(size_t row, const void* value, bool is_null)
+{
+    if (!value)
+        is_null = true;
+    if (row % 8 == 0) {
+        validity += '\0';
+        if (type == DT::BOOL)
+            values += '\0';
+    }
+    if (is_null)
+        nulls++;
+    else
+        validity.back() |= 1 << (row % 8);
+    switch (type) {
+    case DT::INT: {
+        int32_t number = is_null ? 0 : *(const int*)value;
+        values.append((const char*)&number, sizeof(number));
+        break;
+    }
+    case DT::LONG: {
+        int64_t number = is_null ? 0 : *(const long*)value;
+        values.append((const char*)&number, sizeof(number));
+        break;
+    }
+    case DT::NUM: {
+        double number = is_null ? 0 : *(const double*)value;
+        values.append((const char*)&number, sizeof(number));
+        break;
+    }
+    case DT::BOOL:
+        if (!is_null && *(const bool*)value)
+            values.back() |= 1 << (row % 8);
+        break;
+    case DT::STR:
+        if (!is_null)
+            values += *(const string*)value;
+        offsets.push_back(values.size());
+        break;
+    case DT::DAY: {
+        int32_t days = is_null ? 0 : epochDays(*(const tm*)value);
+        values.append((const char*)&days, sizeof(days));
+        break;
+    }
+    case DT::TIME: {
+        int64_t seconds = 0;
+        if (!is_null) {
+            const tm* stamp = (const tm*)value;
+            seconds = epochDays(*stamp) * 86400 + stamp->tm_hour * 3600 + stamp->tm_min * 60
+                      + stamp->tm_sec;
+        }
+        values.append((const char*)&seconds, sizeof(seconds));
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// Buffers are padded to 8 bytes in the body.
+static void
+addBuffer(string& body, vector<BufferRef>& buffers, const void* data, size_t length)
+{
+    buffers.push_back(BufferRef{ (int64_t)body.size(), (int64_t)length });
+    body.append((const char*)data, length);
+    body.append((8 - body.size() % 8) % 8, '\0');
+}
+
+static Block
+writeBatch(ostream& out, size_t& written, vector<ArrowColumn>& columns, size_t rows)
+{
+    string body;
+    vector<FieldNode> nodes;
+    vector<BufferRef> buffers;
+    for (ArrowColumn& column : columns) {
+        nodes.push_back(FieldNode{ (int64_t)rows, (int64_t)column.nulls });
+        // Validity bitmap can be left out when there are no NULLs.
+        addBuffer(body, buffers, column.validity.data(), column.nulls ? column.validity.size() : 0);
+        if (column.type == DT::STR)
+            addBuffer(body, buffers, column.offsets.data(), column.offsets.size() * 4);
+        addBuffer(body, buffers, column.values.data(), column.values.size());
+    }
+    FlatBuffer fb;
+    size_t header = messageTable(fb, HEADER_RECORD_BATCH, body.size());
+    // length, nodes, buffers
+    vector<FlatBuffer::Slot> batch = { { 0, 8, rows, 0 }, { 1, 4, 0, 0 }, { 2, 4, 0, 0 } };
+    fb.link(header, fb.table(batch));
+    fb.link(batch[1].pos, fb.structs(nodes.data(), nodes.size(), sizeof(FieldNode)));
+    fb.link(batch[2].pos, fb.structs(buffers.data(), buffers.size(), sizeof(BufferRef)));
+    for (ArrowColumn& column : columns)
+        column.clear();
+    return writeMessage(out, written, fb.data, body);
+}
+
+// -------------------------------------------------------------------------------------------------
+long
+ArrowExporter::Export(RowSet* rs, ostream& out, FORMAT format)
+{
+    static const char magic[8] = { 'A', 'R', 'R', 'O', 'W', '1', 0, 0 };
+    // Utf8 offsets are 32 bits. Batch is written early if the strings grow large.
+    const size_t max_text = 0x40000000;
+
+    last_error.clear();
+    vector<DT> types;
+    vector<string> columns;
+    for (BoundField* field = rs->fieldRoot; field; field = field->next) {
+        if (!arrowType(field->type)) {
+            last_error = "Export - type of column " + to_string(types.size() + 1)
+                         + " is not supported.";
+            return -1;
+        }
+        types.push_back(field->type);
+        columns.push_back(types.size() <= names.size() ? names[types.size() - 1]
+                                                       : "f" + to_string(types.size() - 1));
+    }
+    if (types.empty()) {
+        last_error = "Export called without bound variables.";
+        return -1;
+    }
+    if (!rs->Query()) {
+        last_error = "Export - query failed. See the database error.";
+        return -1;
+    }
+
+    size_t written = 0;
+    if (format == IPC_FILE) {
+        out.write(magic, sizeof(magic));
+        written = sizeof(magic);
+    }
+    FlatBuffer schema;
+    size_t header = messageTable(schema, HEADER_SCHEMA, 0);
+    schema.link(header, schemaTable(schema, types, columns));
+    writeMessage(out, written, schema.data, string());
+
+    vector<ArrowColumn> batch(types.size());
+    for (size_t col = 0; col < types.size(); col++) {
+        batch[col].type = types[col];
+        batch[col].clear();
+    }
+    vector<Block> blocks;
+    size_t rows = 0;
+    long total = 0;
+    while (rs->GetNext() > 0) {
+        size_t col = 0;
+        bool full = ++rows == batch_rows;
+        for (BoundField* field = rs->fieldRoot; field; field = field->next, col++) {
+            bool is_null;
+            const void* value = field->Source(is_null);
+            batch[col].append(rows - 1, value, is_null);
+            full = full || batch[col].values.size() > max_text;
+        }
+        total++;
+        if (full) {
+            blocks.push_back(writeBatch(out, written, batch, rows));
+            rows = 0;
+        }
+    }
+    bool failed = rs->IsFailed();
+    rs->Reset();
+    // End of stream and footer are not written so that a reader does not take the rows written
+    // so far for the whole result.
+    if (failed) {
+        last_error = "Export - reading the rows failed. See the database error.";
+        return -1;
+    }
+    if (rows)
+        blocks.push_back(writeBatch(out, written, batch, rows));
+    // End of stream marker.
+    uint32_t eos[2] = { 0xFFFFFFFF, 0 };
+    out.write((const char*)eos, sizeof(eos));
+
+    if (format == IPC_FILE) {
+        // version, schema, dictionaries, recordBatches
+        FlatBuffer footer;
+        vector<FlatBuffer::Slot> slots = { { 0, 2, METADATA_V5, 0 },
+                                           { 1, 4, 0, 0 },
+                                           { 2, 4, 0, 0 },
+                                           { 3, 4, 0, 0 } };
+        footer.link(0, footer.table(slots));
+        footer.link(slots[1].pos, schemaTable(footer, types, columns));
+        footer.link(slots[2].pos, footer.structs(0, 0, sizeof(Block)));
+        footer.link(slots[3].pos, footer.structs(blocks.data(), blocks.size(), sizeof(Block)));
+        int32_t size = footer.data.size();
+        out.write(footer.data.data(), size);
+        out.write((const char*)&size, sizeof(size));
+        out.write(magic, 6);
+    }
+    if (!out) {
+        last_error = "Export - write failed.";
+        return -1;
+    }
+    return total;
+}
+
+// -------------------------------------------------------------------------------------------------
+long
+ArrowExporter::Export(RowSet* rs, const char* path, FORMAT format)
+{
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out) {
+        last_error = "Export - unable to open ";
+        last_error += path;
+        return -1;
+    }
+    long rv = Export(rs, out, format);
+    out.close();
+    if (rv >= 0 && !out) {
+        last_error = "Export - write failed.";
+        rv = -1;
+    }
+    if (rv < 0)
+        remove(path);
+    return rv;
+}
+
+}; // namespace ddb
@@ -29,7 +29,7 @@ Build()
     make.add_comp("-Wno-ctor-dtor-privacy -Wnon-virtual-dtor -I/usr/local/include/cpp4scripts "
                   "-I/usr/include/postgresql "
                   "-I/usr/local/include/sqlite3");
-    make.add_comp("-fno-rtti");
+    make.add_comp("-fno-rtti -std=c++17");
     if (args.is_set("-deb"))
         make.add_comp("-DC4S_LOG_LEVEL=1");
     else
@@ -37,6 +37,23 @@ Build()
     return make.build();
 }
 // -------------------------------------------------------------------------------------------------
+BUILD_STATUS
+BuildBench()
+{
+    path_list sources;
+    sources += path("ddbtest/bench.cxx");
+    builder_gcc make(&sources, "ddbbench", &cout);
+    make.set(BUILD::BIN);
+    make.add(args.is_set("-deb") ? BUILD::DEB : BUILD::REL);
+    if (args.is_set("-V"))
+        make.add(BUILD::VERBOSE);
+    make.add_comp("-I/usr/local/include -I/usr/include/postgresql -I/usr/local/include/sqlite3");
+    make.add_comp("-fno-rtti -std=c++17 -pthread");
+    make.add_link(args.is_set("-deb") ? "-L./debug" : "-L./release");
+    make.add_link("-L/usr/local/lib/sqlite3 -ldirectdb -lc4s -lsqlite3 -lpq -pthread");
+    return make.build();
+}
+// -------------------------------------------------------------------------------------------------
 int
 Clean()
 {
@@ -96,6 +113,7 @@ main(int argc, char** argv)
     args += argument("-V", false, "Enable verbose build mode");
     args += argument("-install", true, "Install library to given root.");
     args += argument("-clean", false, "Clean up build files.");
+    args += argument("-bench", false, "Build the ddbbench benchmark program. Build library first.");
 
     cout << "Direct Database Library build v 2.0\n";
     try {
@@ -113,7 +131,7 @@ main(int argc, char** argv)
         return Install();
 
     try {
-        rv = Build();
+        rv = args.is_set("-bench") ? BuildBench() : Build();
     } catch (const c4s_exception& ce) {
         cout << "Build failed: " << ce.what() << '\n';
     }
@@ -30,7 +30,7 @@ Build()
     make.add_comp("-Wno-ctor-dtor-privacy -Wnon-virtual-dtor -I/usr/local/include/cpp4scripts "
                   "-I/usr/include/postgresql "
                   "-I/usr/local/include/sqlite3");
-    make.add_comp("-fno-rtti");
+    make.add_comp("-fno-rtti -std=c++17");
     if (args.is_set("-deb"))
         make.add_comp("-DC4S_LOG_LEVEL=1");
     else
@@ -0,0 +1,143 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <charconv>
+
+#include "directdb.hpp"
+
+using namespace std;
+
+namespace ddb {
+
+// -------------------------------------------------------------------------------------------------
+bool
+BulkParams::Bind(DT type, const void* data, size_t count)
+/*!
+  Adds a parameter column.
+  \param type Type of the array elements.
+  \param data Pointer to the first element.
+  \param count Number of elements, i.e. rows.
+  \retval bool False if the row count differs from the earlier columns or data is missing.
+*/
+{
+    if (!data && count)
+        return false;
+    if (!columns.empty() && count != rows)
+        return false;
+    columns.push_back(Column{ type, data });
+    rows = count;
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+BulkParams::FormatText(size_t row, size_t col, string& out) const
+{
+    char buffer[64];
+    char* end = buffer;
+    const Column& column = columns[col];
+    switch (column.type) {
+    case DT::INT:
+        end = to_chars(buffer, buffer + sizeof(buffer), ((const int*)column.data)[row]).ptr;
+        break;
+    case DT::LONG:
+        end = to_chars(buffer, buffer + sizeof(buffer), ((const long*)column.data)[row]).ptr;
+        break;
+    case DT::NUM:
+        end = to_chars(buffer, buffer + sizeof(buffer), ((const double*)column.data)[row]).ptr;
+        break;
+    case DT::STR: {
+        const string& str = static_cast<const string*>(column.data)[row];
+        out.append(str.c_str(), str.size() + 1);
+        return;
+    }
+    case DT::BOOL:
+        *end++ = static_cast<const bool*>(column.data)[row] ? 't' : 'f';
+        break;
+    case DT::TIME:
+    case DT::DAY: {
+        const tm& t = static_cast<const tm*>(column.data)[row];
+        if (column.type == DT::DAY)
+            end += snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", t.tm_year + 1900,
+                            t.tm_mon + 1, t.tm_mday);
+        else
+            end += snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d",
+                            t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min,
+                            t.tm_sec);
+        break;
+    }
+    case DT::CHR:
+    case DT::BIT:
+        *end++ = static_cast<const char*>(column.data)[row];
+        break;
+    case DT::BLOB: {
+        // PostgreSQL bytea hex format.
+        static const char hex[] = "0123456789abcdef";
+        const Blob& blob = static_cast<const Blob*>(column.data)[row];
+        out += "\\x";
+        for (unsigned char byte : blob) {
+            out += hex[byte >> 4];
+            out += hex[byte & 0xf];
+        }
+        out += '\0';
+        return;
+    }
+    case DT::DEC:
+        end = static_cast<const Decimal*>(column.data)[row].Format(buffer);
+        break;
+    case DT::VEC_LONG:
+        FormatArray(column.type, static_cast<const vector<long>*>(column.data) + row, false, out);
+        out += '\0';
+        return;
+    case DT::VEC_NUM:
+        FormatArray(column.type, static_cast<const vector<double>*>(column.data) + row, false,
+                    out);
+        out += '\0';
+        return;
+    case DT::VEC_STR:
+        FormatArray(column.type, static_cast<const vector<string>*>(column.data) + row, false,
+                    out);
+        out += '\0';
+        return;
+    }
+    *end++ = 0;
+    out.append(buffer, end - buffer);
+}
+
+// -------------------------------------------------------------------------------------------------
+int
+Database::ExecuteBulk(const string&, const BulkParams&, vector<int>*)
+{
+    SetLastError("ExecuteBulk is not supported by this database.");
+    return -1;
+}
+int
+Database::ExecuteBulkInsert(const string&, const BulkParams&, const char*, vector<long long>&)
+{
+    SetLastError("ExecuteBulkInsert is not supported by this database.");
+    return -1;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+Database::ExecuteInsert(const string& insert, const char*, vector<long long>& ids)
+/*!
+  Default for databases without RETURNING. Gives only the id of the last inserted row.
+*/
+{
+    ids.clear();
+    if (ExecuteModify(insert) < 0)
+        return false;
+    ids.push_back((long long)GetInsertId());
+    return true;
+}
+
+}; // namespace ddb
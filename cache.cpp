@@ -0,0 +1,576 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <string.h>
+#include <time.h>
+#include <functional>
+
+#include "directdb.hpp"
+
+using namespace std;
+
+namespace ddb {
+
+// Bookkeeping overhead of one entry in addition to the key and data.
+const size_t CACHE_ENTRY_OVERHEAD = 160;
+
+// -------------------------------------------------------------------------------------------------
+ResultCache::ResultCache(size_t max_bytes, unsigned int ttl_ms, unsigned int shard_count_in)
+{
+    shard_count = shard_count_in ? shard_count_in : 1;
+    shards.reset(new Shard[shard_count]);
+    for (unsigned int ndx = 0; ndx < shard_count; ndx++) {
+        shards[ndx].bytes = 0;
+        memset(&shards[ndx].stats, 0, sizeof(Stats));
+    }
+    shard_bytes = max_bytes / shard_count;
+    default_ttl = ttl_ms;
+}
+
+// -------------------------------------------------------------------------------------------------
+ResultCache::Shard&
+ResultCache::shardOf(const string& key)
+{
+    return shards[hash<string>()(key) % shard_count];
+}
+void
+ResultCache::erase(Shard& shard, list<Entry>::iterator it)
+{
+    shard.bytes -= it->bytes;
+    shard.index.erase(string_view(it->key));
+    for (const string& tag : it->tags) {
+        auto keys = shard.tagged.find(tag);
+        if (keys == shard.tagged.end())
+            continue;
+        keys->second.erase(string_view(it->key));
+        if (keys->second.empty())
+            shard.tagged.erase(keys);
+    }
+    shard.lru.erase(it);
+}
+
+// -------------------------------------------------------------------------------------------------
+ResultCache::Data
+ResultCache::Get(const string& key)
+{
+    Shard& shard = shardOf(key);
+    lock_guard<mutex> lock(shard.mutex);
+    auto found = shard.index.find(string_view(key));
+    if (found == shard.index.end()) {
+        shard.stats.misses++;
+        return Data();
+    }
+    auto it = found->second;
+    if (it->expires <= chrono::steady_clock::now()) {
+        erase(shard, it);
+        shard.stats.expired++;
+        shard.stats.misses++;
+        return Data();
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it);
+    shard.stats.hits++;
+    return it->data;
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+ResultCache::Put(const string& key, Data data, unsigned int ttl_ms, const char* tags)
+/*!
+  Entries larger than the shard's share of the memory cap are not stored.
+*/
+{
+    Entry entry;
+    entry.bytes = key.size() + data->size() + CACHE_ENTRY_OVERHEAD;
+    if (entry.bytes > shard_bytes)
+        return;
+    entry.key = key;
+    entry.data = data;
+    entry.expires =
+        chrono::steady_clock::now() + chrono::milliseconds(ttl_ms ? ttl_ms : default_ttl);
+    for (const char* tag = tags; tag && *tag;) {
+        while (*tag == ',' || *tag == ' ')
+            tag++;
+        const char* end = tag;
+        while (*end && *end != ',' && *end != ' ')
+            end++;
+        if (end > tag) {
+            entry.tags.emplace_back(tag, end - tag);
+            entry.bytes += end - tag;
+        }
+        tag = end;
+    }
+
+    Shard& shard = shardOf(key);
+    lock_guard<mutex> lock(shard.mutex);
+    auto found = shard.index.find(string_view(key));
+    if (found != shard.index.end())
+        erase(shard, found->second);
+    while (shard.bytes + entry.bytes > shard_bytes && !shard.lru.empty()) {
+        erase(shard, prev(shard.lru.end()));
+        shard.stats.evictions++;
+    }
+    shard.bytes += entry.bytes;
+    shard.lru.push_front(move(entry));
+    string_view stored(shard.lru.front().key);
+    shard.index[stored] = shard.lru.begin();
+    for (const string& tag : shard.lru.front().tags)
+        shard.tagged[tag].insert(stored);
+}
+
+// -------------------------------------------------------------------------------------------------
+size_t
+ResultCache::Invalidate(const char* tag)
+/*!
+  Entries are found by the shards' tag indexes. Each shard is locked only while its entries are
+  removed.
+*/
+{
+    if (!tag)
+        return 0;
+    size_t count = 0;
+    string name(tag);
+    for (unsigned int ndx = 0; ndx < shard_count; ndx++) {
+        Shard& shard = shards[ndx];
+        lock_guard<mutex> lock(shard.mutex);
+        auto keys = shard.tagged.find(name);
+        if (keys == shard.tagged.end())
+            continue;
+        // Key list is taken out first since erase updates the index.
+        unordered_set<string_view> tagged = move(keys->second);
+        shard.tagged.erase(keys);
+        for (string_view key : tagged) {
+            auto found = shard.index.find(key);
+            if (found == shard.index.end())
+                continue;
+            erase(shard, found->second);
+            shard.stats.invalidated++;
+            count++;
+        }
+    }
+    return count;
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+ResultCache::Clear()
+{
+    for (unsigned int ndx = 0; ndx < shard_count; ndx++) {
+        Shard& shard = shards[ndx];
+        lock_guard<mutex> lock(shard.mutex);
+        shard.index.clear();
+        shard.tagged.clear();
+        shard.lru.clear();
+        shard.bytes = 0;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+ResultCache::Stats
+ResultCache::GetStats()
+{
+    Stats total;
+    memset(&total, 0, sizeof(total));
+    for (unsigned int ndx = 0; ndx < shard_count; ndx++) {
+        Shard& shard = shards[ndx];
+        lock_guard<mutex> lock(shard.mutex);
+        total.hits += shard.stats.hits;
+        total.misses += shard.stats.misses;
+        total.evictions += shard.stats.evictions;
+        total.expired += shard.stats.expired;
+        total.invalidated += shard.stats.invalidated;
+        total.entries += shard.lru.size();
+        total.bytes += shard.bytes;
+    }
+    return total;
+}
+
+// =================================================================================================
+// Values are packed into the data string in the bound variable's native form. Strings are
+// prefixed with their length.
+
+void
+PackValue(string& data, DT type, const void* value)
+{
+    switch (type) {
+    case DT::INT:
+        data.append((const char*)value, sizeof(int));
+        break;
+    case DT::LONG:
+        data.append((const char*)value, sizeof(long));
+        break;
+    case DT::NUM:
+        data.append((const char*)value, sizeof(double));
+        break;
+    case DT::BOOL:
+        data += *(const bool*)value ? '\1' : '\0';
+        break;
+    case DT::BIT:
+    case DT::CHR:
+        data += *(const char*)value;
+        break;
+    case DT::TIME:
+    case DT::DAY:
+        data.append((const char*)value, sizeof(tm));
+        break;
+    case DT::STR: {
+        const string* str = (const string*)value;
+        uint32_t len = str->size();
+        data.append((const char*)&len, sizeof(len));
+        data.append(*str);
+        break;
+    }
+    case DT::BLOB: {
+        const Blob* blob = (const Blob*)value;
+        uint32_t len = blob->size;
+        data.append((const char*)&len, sizeof(len));
+        data.append((const char*)blob->data, blob->size);
+        break;
+    }
+    case DT::VEC_LONG: {
+        const vector<long>* vec = (const vector<long>*)value;
+        uint32_t len = vec->size();
+        data.append((const char*)&len, sizeof(len));
+        data.append((const char*)vec->data(), len * sizeof(long));
+        break;
+    }
+    case DT::VEC_NUM: {
+        const vector<double>* vec = (const vector<double>*)value;
+        uint32_t len = vec->size();
+        data.append((const char*)&len, sizeof(len));
+        data.append((const char*)vec->data(), len * sizeof(double));
+        break;
+    }
+    case DT::VEC_STR: {
+        const vector<string>* vec = (const vector<string>*)value;
+        uint32_t len = vec->size();
+        data.append((const char*)&len, sizeof(len));
+        for (const string& str : *vec)
+            PackValue(data, DT::STR, &str);
+        break;
+    }
+    case DT::DEC:
+        data.append((const char*)value, sizeof(Decimal));
+        break;
+    }
+}
+
+const char*
+UnpackValue(const char* data, DT type, void* value)
+{
+    switch (type) {
+    case DT::INT:
+        memcpy(value, data, sizeof(int));
+        return data + sizeof(int);
+    case DT::LONG:
+        memcpy(value, data, sizeof(long));
+        return data + sizeof(long);
+    case DT::NUM:
+        memcpy(value, data, sizeof(double));
+        return data + sizeof(double);
+    case DT::BOOL:
+        *(bool*)value = *data != 0;
+        return data + 1;
+    case DT::BIT:
+    case DT::CHR:
+        *(char*)value = *data;
+        return data + 1;
+    case DT::TIME:
+    case DT::DAY:
+        memcpy(value, data, sizeof(tm));
+        return data + sizeof(tm);
+    case DT::STR: {
+        uint32_t len;
+        memcpy(&len, data, sizeof(len));
+        ((string*)value)->assign(data + sizeof(len), len);
+        return data + sizeof(len) + len;
+    }
+    case DT::BLOB: {
+        // Refers to the packed data, i.e. valid as long as the buffer.
+        uint32_t len;
+        memcpy(&len, data, sizeof(len));
+        *(Blob*)value = Blob(data + sizeof(len), len);
+        return data + sizeof(len) + len;
+    }
+    case DT::VEC_LONG: {
+        uint32_t len;
+        memcpy(&len, data, sizeof(len));
+        vector<long>* vec = (vector<long>*)value;
+        vec->resize(len);
+        memcpy(vec->data(), data + sizeof(len), len * sizeof(long));
+        return data + sizeof(len) + len * sizeof(long);
+    }
+    case DT::VEC_NUM: {
+        uint32_t len;
+        memcpy(&len, data, sizeof(len));
+        vector<double>* vec = (vector<double>*)value;
+        vec->resize(len);
+        memcpy(vec->data(), data + sizeof(len), len * sizeof(double));
+        return data + sizeof(len) + len * sizeof(double);
+    }
+    case DT::VEC_STR: {
+        uint32_t len;
+        memcpy(&len, data, sizeof(len));
+        vector<string>* vec = (vector<string>*)value;
+        vec->resize(len);
+        data += sizeof(len);
+        for (string& str : *vec)
+            data = UnpackValue(data, DT::STR, &str);
+        return data;
+    }
+    case DT::DEC:
+        memcpy(value, data, sizeof(Decimal));
+        return data + sizeof(Decimal);
+    }
+    return data;
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+ClearValue(DT type, void* value)
+{
+    switch (type) {
+    case DT::INT:
+        *(int*)value = 0;
+        break;
+    case DT::LONG:
+        *(long*)value = 0;
+        break;
+    case DT::NUM:
+        *(double*)value = 0;
+        break;
+    case DT::BOOL:
+        *(bool*)value = false;
+        break;
+    case DT::BIT:
+    case DT::CHR:
+        *(char*)value = 0;
+        break;
+    case DT::TIME:
+    case DT::DAY:
+        memset(value, 0, sizeof(tm));
+        break;
+    case DT::STR:
+        ((string*)value)->clear();
+        break;
+    case DT::BLOB:
+        *(Blob*)value = Blob();
+        break;
+    case DT::VEC_LONG:
+        ((vector<long>*)value)->clear();
+        break;
+    case DT::VEC_NUM:
+        ((vector<double>*)value)->clear();
+        break;
+    case DT::VEC_STR:
+        ((vector<string>*)value)->clear();
+        break;
+    case DT::DEC:
+        *(Decimal*)value = Decimal();
+        break;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+// NULL is packed as a single flag byte so that it is restored the way the reader bound it.
+void
+PackField(string& data, DT type, const void* value, bool is_null)
+{
+    data += is_null ? '\1' : '\0';
+    if (!is_null)
+        PackValue(data, type, value);
+}
+
+const char*
+UnpackField(const char* data, BoundField* field)
+{
+    bool is_null = *data++ != 0;
+    void* target = field->Target(is_null);
+    if (!is_null)
+        return UnpackValue(data, field->type, target);
+    if (target)
+        ClearValue(field->type, target);
+    return data;
+}
+
+// -------------------------------------------------------------------------------------------------
+void*
+ValueSlot::Address(DT type)
+{
+    switch (type) {
+    case DT::INT:
+        return &i;
+    case DT::LONG:
+        return &l;
+    case DT::NUM:
+        return &d;
+    case DT::BOOL:
+        return &b;
+    case DT::BIT:
+    case DT::CHR:
+        return &c;
+    case DT::TIME:
+    case DT::DAY:
+        return &t;
+    case DT::STR:
+        return &s;
+    case DT::BLOB:
+        return &x;
+    case DT::VEC_LONG:
+        return &vl;
+    case DT::VEC_NUM:
+        return &vd;
+    case DT::VEC_STR:
+        return &vs;
+    case DT::DEC:
+        return &m;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Key starts with the result type so that the same SQL read with different types is not mixed.
+template <class T, DT type>
+static bool
+cachedFunction(Database* db,
+               ResultCache* cache,
+               bool (Database::*execute)(const string&, T&),
+               const string& query,
+               T& val,
+               unsigned int ttl_ms,
+               const char* tags)
+{
+    if (!cache)
+        return (db->*execute)(query, val);
+    string key;
+    key.reserve(query.size() + 2);
+    key += 'F';
+    key += (char)('0' + (int)type);
+    key += query;
+    ResultCache::Data data = cache->Get(key);
+    if (data) {
+        UnpackValue(data->data(), type, &val);
+        return true;
+    }
+    if (!(db->*execute)(query, val))
+        return false;
+    shared_ptr<string> packed = make_shared<string>();
+    PackValue(*packed, type, &val);
+    cache->Put(key, packed, ttl_ms, tags);
+    return true;
+}
+
+bool
+Database::CachedIntFunction(const string& query, int& val, unsigned int ttl_ms, const char* tags)
+{
+    return cachedFunction<int, DT::INT>(this, cache, &Database::ExecuteIntFunction, query, val,
+                                        ttl_ms, tags);
+}
+bool
+Database::CachedLongFunction(const string& query, long& val, unsigned int ttl_ms, const char* tags)
+{
+    return cachedFunction<long, DT::LONG>(this, cache, &Database::ExecuteLongFunction, query, val,
+                                          ttl_ms, tags);
+}
+bool
+Database::CachedDoubleFunction(const string& query,
+                               double& val,
+                               unsigned int ttl_ms,
+                               const char* tags)
+{
+    return cachedFunction<double, DT::NUM>(this, cache, &Database::ExecuteDoubleFunction, query,
+                                           val, ttl_ms, tags);
+}
+bool
+Database::CachedBoolFunction(const string& query, bool& val, unsigned int ttl_ms, const char* tags)
+{
+    return cachedFunction<bool, DT::BOOL>(this, cache, &Database::ExecuteBoolFunction, query, val,
+                                          ttl_ms, tags);
+}
+bool
+Database::CachedStrFunction(const string& query,
+                            string& result,
+                            unsigned int ttl_ms,
+                            const char* tags)
+{
+    return cachedFunction<string, DT::STR>(this, cache, &Database::ExecuteStrFunction, query,
+                                           result, ttl_ms, tags);
+}
+bool
+Database::CachedDateFunction(const string& query, tm& val, unsigned int ttl_ms, const char* tags)
+{
+    return cachedFunction<tm, DT::TIME>(this, cache, &Database::ExecuteDateFunction, query, val,
+                                        ttl_ms, tags);
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+Database::QueryCached(RowSet* rs, unsigned int ttl_ms, const char* tags)
+/*!
+  Cached rows are packed as the GetNext return value followed by the bound variables. Key holds
+  the types of the bound variables so that a differently bound row set does not read the data.
+*/
+{
+    if (!cache)
+        return rs->Query();
+    string key;
+    key.reserve(rs->query.GetLength() + rs->field_count + 2);
+    key += 'R';
+    for (BoundField* field = rs->fieldRoot; field; field = field->next)
+        key += (char)('0' + (int)field->type);
+    key += ':';
+    key.append(rs->query.GetText(), rs->query.GetLength());
+
+    ResultCache::Data data = cache->Get(key);
+    if (!data) {
+        if (!rs->Query())
+            return false;
+        shared_ptr<string> packed = make_shared<string>();
+        for (int count; (count = rs->GetNext()) > 0;) {
+            packed->append((const char*)&count, sizeof(count));
+            for (BoundField* field = rs->fieldRoot; field; field = field->next) {
+                bool is_null;
+                const void* value = field->Source(is_null);
+                PackField(*packed, field->type, value, is_null);
+            }
+        }
+        // Partial result of a failed or timed out read is neither cached nor returned.
+        if (rs->IsFailed()) {
+            rs->Reset();
+            return false;
+        }
+        cache->Put(key, packed, ttl_ms, tags);
+        data = packed;
+    }
+    rs->Reset();
+    rs->cached = data;
+    rs->cached_pos = 0;
+    rs->row_count = 0;
+    rs->failed = false;
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+int
+RowSet::GetNextCached()
+{
+    if (cached_pos >= cached->size()) {
+        cached.reset();
+        return 0;
+    }
+    const char* data = cached->data() + cached_pos;
+    int count;
+    memcpy(&count, data, sizeof(count));
+    data += sizeof(count);
+    for (BoundField* field = fieldRoot; field; field = field->next)
+        data = UnpackField(data, field);
+    cached_pos = data - cached->data();
+    row_count++;
+    return count;
+}
+
+}; // namespace ddb
@@ -0,0 +1,555 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+// Benchmark for the fetch and write paths. Build with: ./build -bench
+// Run: ddbbench -sqlite bench.db [-pg "host=localhost dbname=bench"] [-rows N] [-threads N]
+//               [-reps N] [-out results.json]
+// Each result is written as one JSON object per line so that runs from two commits can be
+// compared with any line oriented tool.
+#include <time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cpp4scripts/cpp4scripts.hpp>
+
+using namespace std;
+
+#define __DDB_POSTGRE__
+#define __DDB_SQLITE3__
+#include "../directdb.hpp"
+using namespace ddb;
+
+typedef chrono::steady_clock bclock;
+
+static int g_rows = 10000;
+static int g_reps = 5;
+static int g_threads = 4;
+static ostream* g_out = &cout;
+
+const int MAX_COLS = 16;
+const int col_counts[] = { 1, 4, 16 };
+
+struct TypeInfo
+{
+    DT type;
+    const char* name;
+    const char* sql_type;
+    const char* value;
+};
+const TypeInfo types[] = {
+    { DT::INT, "INT", "int", "123456" },
+    { DT::LONG, "LONG", "bigint", "1234567890123" },
+    { DT::STR, "STR", "varchar(64)", "'directdb benchmark string value   '" },
+    { DT::BOOL, "BOOL", "boolean", "'1'" },
+    { DT::TIME, "TIME", "timestamp", "'2021-05-17 12:34:56'" },
+    { DT::NUM, "NUM", "float8", "12345.678" },
+    { DT::CHR, "CHR", "char(1)", "'c'" },
+};
+
+// -------------------------------------------------------------------------------------------------
+// Storage that can be bound to any of the library types.
+struct Cell
+{
+    int i;
+    long l;
+    string s;
+    bool b;
+    tm t;
+    double d;
+    char c;
+    void* Ptr(DT type)
+    {
+        switch (type) {
+        case DT::INT:
+            return &i;
+        case DT::LONG:
+            return &l;
+        case DT::STR:
+            return &s;
+        case DT::BOOL:
+            return &b;
+        case DT::TIME:
+        case DT::DAY:
+            return &t;
+        case DT::NUM:
+            return &d;
+        default:
+            return &c;
+        }
+    }
+};
+
+// -------------------------------------------------------------------------------------------------
+void
+Report(const char* suite,
+       const char* backend,
+       const char* name,
+       int cols,
+       int threads,
+       long items,
+       double sec)
+{
+    *g_out << "{\"suite\":\"" << suite << "\",\"backend\":\"" << backend << "\",\"case\":\"" << name
+           << "\",\"cols\":" << cols << ",\"threads\":" << threads << ",\"items\":" << items
+           << ",\"sec\":" << sec << ",\"per_sec\":" << (sec > 0 ? items / sec : 0) << "}"
+           << endl;
+}
+
+double
+Elapsed(bclock::time_point start)
+{
+    return chrono::duration<double>(bclock::now() - start).count();
+}
+
+
+// -------------------------------------------------------------------------------------------------
+void
+MicroBench()
+{
+    const long count = 1000000;
+    volatile long sink = 0;
+
+    tm stamp;
+    auto start = bclock::now();
+    for (long i = 0; i < count; i++) {
+        Database::ExtractTimestamp("2021-05-17 12:34:56", &stamp);
+        sink += stamp.tm_sec;
+    }
+    Report("micro", "none", "ExtractTimestamp", 1, 1, count, Elapsed(start));
+
+    string trim;
+    start = bclock::now();
+    for (long i = 0; i < count; i++) {
+        trim = "directdb benchmark value          ";
+        Database::TrimTail(&trim);
+        sink += trim.size();
+    }
+    Report("micro", "none", "TrimTail", 1, 1, count, Elapsed(start));
+
+    // CleanStr is not static, any backend object will do.
+    Sqlite db;
+    string dirty("It's a 'quoted' text\r\nwith a carriage return and some more text to clean.");
+    start = bclock::now();
+    for (long i = 0; i < count; i++)
+        sink += db.CleanStr(dirty).size();
+    Report("micro", "none", "CleanStr(string)", 1, 1, count, Elapsed(start));
+
+    start = bclock::now();
+    for (long i = 0; i < count; i++)
+        sink += strlen(db.CleanStr(dirty.c_str()));
+    Report("micro", "none", "CleanStr(char*)", 1, 1, count, Elapsed(start));
+
+    string clean;
+    start = bclock::now();
+    for (long i = 0; i < count; i++) {
+        clean.clear();
+        Database::AppendClean(clean, dirty.data(), dirty.size());
+        sink += clean.size();
+    }
+    Report("micro", "none", "AppendClean", 1, 1, count, Elapsed(start));
+
+    // Previous PrintNumber implementation for comparison.
+    char number[Database::NUMBER_TEXT];
+    start = bclock::now();
+    for (long i = 0; i < count; i++)
+        sink += sprintf(number, "%f", i * 1.25);
+    Report("micro", "none", "sprintf(%f)", 1, 1, count, Elapsed(start));
+
+    start = bclock::now();
+    for (long i = 0; i < count; i++)
+        sink += Database::FormatNumber(number, i * 1.25) - number;
+    Report("micro", "none", "FormatNumber(double)", 1, 1, count, Elapsed(start));
+
+    start = bclock::now();
+    for (long i = 0; i < count; i++)
+        sink += Database::FormatNumber(number, i * 7919L) - number;
+    Report("micro", "none", "FormatNumber(long)", 1, 1, count, Elapsed(start));
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+CreateFetchTable(Database* db, const TypeInfo& ti)
+{
+    ostringstream sql;
+    sql << "DROP TABLE IF EXISTS ddb_bench_" << ti.name;
+    db->UpdateStructure(sql.str());
+    sql.str("");
+    sql << "CREATE TABLE ddb_bench_" << ti.name << "(";
+    for (int col = 0; col < MAX_COLS; col++)
+        sql << (col ? "," : "") << "c" << col << ' ' << ti.sql_type;
+    sql << ")";
+    if (!db->UpdateStructure(sql.str())) {
+        cerr << "Create table failed: " << db->GetErrorDescription() << '\n';
+        return false;
+    }
+    string row;
+    sql.str("");
+    for (int col = 0; col < MAX_COLS; col++)
+        sql << (col ? "," : "") << ti.value;
+    row = sql.str();
+
+    db->StartTransaction();
+    for (int ndx = 0; ndx < g_rows; ndx++) {
+        sql.str("");
+        sql << "INSERT INTO ddb_bench_" << ti.name << " VALUES (" << row << ")";
+        if (db->ExecuteModify(sql.str()) < 0) {
+            cerr << "Insert failed: " << db->GetErrorDescription() << '\n';
+            db->Commit();
+            return false;
+        }
+    }
+    db->Commit();
+    return true;
+}
+
+long
+FetchAll(Database* db, const TypeInfo& ti, int cols, Cell* cells)
+{
+    RowSet* rs = db->CreateRowSet();
+    if (!rs)
+        return -1;
+    for (int col = 0; col < cols; col++)
+        rs->Bind(ti.type, cells[col].Ptr(ti.type));
+    rs->query << "SELECT ";
+    for (int col = 0; col < cols; col++)
+        rs->query << (col ? "," : "") << "c" << col;
+    rs->query << " FROM ddb_bench_" << ti.name;
+
+    long rows = 0;
+    if (rs->Query()) {
+        while (rs->GetNext())
+            rows++;
+    } else
+        cerr << "Fetch failed: " << db->GetErrorDescription(rs) << '\n';
+    delete rs;
+    return rows;
+}
+
+void
+FetchBench(Database* db, const char* backend)
+{
+    Cell cells[MAX_COLS];
+    for (const TypeInfo& ti : types) {
+        if (!CreateFetchTable(db, ti))
+            return;
+        for (int cols : col_counts) {
+            long total = 0;
+            auto start = bclock::now();
+            for (int rep = 0; rep < g_reps; rep++)
+                total += FetchAll(db, ti, cols, cells);
+            Report("fetch", backend, ti.name, cols, 1, total, Elapsed(start));
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+CreateInsertTable(Database* db)
+{
+    db->UpdateStructure("DROP TABLE IF EXISTS ddb_bench_ins");
+    if (!db->UpdateStructure("CREATE TABLE ddb_bench_ins(id bigint, name varchar(64), "
+                             "amount float8, ts timestamp)")) {
+        cerr << "Create table failed: " << db->GetErrorDescription() << '\n';
+        return false;
+    }
+    return true;
+}
+
+void
+InsertRow(ostream& sql, long id)
+{
+    sql << "(" << id << ",'name " << id << "'," << id * 0.25 << ",'2021-05-17 12:34:56')";
+}
+
+void
+InsertBench(Database* db, const char* backend)
+{
+    // Autocommit inserts are slow on disk based databases, keep the count sane.
+    int single = g_rows < 1000 ? g_rows : 1000;
+    ostringstream sql;
+
+    if (!CreateInsertTable(db))
+        return;
+    auto start = bclock::now();
+    for (long id = 0; id < single; id++) {
+        sql.str("");
+        sql << "INSERT INTO ddb_bench_ins VALUES ";
+        InsertRow(sql, id);
+        db->ExecuteModify(sql.str());
+    }
+    Report("insert", backend, "single", 4, 1, single, Elapsed(start));
+
+    CreateInsertTable(db);
+    start = bclock::now();
+    db->StartTransaction();
+    for (long id = 0; id < g_rows; id++) {
+        sql.str("");
+        sql << "INSERT INTO ddb_bench_ins VALUES ";
+        InsertRow(sql, id);
+        db->ExecuteModify(sql.str());
+    }
+    db->Commit();
+    Report("insert", backend, "transaction", 4, 1, g_rows, Elapsed(start));
+
+    const int batch = 100;
+    CreateInsertTable(db);
+    start = bclock::now();
+    db->StartTransaction();
+    for (long id = 0; id < g_rows;) {
+        sql.str("");
+        sql << "INSERT INTO ddb_bench_ins VALUES ";
+        for (int ndx = 0; ndx < batch && id < g_rows; ndx++, id++) {
+            if (ndx)
+                sql << ',';
+            InsertRow(sql, id);
+        }
+        db->ExecuteModify(sql.str());
+    }
+    db->Commit();
+    Report("insert", backend, "bulk", 4, 1, g_rows, Elapsed(start));
+
+    vector<long> ids(g_rows);
+    vector<string> names(g_rows);
+    vector<double> amounts(g_rows);
+    vector<tm> stamps(g_rows);
+    tm stamp;
+    memset(&stamp, 0, sizeof(stamp));
+    strptime("2021-05-17 12:34:56", "%Y-%m-%d %H:%M:%S", &stamp);
+    for (long id = 0; id < g_rows; id++) {
+        ids[id] = id;
+        names[id] = "name " + to_string(id);
+        amounts[id] = id * 0.25;
+        stamps[id] = stamp;
+    }
+    BulkParams params;
+    params.Bind(ids);
+    params.Bind(names);
+    params.Bind(amounts);
+    params.Bind(stamps);
+    CreateInsertTable(db);
+    start = bclock::now();
+    if (db->ExecuteBulk("INSERT INTO ddb_bench_ins VALUES ($1,$2,$3,$4)", params) != g_rows)
+        cerr << "ExecuteBulk failed: " << db->GetErrorDescription() << '\n';
+    Report("insert", backend, "array", 4, 1, g_rows, Elapsed(start));
+}
+
+// -------------------------------------------------------------------------------------------------
+// Each thread uses its own connection since a Database object is not thread safe.
+void
+ThreadBench(const char* backend, const char* constr)
+{
+    const TypeInfo& ti = types[0];
+    const int cols = 4;
+    for (int threads = 1; threads <= g_threads; threads *= 2) {
+        vector<Database*> dbs;
+        for (int ndx = 0; ndx < threads; ndx++) {
+            Database* db;
+            if (!strcmp(backend, "postgres"))
+                db = new Postgre();
+            else
+                db = new Sqlite();
+            if (!db->Connect(constr)) {
+                cerr << "Thread connect failed: " << db->GetErrorDescription() << '\n';
+                delete db;
+                break;
+            }
+            dbs.push_back(db);
+        }
+        vector<long> totals(dbs.size(), 0);
+        vector<thread> workers;
+        auto start = bclock::now();
+        for (size_t ndx = 0; ndx < dbs.size(); ndx++) {
+            workers.push_back(thread([&, ndx]() {
+                Cell cells[MAX_COLS];
+                for (int rep = 0; rep < g_reps; rep++)
+                    totals[ndx] += FetchAll(dbs[ndx], ti, cols, cells);
+            }));
+        }
+        long total = 0;
+        for (size_t ndx = 0; ndx < workers.size(); ndx++) {
+            workers[ndx].join();
+            total += totals[ndx];
+        }
+        Report("threads", backend, ti.name, cols, dbs.size(), total, Elapsed(start));
+        for (Database* db : dbs)
+            delete db;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+// Threads share one SqlitePool with a reader for each thread.
+void
+PoolBench(const char* constr)
+{
+    const TypeInfo& ti = types[0];
+    const int cols = 4;
+    for (int threads = 1; threads <= g_threads; threads *= 2) {
+        SqlitePool pool(threads);
+        if (!pool.Connect(constr)) {
+            cerr << "Pool connect failed: " << pool.GetErrorDescription(0) << '\n';
+            return;
+        }
+        vector<long> totals(threads, 0);
+        vector<thread> workers;
+        auto start = bclock::now();
+        for (int ndx = 0; ndx < threads; ndx++) {
+            workers.push_back(thread([&, ndx]() {
+                Cell cells[MAX_COLS];
+                for (int rep = 0; rep < g_reps; rep++)
+                    totals[ndx] += FetchAll(&pool, ti, cols, cells);
+            }));
+        }
+        long total = 0;
+        for (int ndx = 0; ndx < threads; ndx++) {
+            workers[ndx].join();
+            total += totals[ndx];
+        }
+        Report("pool", "sqlite", ti.name, cols, threads, total, Elapsed(start));
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+// Range scan of the insert table split to 1..g_threads partitions on the pool's readers.
+void
+PartitionBench(const char* constr)
+{
+    SqlitePool pool(g_threads);
+    if (!pool.Connect(constr)) {
+        cerr << "Pool connect failed: " << pool.GetErrorDescription(0) << '\n';
+        return;
+    }
+    for (int ordered = 0; ordered < 2; ordered++) {
+        for (int parts = 1; parts <= g_threads; parts *= 2) {
+            long id;
+            string name;
+            double amount;
+            long total = 0;
+            auto start = bclock::now();
+            for (int rep = 0; rep < g_reps; rep++) {
+                PartitionedRowSet prs;
+                for (int ndx = 0; ndx < parts; ndx++)
+                    prs.AddConnection(&pool);
+                prs.Bind(DT::LONG, &id);
+                prs.Bind(DT::STR, &name);
+                prs.Bind(DT::NUM, &amount);
+                prs.SetRange(0, g_rows);
+                prs.SetOrdered(ordered);
+                prs.query << "SELECT id, name, amount FROM ddb_bench_ins "
+                             "WHERE id >= {low} AND id < {high} ORDER BY id";
+                if (!prs.Query()) {
+                    cerr << "Partitioned query failed: " << prs.GetLastError() << '\n';
+                    return;
+                }
+                while (prs.GetNext())
+                    total++;
+            }
+            Report("partition", "sqlite", ordered ? "ordered" : "any", 3, parts, total,
+                   Elapsed(start));
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+// Repeated lookups of the same value with and without the result cache.
+void
+CacheBench(Database* db, const char* backend)
+{
+    const int lookups = g_rows;
+    const int keys = 100;
+    string query;
+    int val;
+
+    auto start = bclock::now();
+    for (int ndx = 0; ndx < lookups; ndx++) {
+        query = "SELECT count(*) FROM ddb_bench_ins WHERE id < " + to_string(ndx % keys);
+        db->ExecuteIntFunction(query, val);
+    }
+    Report("cache", backend, "uncached", 1, 1, lookups, Elapsed(start));
+
+    ResultCache cache;
+    db->SetResultCache(&cache);
+    start = bclock::now();
+    for (int ndx = 0; ndx < lookups; ndx++) {
+        query = "SELECT count(*) FROM ddb_bench_ins WHERE id < " + to_string(ndx % keys);
+        db->CachedIntFunction(query, val, 0, "ddb_bench_ins");
+    }
+    Report("cache", backend, "cached", 1, 1, lookups, Elapsed(start));
+    db->SetResultCache(0);
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+RunBackend(Database* db, const char* backend)
+{
+    FetchBench(db, backend);
+    InsertBench(db, backend);
+    CacheBench(db, backend);
+}
+
+int
+main(int argc, char** argv)
+{
+    const char* sqlite_file = 0;
+    const char* pg_constr = 0;
+    ofstream outfile;
+
+    for (int ndx = 1; ndx < argc; ndx++) {
+        if (ndx + 1 < argc && !strcmp(argv[ndx], "-sqlite"))
+            sqlite_file = argv[++ndx];
+        else if (ndx + 1 < argc && !strcmp(argv[ndx], "-pg"))
+            pg_constr = argv[++ndx];
+        else if (ndx + 1 < argc && !strcmp(argv[ndx], "-rows"))
+            g_rows = atoi(argv[++ndx]);
+        else if (ndx + 1 < argc && !strcmp(argv[ndx], "-reps"))
+            g_reps = atoi(argv[++ndx]);
+        else if (ndx + 1 < argc && !strcmp(argv[ndx], "-threads"))
+            g_threads = atoi(argv[++ndx]);
+        else if (ndx + 1 < argc && !strcmp(argv[ndx], "-out")) {
+            outfile.open(argv[++ndx]);
+            g_out = &outfile;
+        } else {
+            cout << "Usage: ddbbench -sqlite file [-pg constr] [-rows N] [-reps N] [-threads N] "
+                    "[-out file]\n";
+            return 1;
+        }
+    }
+    if (!sqlite_file) {
+        cout << "Please name the SQLite benchmark database with -sqlite.\n";
+        return 1;
+    }
+
+    MicroBench();
+
+    Database* sdb = new Sqlite();
+    if (!sdb->Connect(sqlite_file)) {
+        cout << "Unable to find/create " << sqlite_file << '\n';
+        return 2;
+    }
+    RunBackend(sdb, "sqlite");
+    delete sdb;
+    ThreadBench("sqlite", sqlite_file);
+    PoolBench(sqlite_file);
+    PartitionBench(sqlite_file);
+
+    if (pg_constr) {
+        Database* pdb = new Postgre();
+        if (!pdb->Connect(pg_constr)) {
+            cout << pdb->GetErrorDescription() << '\n';
+            return 2;
+        }
+        RunBackend(pdb, "postgres");
+        delete pdb;
+        ThreadBench("postgres", pg_constr);
+    }
+    return 0;
+}
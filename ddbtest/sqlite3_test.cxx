@@ -3,11 +3,29 @@ sqlite3_test.cpp
 Copyright (c) Antti Merenluoto
 *******************************************************************************/
 
+#include <climits>
+#include <cmath>
+#include <string.h>
+#include <unistd.h>
 #include <iostream>
 #include <sstream>
 using namespace std;
 
 #include <sqlite3.h>
+#define __DDB_SQLITE3__
+#include "../directdb.hpp"
+using namespace ddb;
+
+int g_failed = 0;
+
+void
+Check(bool ok, const char* what)
+{
+    if (!ok) {
+        cout << "FAILED: " << what << '\n';
+        g_failed++;
+    }
+}
 
 const char* g_create_table = "CREATE TABLE ddb_demo ("
                              "id int NOT NULL"
@@ -41,12 +59,737 @@ CreateTable(sqlite3* con)
         cout << "Test table created\n";
 }
 
+bool
+DecimalIs(const char* text, long long units, int scale)
+{
+    Decimal dec;
+    return dec.Parse(text, strlen(text)) && dec.units == units && dec.scale == scale;
+}
+
+void
+TestDecimal()
+{
+    cout << "# Decimal parse, rescale and format\n";
+    Decimal dec;
+    Check(DecimalIs("-0.005", -5, 3), "parse -0.005");
+    Check(dec.Parse("-0.005") && dec.ToString() == "-0.005", "format -0.005");
+    Check(dec.Rescale(2) && dec.units == -1 && dec.ToString() == "-0.01", "-0.005 rounds to -0.01");
+    dec = Decimal(5, 3);
+    Check(dec.Rescale(2) && dec.units == 1, "0.005 rounds to 0.01");
+    dec = Decimal(-4, 3);
+    Check(dec.Rescale(2) && dec.units == 0 && dec.ToString() == "0.00", "-0.004 rounds to 0.00");
+
+    // Decimals beyond MAX_SCALE are rounded half away from zero.
+    Check(DecimalIs("0.1234567890123456785", 123456789012345679LL, 18), "round at MAX_SCALE");
+    Check(DecimalIs("-0.1234567890123456784", -123456789012345678LL, 18), "truncate at MAX_SCALE");
+    Check(DecimalIs("0.0000000000000000005", 1, 18), "round up to one unit");
+    Check(DecimalIs("0.00000000000000000049", 0, 18), "round down to zero");
+    Check(DecimalIs("1e-20", 0, 18), "exponent beyond MAX_SCALE");
+
+    Check(DecimalIs("9223372036854775807", LLONG_MAX, 0), "parse LLONG_MAX");
+    Check(!dec.Parse("9223372036854775808"), "reject LLONG_MAX + 1");
+    Check(!dec.Parse("+9223372036854775808"), "reject +LLONG_MAX + 1");
+    Check(DecimalIs("-9223372036854775808", LLONG_MIN, 0), "parse LLONG_MIN");
+    Check(!dec.Parse("-9223372036854775809"), "reject LLONG_MIN - 1");
+    Check(Decimal(LLONG_MIN, 0).ToString() == "-9223372036854775808", "format LLONG_MIN");
+    Check(Decimal(LLONG_MIN, 2).ToString() == "-92233720368547758.08", "format LLONG_MIN, scale 2");
+    Check(Decimal(1, 18).ToString() == "0.000000000000000001", "format scale 18");
+    dec = Decimal(LLONG_MAX, 0);
+    Check(!dec.Rescale(1) && dec.units == LLONG_MAX && dec.scale == 0, "rescale overflow");
+    dec = Decimal(LLONG_MIN, 1);
+    Check(dec.Rescale(0) && dec.units == LLONG_MIN / 10 - 1, "rescale LLONG_MIN down");
+
+    Check(DecimalIs("1.5e-3", 15, 4), "parse 1.5e-3");
+    Check(DecimalIs("1E2", 100, 0), "parse 1E2");
+    Check(DecimalIs(" 12.50 ", 1250, 2), "parse with spaces");
+    Check(!dec.Parse("") && !dec.Parse("-") && !dec.Parse("1.2.3") && !dec.Parse("1e"),
+          "reject bad text");
+}
+
+void
+TestDecimalSqlite()
+{
+    cout << "# Decimal round trip through Sqlite\n";
+    Sqlite db;
+    if (!db.Connect(":memory:")) {
+        Check(false, "connect :memory:");
+        return;
+    }
+    db.UpdateStructure("CREATE TABLE dec_test(id integer, r real, t text, i integer)");
+    db.ExecuteModify("INSERT INTO dec_test VALUES(1, 0.1, '12345.678', 42)");
+    db.ExecuteModify("INSERT INTO dec_test VALUES(2, -2.5e-3, '-0.005', -9223372036854775808)");
+
+    // Parameters: scale 0 is bound as integer and others as text.
+    vector<long> ids = { 3, 4 };
+    vector<Decimal> values = { Decimal(-5, 3), Decimal(LLONG_MAX, 0) };
+    BulkParams params;
+    params.Bind(ids);
+    params.Bind(values);
+    params.Bind(values);
+    Check(db.ExecuteBulk("INSERT INTO dec_test(id, t, i) VALUES(?, ?, ?)", params) == 2,
+          "bulk insert decimals");
+
+    RowSet* rs = db.CreateRowSet();
+    long id;
+    optional<Decimal> real;
+    Decimal text, integer;
+    rs->Bind(DT::LONG, &id);
+    rs->Bind(real);
+    rs->Bind(DT::DEC, &text);
+    rs->Bind(DT::DEC, &integer);
+    rs->query << "SELECT id, r, t, i FROM dec_test ORDER BY id";
+    Check(rs->Query(), "query decimals");
+    const char* expected[4][3] = { { "0.1", "12345.678", "42" },
+                                   { "-0.0025", "-0.005", "-9223372036854775808" },
+                                   { 0, "-0.005", "-0.005" },
+                                   { 0, "9223372036854775807", "9223372036854775807" } };
+    int rows = 0;
+    while (rs->GetNext() > 0 && rows < 4) {
+        if (expected[rows][0])
+            Check(real && real->ToString() == expected[rows][0], "REAL column");
+        else
+            Check(!real, "NULL REAL column");
+        Check(text.ToString() == expected[rows][1], "TEXT column");
+        Check(integer.ToString() == expected[rows][2], "INTEGER column");
+        rows++;
+    }
+    Check(rows == 4, "decimal row count");
+    delete rs;
+}
+
+// Plain byte by byte escaping to compare the writer with.
+string
+JsonQuote(const string& text)
+{
+    static const char hex[] = "0123456789abcdef";
+    string out("\"");
+    for (unsigned char ch : text) {
+        if (ch == '"' || ch == '\\') {
+            out += '\\';
+            out += (char)ch;
+        } else if (ch == '\n')
+            out += "\\n";
+        else if (ch == '\r')
+            out += "\\r";
+        else if (ch == '\t')
+            out += "\\t";
+        else if (ch < 0x20) {
+            out += "\\u00";
+            out += hex[ch >> 4];
+            out += hex[ch & 0xf];
+        } else
+            out += (char)ch;
+    }
+    return out + '"';
+}
+
+string
+JsonString(const string& text)
+{
+    JsonWriter out(JsonWriter::ARRAYS);
+    out.BeginResult();
+    out.BeginRow();
+    out.String(text.data(), text.size());
+    out.EndRow();
+    out.EndResult();
+    string json(out.GetText(), out.GetLength());
+    // Strip [[ and ]].
+    return json.size() > 4 ? json.substr(2, json.size() - 4) : json;
+}
+
+void
+TestJson()
+{
+    cout << "# JsonWriter escaping\n";
+    Check(JsonString("a\"b\\c") == "\"a\\\"b\\\\c\"", "quote and backslash");
+    Check(JsonString("\n\r\t\x01\x1f") == "\"\\n\\r\\t\\u0001\\u001f\"", "control characters");
+    Check(JsonString(string("a\0b", 3)) == "\"a\\u0000b\"", "zero byte");
+    Check(JsonString("\x7f\xc3\xa4\xe2\x82\xac") == "\"\x7f\xc3\xa4\xe2\x82\xac\"",
+          "DEL and UTF-8 unchanged");
+    // Every byte value at every position of a string longer than the 16 byte blocks.
+    bool same = true;
+    for (int ch = 0; ch < 256 && same; ch++) {
+        for (size_t pos = 0; pos < 40 && same; pos++) {
+            string text(40, 'x');
+            text[pos] = (char)ch;
+            text[39 - pos] = (char)(255 - ch);
+            same = JsonString(text) == JsonQuote(text);
+        }
+    }
+    Check(same, "all bytes at all positions");
+
+    JsonWriter out;
+    out.BeginResult();
+    out.AddColumn("a\"b");
+    out.AddColumn("n");
+    out.AddColumn("x");
+    out.BeginRow();
+    out.Number(1.5);
+    out.Number(nan(""));
+    out.Binary("\x01\xab", 2);
+    out.EndRow();
+    out.BeginRow();
+    out.Number(LLONG_MIN);
+    out.Null();
+    out.Bool(true);
+    out.EndRow();
+    out.EndResult();
+    Check(string(out.GetText()) == "[{\"a\\\"b\":1.5,\"n\":null,\"x\":\"\\\\x01ab\"},"
+                                   "{\"a\\\"b\":-9223372036854775808,\"n\":null,\"x\":true}]",
+          "keys, numbers and binary");
+
+    Sqlite db;
+    if (!db.Connect(":memory:")) {
+        Check(false, "connect :memory:");
+        return;
+    }
+    db.UpdateStructure("CREATE TABLE json_test(id integer, name text, v real)");
+    db.ExecuteModify("INSERT INTO json_test VALUES(1, 'say \"hi\"' || char(10), 0.5)");
+    db.ExecuteModify("INSERT INTO json_test VALUES(2, NULL, NULL)");
+    RowSet* rs = db.CreateRowSet();
+    rs->query << "SELECT id, name, v FROM json_test ORDER BY id";
+    JsonWriter result;
+    Check(rs->WriteJson(result) == 2, "Sqlite WriteJson rows");
+    Check(string(result.GetText()) == "[{\"id\":1,\"name\":\"say \\\"hi\\\"\\n\",\"v\":0.5},"
+                                      "{\"id\":2,\"name\":null,\"v\":null}]",
+          "Sqlite WriteJson text");
+    delete rs;
+}
+
+void
+TestConnect()
+{
+    cout << "# Sqlite connection strings\n";
+    SqliteOptions opt;
+    string file, error;
+    Check(opt.Parse("file:app.db?mode=ro", file, error) && file == "file:app.db?mode=ro",
+          "URI is a file name");
+    Check(opt.Parse("/data/a=b.db", file, error) && file == "/data/a=b.db",
+          "path with '=' is a file name");
+    Check(opt.Parse("file=/tmp/x.db journal_mode=WAL", file, error) && file == "/tmp/x.db" &&
+              opt.journal_mode == "WAL",
+          "options are parsed");
+    Check(!opt.Parse("file=/tmp/x.db journal_mode=fast", file, error), "bad journal_mode");
+
+    unlink("/tmp/ddb_a=b.db");
+    Sqlite path;
+    Check(path.Connect("/tmp/ddb_a=b.db"), "connect to a path with '='");
+    path.Disconnect();
+    unlink("/tmp/ddb_a=b.db");
+
+    Sqlite memory;
+    Check(!memory.Connect("file=:memory: journal_mode=WAL"), "WAL refused for :memory:");
+    Check(strstr(memory.GetLastError(), "journal_mode") != 0, "journal_mode error text");
+}
+
+void
+TestPool()
+{
+    cout << "# Sqlite pool\n";
+    unlink("/tmp/ddb_pool.db");
+    SqlitePool pool(1);
+    if (!pool.Connect("file=/tmp/ddb_pool.db journal_mode=WAL")) {
+        Check(false, "connect pool");
+        return;
+    }
+    pool.UpdateStructure("CREATE TABLE parent(id integer PRIMARY KEY)");
+    pool.UpdateStructure("CREATE TABLE child(pid integer "
+                         "REFERENCES parent(id) DEFERRABLE INITIALLY DEFERRED)");
+    pool.ExecuteModify("INSERT INTO parent VALUES(1), (2), (3)");
+
+    // The only reader is held by the row set; nested reads must not wait for it.
+    RowSet* rs = pool.CreateRowSet();
+    long id;
+    int count = 0, rows = 0;
+    rs->Bind(DT::LONG, &id);
+    rs->query << "SELECT id FROM parent ORDER BY id";
+    Check(rs->Query(), "pool query");
+    while (rs->GetNext() > 0) {
+        Check(pool.ExecuteIntFunction("SELECT count(*) FROM parent", count) && count == 3,
+              "nested read in an open pool row set");
+        rows++;
+    }
+    Check(rows == 3, "pool row count");
+    delete rs;
+    Check(pool.ExecuteIntFunction("SELECT count(*) FROM parent", count), "read after row set");
+
+    // Deferred foreign key violation fails COMMIT but keeps the transaction open.
+    pool.GetWriter()->UpdateStructure("PRAGMA foreign_keys=ON");
+    Check(pool.StartTransaction(), "pool transaction");
+    pool.ExecuteModify("INSERT INTO child VALUES(99)");
+    Check(!pool.Commit(), "commit with a foreign key violation fails");
+    Check(pool.GetWriter()->IsTransaction(), "failed commit keeps the transaction");
+    Check(pool.RollBack(), "rollback after failed commit");
+    Check(!pool.GetWriter()->IsTransaction(), "rollback ends the transaction");
+
+    Check(pool.StartTransaction(), "second pool transaction");
+    pool.ExecuteModify("INSERT INTO child VALUES(1)");
+    Check(pool.Commit(), "pool commit");
+    Check(pool.ExecuteIntFunction("SELECT count(*) FROM child", count) && count == 1,
+          "committed row is visible");
+    pool.Disconnect();
+    unlink("/tmp/ddb_pool.db");
+    unlink("/tmp/ddb_pool.db-wal");
+    unlink("/tmp/ddb_pool.db-shm");
+}
+
+void
+TestCache()
+{
+    cout << "# Result cache\n";
+    ResultCache cache(0x100000, 60000, 4);
+    auto value = [](const char* text) { return make_shared<const string>(text); };
+    cache.Put("a", value("1"), 0, "item, price");
+    cache.Put("b", value("2"), 0, "item");
+    cache.Put("c", value("3"), 0, "price");
+    cache.Put("b", value("4"), 0, "other");
+    Check(cache.Get("b") && *cache.Get("b") == "4", "replaced entry");
+    Check(cache.Invalidate("item") == 1, "invalidate by tag");
+    Check(!cache.Get("a") && cache.Get("b") && cache.Get("c"), "only tagged entries removed");
+    Check(cache.Invalidate("price") == 1 && cache.Invalidate("price") == 0, "tag index updated");
+    Check(cache.GetStats().entries == 1, "entry count after invalidate");
+
+    Sqlite db;
+    if (!db.Connect(":memory:")) {
+        Check(false, "connect :memory:");
+        return;
+    }
+    db.SetResultCache(&cache);
+    db.UpdateStructure("CREATE TABLE cached(id integer, name text)");
+    db.ExecuteModify("INSERT INTO cached VALUES(1, 'one'), (2, NULL)");
+    RowSet* rs = db.CreateRowSet();
+    long id;
+    optional<string> name;
+    rs->Bind(DT::LONG, &id);
+    rs->Bind(name);
+    rs->query << "SELECT id, name FROM cached ORDER BY id";
+    size_t hits = cache.GetStats().hits;
+    for (int round = 0; round < 2; round++) {
+        Check(db.QueryCached(rs, 0, "cached"), "QueryCached");
+        int rows = 0;
+        while (rs->GetNext() > 0)
+            rows++;
+        Check(rows == 2 && id == 2 && !name, "cached rows");
+    }
+    Check(cache.GetStats().hits == hits + 1, "second QueryCached is a hit");
+    Check(db.InvalidateCache("cached") == 1, "InvalidateCache");
+
+    // Endless query stopped by the timeout after some rows: nothing is cached or returned.
+    size_t entries = cache.GetStats().entries;
+    rs->query.Clear();
+    rs->query << "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c) "
+                 "SELECT x, 'row' FROM c WHERE x % 100000 = 0";
+    db.SetStatementTimeout(200);
+    Check(!db.QueryCached(rs), "QueryCached fails on timeout");
+    Check(db.IsTimeout() && rs->IsFailed(), "timeout is reported");
+    Check(cache.GetStats().entries == entries, "timed out result is not cached");
+    Check(rs->GetNext() == 0, "no rows after failed QueryCached");
+    db.SetStatementTimeout(0);
+    delete rs;
+}
+
+void
+TestMaterialized()
+{
+    cout << "# MaterializedResult\n";
+    Sqlite db;
+    if (!db.Connect(":memory:")) {
+        Check(false, "connect :memory:");
+        return;
+    }
+    db.UpdateStructure("CREATE TABLE mat(id integer, name text, price real)");
+    db.ExecuteModify("INSERT INTO mat VALUES(1, 'pear', 2.5), (2, NULL, 1.0), (3, 'apple', NULL)");
+    RowSet* rs = db.CreateRowSet();
+    long id;
+    optional<string> name;
+    optional<double> price;
+    rs->Bind(DT::LONG, &id);
+    rs->Bind(name);
+    rs->Bind(price);
+    rs->query << "SELECT id, name, price FROM mat ORDER BY id";
+    MaterializedResult result;
+    Check(result.Load(rs), "Load");
+    Check(result.GetRows() == 3 && result.GetColumns() == 3, "loaded size");
+    Check(result.GetStr(0, 1) == "pear" && result.IsNull(1, 1) && result.IsNull(2, 2),
+          "loaded values and NULLs");
+    result.Sort(1);
+    Check(result.IsNull(0, 1) && result.GetStr(1, 1) == "apple" && result.GetLong(2, 0) == 1,
+          "sorted by name");
+
+    rs->query.Clear();
+    rs->query << "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c) "
+                 "SELECT x, 'row', 1.0 FROM c WHERE x % 100000 = 0";
+    db.SetStatementTimeout(200);
+    Check(!result.Load(rs), "Load fails on timeout");
+    Check(db.IsTimeout() && result.GetRows() == 0, "failed Load is cleared");
+    db.SetStatementTimeout(0);
+    delete rs;
+}
+
+void
+TestArrow()
+{
+    cout << "# ArrowExporter\n";
+    Sqlite db;
+    if (!db.Connect(":memory:")) {
+        Check(false, "connect :memory:");
+        return;
+    }
+    db.UpdateStructure("CREATE TABLE arrow(id integer, name text)");
+    db.ExecuteModify("INSERT INTO arrow VALUES(1, 'one'), (2, NULL), (3, 'three')");
+    RowSet* rs = db.CreateRowSet();
+    long id;
+    optional<string> name;
+    rs->Bind(DT::LONG, &id);
+    rs->Bind(name);
+    rs->query << "SELECT id, name FROM arrow ORDER BY id";
+    ArrowExporter exporter(2);
+    exporter.SetColumnNames({ "id", "name" });
+    ostringstream out;
+    Check(exporter.Export(rs, out) == 3, "Export rows");
+    string file = out.str();
+    Check(file.size() > 16 && file.compare(0, 6, "ARROW1") == 0
+              && file.compare(file.size() - 6, 6, "ARROW1") == 0,
+          "Arrow file magic");
+    ostringstream stream;
+    Check(exporter.Export(rs, stream, ArrowExporter::IPC_STREAM) == 3, "Export stream");
+    string data = stream.str();
+    string eos("\xff\xff\xff\xff\0\0\0\0", 8);
+    Check(data.size() > 8 && data.compare(data.size() - 8, 8, eos) == 0,
+          "end of stream marker");
+
+    const char* path = "/tmp/ddb_export.arrow";
+    rs->query.Clear();
+    rs->query << "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c) "
+                 "SELECT x, 'row' FROM c WHERE x % 100000 = 0";
+    db.SetStatementTimeout(200);
+    Check(exporter.Export(rs, path) == -1, "Export fails on timeout");
+    Check(db.IsTimeout() && access(path, F_OK) != 0, "failed export removes the file");
+    db.SetStatementTimeout(0);
+    delete rs;
+}
+
+void
+TestDecimalErrors()
+{
+    cout << "# Decimal read errors\n";
+    Sqlite db;
+    if (!db.Connect(":memory:")) {
+        Check(false, "connect :memory:");
+        return;
+    }
+    db.UpdateStructure("CREATE TABLE dec_bad(id integer, v)");
+    db.ExecuteModify("INSERT INTO dec_bad VALUES(1, '1.5'), (2, 'abc'), (3, 1e300), (4, '2')");
+    RowSet* rs = db.CreateRowSet();
+    long id;
+    Decimal value;
+    rs->Bind(DT::LONG, &id);
+    rs->Bind(DT::DEC, &value);
+    const char* where[3] = { "id IN (1, 2)", "id IN (1, 3)", "id IN (1, 4)" };
+    for (int ndx = 0; ndx < 3; ndx++) {
+        rs->query.Clear();
+        rs->query << "SELECT id, v FROM dec_bad WHERE " << where[ndx] << " ORDER BY id";
+        Check(rs->Query(), "query decimal");
+        int rows = 0;
+        while (rs->GetNext() > 0)
+            rows++;
+        if (ndx < 2) {
+            Check(rows == 1 && rs->IsFailed(), "bad decimal fails GetNext");
+            Check(strstr(db.GetLastError(), "Decimal") != 0, "bad decimal error text");
+        } else
+            Check(rows == 2 && !rs->IsFailed() && value.ToString() == "2", "good decimals");
+    }
+    delete rs;
+}
+
+void
+TestBulk()
+{
+    cout << "# ExecuteBulk and ExecuteInsert\n";
+    Sqlite db;
+    if (!db.Connect(":memory:")) {
+        Check(false, "connect :memory:");
+        return;
+    }
+    db.UpdateStructure(
+        "CREATE TABLE bulk(id integer PRIMARY KEY, name text, tags text, data blob)");
+    vector<string> names = { "one", "two \"quoted\"", "three" };
+    vector<vector<string>> tags = { { "a", "b" }, {}, { "c,d" } };
+    const unsigned char bytes[] = { 0, 1, 2, 0xff };
+    vector<Blob> blobs = { Blob(bytes, 4), Blob(), Blob(bytes + 1, 2) };
+    BulkParams params;
+    params.Bind(names);
+    params.Bind(tags);
+    params.Bind(blobs);
+    vector<long long> ids;
+    Check(db.ExecuteBulkInsert("INSERT INTO bulk(name, tags, data) VALUES($1, $2, $3)", params,
+                               "id", ids) == 3,
+          "ExecuteBulkInsert");
+    Check(ids.size() == 3 && ids[0] == 1 && ids[2] == 3, "bulk insert keys");
+    Check(db.ExecuteInsert("INSERT INTO bulk(name) VALUES('four'), ('five')", "id", ids) &&
+              ids.size() == 2 && ids[1] == 5,
+          "ExecuteInsert");
+    Check(!db.ExecuteInsert("INSERT INTO bulk(name) VALUES('six')", "", ids),
+          "ExecuteInsert needs keys");
+
+    vector<long> update_ids = { 1, 2, 99 };
+    vector<string> update_names = { "uno", "dos", "none" };
+    BulkParams update;
+    update.Bind(update_names);
+    update.Bind(update_ids);
+    vector<int> affected;
+    Check(db.ExecuteBulk("UPDATE bulk SET name = $1 WHERE id = $2", update, &affected) == 2,
+          "ExecuteBulk update");
+    Check(affected.size() == 3 && affected[0] == 1 && affected[2] == 0, "affected rows");
+
+    RowSet* rs = db.CreateRowSet();
+    string name;
+    vector<string> tag_list;
+    optional<Blob> data;
+    rs->Bind(DT::STR, &name);
+    rs->Bind(tag_list);
+    rs->Bind(data);
+    rs->query << "SELECT name, tags, data FROM bulk WHERE id <= 3 ORDER BY id";
+    Check(rs->Query(), "query bulk rows");
+    Check(rs->GetNext() == 3 && name == "uno" && tag_list.size() == 2 && tag_list[1] == "b" &&
+              data && data->size == 4 && data->data[3] == 0xff,
+          "first bulk row");
+    Check(rs->GetNext() == 3 && name == "dos" && tag_list.empty() && data && !data->size,
+          "second bulk row");
+    Check(rs->GetNext() == 3 && name == "three" && tag_list.size() == 1 && tag_list[0] == "c,d",
+          "third bulk row");
+    Check(rs->GetNext() == 0 && !rs->IsFailed(), "end of bulk rows");
+    delete rs;
+}
+
+void
+TestNulls()
+{
+    cout << "# NULL indicators and std::optional\n";
+    Sqlite db;
+    if (!db.Connect(":memory:")) {
+        Check(false, "connect :memory:");
+        return;
+    }
+    db.UpdateStructure("CREATE TABLE nulls(id integer, name text, price real)");
+    db.ExecuteModify("INSERT INTO nulls VALUES(1, 'one', 1.5), (NULL, NULL, NULL)");
+    RowSet* rs = db.CreateRowSet();
+    long id = 0;
+    string name;
+    optional<double> price;
+    bool null_ind[2];
+    rs->Bind(DT::LONG, &id, &null_ind[0]);
+    rs->Bind(DT::STR, &name, &null_ind[1]);
+    rs->Bind(price);
+    rs->query << "SELECT id, name, price FROM nulls ORDER BY id DESC";
+    Check(rs->Query(), "query NULLs");
+    Check(rs->GetNext() == 3 && !null_ind[0] && !null_ind[1] && id == 1 && price == 1.5,
+          "row with values");
+    Check(rs->GetNext() == 3, "NULL fields are counted");
+    Check(null_ind[0] && null_ind[1] && id == 1 && name == "one" && !price,
+          "NULL sets the indicator and resets optional");
+    Check(rs->GetNext() == 0, "end of NULL rows");
+
+    // Without an indicator NULL clears the variable.
+    RowSet* plain = db.CreateRowSet();
+    plain->Bind(DT::LONG, &id);
+    plain->Bind(DT::STR, &name);
+    plain->query << "SELECT id, name FROM nulls WHERE id IS NULL";
+    Check(plain->Query() && plain->GetNext() == 2 && id == 0 && name.empty(),
+          "NULL without indicator is cleared");
+    delete plain;
+    delete rs;
+}
+
+void
+TestShards()
+{
+    cout << "# ShardedDatabase\n";
+    ShardedDatabase sdb;
+    for (int ndx = 0; ndx < 3; ndx++) {
+        Sqlite* shard = new Sqlite();
+        shard->Connect(":memory:");
+        sdb.AddShard("s" + to_string(ndx), shard);
+    }
+    Check(sdb.UpdateStructureAll("CREATE TABLE item(id integer, price text)"), "create on all");
+    Check(sdb.ExecuteModify("INSERT INTO item VALUES(0, '0')") < 0, "write without key fails");
+    const int count = 3000;
+    long long total = 0;
+    for (int id = 1; id <= count; id++) {
+        sdb.SetShardKey(id);
+        sdb.ExecuteModify("INSERT INTO item VALUES(" + to_string(id) + ", '1.5')");
+        total += id;
+    }
+    sdb.SetShardKey(7);
+    int found = 0;
+    Check(sdb.ExecuteIntFunction("SELECT count(*) FROM item WHERE id = 7", found) && found == 1,
+          "read with key");
+    sdb.ClearShardKey();
+
+    RowSet* rs = sdb.CreateRowSet();
+    long id;
+    Decimal price;
+    rs->Bind(DT::LONG, &id);
+    rs->Bind(DT::DEC, &price);
+    rs->query << "SELECT id, price FROM item";
+    Check(rs->Query(), "scatter-gather query");
+    int rows = 0;
+    long long sum = 0;
+    while (rs->GetNext() > 0) {
+        rows++;
+        sum += id;
+    }
+    Check(rows == count && sum == total && !rs->IsFailed(), "all shards' rows");
+
+    // Reading only a part stops the shard threads.
+    Check(rs->Query() && rs->GetNext() == 2, "partial read");
+    rs->Reset();
+
+    // Read error on one shard fails the read.
+    sdb.GetShard(1)->ExecuteModify("UPDATE item SET price = 'bad' WHERE id = "
+                                   "(SELECT max(id) FROM item)");
+    Check(rs->Query(), "query with a bad row");
+    while (rs->GetNext() > 0)
+        ;
+    Check(rs->IsFailed() && strstr(sdb.GetLastError(), "Decimal") != 0, "shard read error");
+
+    sdb.GetShard(2)->UpdateStructure("DROP TABLE item");
+    Check(!rs->Query(), "query fails when a shard fails");
+    delete rs;
+}
+
+void
+TestBlob()
+{
+    cout << "# SqliteBlob\n";
+    Sqlite db;
+    if (!db.Connect(":memory:")) {
+        Check(false, "connect :memory:");
+        return;
+    }
+    db.UpdateStructure("CREATE TABLE files(id integer PRIMARY KEY, data blob)");
+    db.ExecuteModify("INSERT INTO files VALUES(1, zeroblob(1000)), (2, x'0102030405')");
+    SqliteBlob* blob = db.OpenBlob("files", "data", 1, true);
+    if (!blob) {
+        Check(false, "OpenBlob");
+        return;
+    }
+    Check(blob->GetSize() == 1000, "blob size");
+    char part[100];
+    for (int ndx = 0; ndx < 10; ndx++) {
+        memset(part, 'a' + ndx, sizeof(part));
+        Check(blob->Write(part, sizeof(part)), "write part");
+    }
+    Check(!blob->Write(part, 1), "write past the end fails");
+    Check(blob->ReadAt(part, 10, 995) == false, "read past the end fails");
+    Check(blob->ReadAt(part, 2, 450) && part[0] == 'e' && part[1] == 'e', "ReadAt");
+    blob->Seek(990);
+    Check(blob->Read(part, sizeof(part)) == 10 && part[9] == 'j', "Read stops at the end");
+    Check(blob->Read(part, sizeof(part)) == 0, "Read at the end");
+
+    Check(blob->Reopen(2) && blob->GetSize() == 5 && blob->Tell() == 0, "Reopen");
+    Check(blob->Read(part, sizeof(part)) == 5 && part[4] == 5, "read reopened blob");
+    Check(!blob->Reopen(3), "Reopen of a missing row fails");
+    delete blob;
+
+    string data;
+    Check(db.ExecuteStrFunction("SELECT substr(data, 1, 3) FROM files WHERE id = 1", data) &&
+              data == "aaa",
+          "written blob content");
+}
+
+void
+TestPartitions()
+{
+    cout << "# PartitionedRowSet\n";
+    const char* file = "/tmp/ddb_part.db";
+    unlink(file);
+    Sqlite db[3];
+    for (Sqlite& con : db) {
+        if (!con.Connect(file)) {
+            Check(false, "connect partitions");
+            return;
+        }
+    }
+    db[0].UpdateStructure("CREATE TABLE part(id integer PRIMARY KEY, price text)");
+    db[0].UpdateStructure("INSERT INTO part WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL "
+                          "SELECT x + 1 FROM c WHERE x < 5000) SELECT x, '2.5' FROM c");
+    PartitionedRowSet rs;
+    for (Sqlite& con : db)
+        rs.AddConnection(&con);
+    rs.SetRange(1, 5001);
+    rs.SetOrdered(true);
+    rs.SetChunkRows(100);
+    long id;
+    Decimal price;
+    rs.Bind(DT::LONG, &id);
+    rs.Bind(DT::DEC, &price);
+    rs.query << "SELECT id, price FROM part WHERE id >= {low} AND id < {high} ORDER BY id";
+    Check(rs.Query(), "partitioned query");
+    long expected = 1;
+    bool in_order = true;
+    while (rs.GetNext() > 0)
+        in_order = in_order && id == expected++ && price.ToString() == "2.5";
+    Check(in_order && expected == 5001 && !rs.IsFailed(), "ordered rows of all partitions");
+
+    // Stopping early joins the partition threads.
+    Check(rs.Query() && rs.GetNext() == 2, "partial read");
+    rs.Reset();
+
+    db[0].ExecuteModify("UPDATE part SET price = 'bad' WHERE id = 4000");
+    Check(rs.Query(), "query with a bad row");
+    while (rs.GetNext() > 0)
+        ;
+    Check(rs.IsFailed() && strstr(rs.GetLastError(), "Decimal") != 0, "partition read error");
+
+    PartitionedRowSet batch;
+    for (Sqlite& con : db)
+        batch.AddConnection(&con);
+    batch.SetRange(1, 5001);
+    vector<long> ids;
+    batch.BindBatch(ids);
+    batch.query << "SELECT id FROM part WHERE id >= {low} AND id < {high}";
+    Check(batch.Query(), "batch query");
+    size_t rows = 0, got;
+    long long sum = 0;
+    while ((got = batch.GetBatch(700)) > 0) {
+        Check(got <= 700 && got == ids.size(), "batch size");
+        rows += got;
+        for (long value : ids)
+            sum += value;
+    }
+    Check(rows == 5000 && sum == 5000LL * 5001 / 2, "all rows in batches");
+    for (Sqlite& con : db)
+        con.Disconnect();
+    unlink(file);
+}
+
 int
 main(int argc, char** argv)
 {
     int ret;
     sqlite3* connection;
 
+    TestDecimal();
+    TestDecimalSqlite();
+    TestJson();
+    TestConnect();
+    TestPool();
+    TestCache();
+    TestMaterialized();
+    TestArrow();
+    TestDecimalErrors();
+    TestBulk();
+    TestNulls();
+    TestShards();
+    TestBlob();
+    TestPartitions();
+    if (g_failed) {
+        cout << g_failed << " checks failed.\n";
+        return 1;
+    }
+    cout << "All checks passed.\n";
+
     if (argc == 1) {
         cout << "Missing database argument.\n";
         return 1;
@@ -0,0 +1,219 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <string.h>
+#include <climits>
+#include <cpp4scripts.hpp>
+
+#include "directdb.hpp"
+
+using namespace std;
+
+namespace ddb {
+
+static const unsigned long long POW10[] = { 1ULL,
+                                            10ULL,
+                                            100ULL,
+                                            1000ULL,
+                                            10000ULL,
+                                            100000ULL,
+                                            1000000ULL,
+                                            10000000ULL,
+                                            100000000ULL,
+                                            1000000000ULL,
+                                            10000000000ULL,
+                                            100000000000ULL,
+                                            1000000000000ULL,
+                                            10000000000000ULL,
+                                            100000000000000ULL,
+                                            1000000000000000ULL,
+                                            10000000000000000ULL,
+                                            100000000000000000ULL,
+                                            1000000000000000000ULL };
+
+// Magnitude is kept unsigned so that LLONG_MIN can be parsed.
+static const unsigned long long MAX_MAGNITUDE = (unsigned long long)LLONG_MAX + 1;
+
+// -------------------------------------------------------------------------------------------------
+bool
+Decimal::Parse(const char* text, size_t len)
+/*!
+  Parses plain decimal text e.g. "-123.4500" or the exponent form "1.5e-3" that Sqlite uses for
+  real values. Scale is the number of decimals in the text so "1.50" has scale 2. Decimals beyond
+  MAX_SCALE are rounded half away from zero.
+  \retval bool False if the text is not a number or the value does not fit. Value is then unchanged.
+*/
+{
+    const char* end = text + len;
+    while (text < end && (*text == ' ' || *text == '\t'))
+        text++;
+    bool negative = false;
+    if (text < end && (*text == '-' || *text == '+'))
+        negative = *text++ == '-';
+
+    unsigned long long magnitude = 0;
+    int digits = 0, decimals = 0;
+    bool point = false, round_up = false, dropped = false;
+    for (; text < end; text++) {
+        if (*text == '.' && !point) {
+            point = true;
+            continue;
+        }
+        if (*text < '0' || *text > '9')
+            break;
+        digits++;
+        unsigned int digit = *text - '0';
+        if (point && decimals == MAX_SCALE) {
+            // Only the first dropped digit decides the rounding.
+            if (!dropped)
+                round_up = digit >= 5;
+            dropped = true;
+            continue;
+        }
+        if (magnitude > (MAX_MAGNITUDE - digit) / 10)
+            return false;
+        magnitude = magnitude * 10 + digit;
+        if (point)
+            decimals++;
+    }
+    if (!digits)
+        return false;
+
+    int exponent = 0;
+    if (text < end && (*text == 'e' || *text == 'E')) {
+        text++;
+        bool exp_negative = false;
+        if (text < end && (*text == '-' || *text == '+'))
+            exp_negative = *text++ == '-';
+        if (text == end || *text < '0' || *text > '9')
+            return false;
+        for (; text < end && *text >= '0' && *text <= '9'; text++) {
+            exponent = exponent * 10 + (*text - '0');
+            if (exponent > 2 * MAX_SCALE + 20)
+                return false;
+        }
+        if (exp_negative)
+            exponent = -exponent;
+    }
+    while (text < end && (*text == ' ' || *text == '\t'))
+        text++;
+    if (text != end && *text)
+        return false;
+
+    if (round_up && ++magnitude > MAX_MAGNITUDE)
+        return false;
+    int new_scale = decimals - exponent;
+    if (new_scale < 0) {
+        if (-new_scale > MAX_SCALE || magnitude > MAX_MAGNITUDE / POW10[-new_scale])
+            return false;
+        magnitude *= POW10[-new_scale];
+        new_scale = 0;
+    } else if (new_scale > MAX_SCALE) {
+        unsigned int last = 0;
+        for (; new_scale > MAX_SCALE; new_scale--) {
+            last = magnitude % 10;
+            magnitude /= 10;
+        }
+        if (last >= 5)
+            magnitude++;
+    }
+    if (!negative && magnitude > (unsigned long long)LLONG_MAX)
+        return false;
+    if (magnitude == MAX_MAGNITUDE)
+        units = LLONG_MIN;
+    else
+        units = negative ? -(long long)magnitude : (long long)magnitude;
+    scale = new_scale;
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+Decimal::Rescale(int scale_in)
+/*!
+  Changes the number of decimals. Removed decimals are rounded half away from zero.
+  \retval bool False if the scale is out of range or the value would not fit. Value is then
+  unchanged.
+*/
+{
+    if (scale_in < 0 || scale_in > MAX_SCALE || scale < 0 || scale > MAX_SCALE)
+        return false;
+    if (scale_in >= scale) {
+        long long factor = (long long)POW10[scale_in - scale];
+        if (units > LLONG_MAX / factor || units < LLONG_MIN / factor)
+            return false;
+        units *= factor;
+    } else {
+        long long divisor = (long long)POW10[scale - scale_in];
+        long long rest = units % divisor;
+        units /= divisor;
+        if (rest * 2 >= divisor)
+            units++;
+        else if (rest * 2 <= -divisor)
+            units--;
+    }
+    scale = scale_in;
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+char*
+Decimal::Format(char* buffer) const
+/*!
+  Writes the value with exactly 'scale' decimals and without exponent, e.g. "-0.050". Uses only
+  the given buffer so this can be called from several threads at the same time.
+  \param buffer At least MAX_TEXT bytes.
+  \retval char* Pointer to the terminating zero.
+*/
+{
+    char digits[24];
+    unsigned long long magnitude = units < 0 ? 0ULL - (unsigned long long)units : units;
+    int count = 0;
+    do {
+        digits[count++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+    int decimals = scale < 0 ? 0 : scale > MAX_SCALE ? MAX_SCALE : scale;
+    while (count <= decimals)
+        digits[count++] = '0';
+
+    char* end = buffer;
+    if (units < 0)
+        *end++ = '-';
+    while (count > decimals)
+        *end++ = digits[--count];
+    if (decimals) {
+        *end++ = '.';
+        while (count)
+            *end++ = digits[--count];
+    }
+    *end = 0;
+    return end;
+}
+
+// -------------------------------------------------------------------------------------------------
+string
+Decimal::ToString() const
+{
+    char buffer[MAX_TEXT];
+    return string(buffer, Format(buffer) - buffer);
+}
+
+// -------------------------------------------------------------------------------------------------
+double
+Decimal::ToDouble() const
+/*!
+  Nearest double for calculations. The conversion is not exact for most values.
+*/
+{
+    if (scale <= 0 || scale > MAX_SCALE)
+        return (double)units;
+    return (double)units / (double)POW10[scale];
+}
+
+}; // namespace ddb
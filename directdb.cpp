@@ -11,7 +11,11 @@
 #include <locale.h>
 #include <fstream>
 #include <sstream>
+#include <charconv>
 #include <cpp4scripts.hpp>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "directdb.hpp"
 
@@ -46,8 +50,9 @@ Database::Database()
 
     le_size = 0x400;
     last_error = new char[le_size];
-
-    RowSet::InitQueryBuffer();
+    cache = 0;
+    stmt_timeout = 0;
+    timed_out = false;
 }
 // -------------------------------------------------------------------------------------------------
 Database::~Database()
@@ -59,7 +64,6 @@ Database::~Database()
     if (scratch_buffer)
         delete[] scratch_buffer;
     delete[] last_error;
-    RowSet::DeleteQueryBuffer();
 }
 // -------------------------------------------------------------------------------------------------
 void 
@@ -88,64 +92,133 @@ Database::AppendLastError(const char *text)
     strcat(last_error, text);
 }
 // -------------------------------------------------------------------------------------------------
-const char*
-Database::CleanStr(const char* str)
+// String cleaning helpers. Quotes are doubled and, for the normal cleaning, carriage returns
+// are dropped. The scan uses SSE2 to skip 16 bytes at a time when it is available.
+
+template <bool SKIP_CR>
+static const char*
+FindCleanChar(const char* str, const char* end)
 {
-    size_t max = strlen(str) + 64;
-    reallocateScratch(max);
-    char* to = scratch_buffer;
-    char* end = scratch_buffer + max;
-    while (to < end && *str) {
-        if (*str == '\'') {
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('\'');
+    const __m128i cr = _mm_set1_epi8('\r');
+    while (end - str >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str));
+        __m128i hit = _mm_cmpeq_epi8(chunk, quote);
+        if (SKIP_CR)
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(chunk, cr));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask)
+            return str + __builtin_ctz(mask);
+        str += 16;
+    }
+#endif
+    while (str < end && *str != '\'' && (!SKIP_CR || *str != '\r'))
+        str++;
+    return str;
+}
+
+template <bool SKIP_CR>
+static size_t
+CleanedLength(const char* str, size_t len)
+{
+    const char* end = str + len;
+    size_t result = len;
+    for (str = FindCleanChar<SKIP_CR>(str, end); str < end;
+         str = FindCleanChar<SKIP_CR>(str + 1, end)) {
+        if (*str == '\'')
+            result++;
+        else
+            result--;
+    }
+    return result;
+}
+
+template <bool SKIP_CR>
+static size_t
+CleanInto(char* to, const char* str, size_t len)
+{
+    const char* end = str + len;
+    char* start = to;
+    while (str < end) {
+        const char* hit = FindCleanChar<SKIP_CR>(str, end);
+        memcpy(to, str, hit - str);
+        to += hit - str;
+        if (hit == end)
+            break;
+        if (*hit == '\'') {
             *to++ = '\'';
             *to++ = '\'';
-        } else if (*str != '\r') // skip the carriage return
-            *to++ = *str;
-        str++;
+        }
+        str = hit + 1;
     }
-    *to = 0;
+    return to - start;
+}
+
+// -------------------------------------------------------------------------------------------------
+size_t
+Database::CleanLength(const char* str, size_t len)
+{
+    return CleanedLength<true>(str, len);
+}
+size_t
+Database::CleanCopy(char* to, const char* str, size_t len)
+{
+    size_t count = CleanInto<true>(to, str, len);
+    to[count] = 0;
+    return count;
+}
+void
+Database::AppendClean(std::string& to, const char* str, size_t len)
+{
+    size_t start = to.size();
+    to.resize(start + CleanedLength<true>(str, len));
+    CleanInto<true>(&to[start], str, len);
+}
+void
+Database::AppendClean(std::ostream& to, const char* str, size_t len)
+{
+    const char* end = str + len;
+    while (str < end) {
+        const char* hit = FindCleanChar<true>(str, end);
+        to.write(str, hit - str);
+        if (hit == end)
+            break;
+        if (*hit == '\'')
+            to.write("\'\'", 2);
+        str = hit + 1;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+const char*
+Database::CleanStr(const char* str)
+{
+    size_t len = strlen(str);
+    reallocateScratch(CleanedLength<true>(str, len) + 1);
+    CleanCopy(scratch_buffer, str, len);
     return scratch_buffer;
 }
 string
 Database::CleanStr(const std::string& str)
 {
     string result;
-    string::const_iterator chi, end;
-
-    chi = str.begin();
-    end = str.end();
-    while (chi != end) {
-        if (*chi == '\'') {
-            result += "''";
-        } else if (*chi != '\r') // skip the carriage return
-            result += *chi;
-        chi++;
-    }
+    AppendClean(result, str.data(), str.size());
     return result;
 }
 // -------------------------------------------------------------------------------------------------
 const char*
 Database::GetCleanHtml(const string& str)
 {
-    reallocateScratch(str.length());
-    char* to = scratch_buffer;
-    const char* from = str.c_str();
-    while (*from) {
-        if (*from == '\'') {
-            *to++ = '\'';
-            *to++ = '\'';
-        } else
-            *to++ = *from;
-        from++;
-    }
-    *to = 0;
+    reallocateScratch(CleanedLength<false>(str.data(), str.size()) + 1);
+    scratch_buffer[CleanInto<false>(scratch_buffer, str.data(), str.size())] = 0;
     return scratch_buffer;
 }
 
 void
 Database::CleanReverse(string& str, CLEANTYPE /*ct*/)
 {
-    reallocateScratch(str.length());
+    reallocateScratch(str.length() + 1);
     char* to = scratch_buffer;
     const char* from = str.c_str();
 
@@ -170,6 +243,8 @@ Database::CleanReverse(string& str, CLEANTYPE /*ct*/)
 int
 Database::PrintNumber(char* buffer, const char* format, double number)
 {
+    if (!format)
+        return FormatNumber(buffer, number) - buffer;
     int bLen = sprintf(buffer, format, number);
     if (commaDecimal) {
         for (int i = 0; i < bLen; i++) {
@@ -186,21 +261,31 @@ Database::PrintNumber(char* buffer, const char* format, double number)
 const char*
 Database::PrintNumber(double number)
 {
-    static char buffer[30]; // It is doubtful that this many numbers can be printed from double.
-    char* ptr = buffer;
-    char* end = buffer + sprintf(buffer, "%f", number);
-    if (commaDecimal) {
-        while (ptr < end) {
-            if (*ptr == ',') {
-                *ptr = '.';
-                break;
-            }
-            ptr++;
-        }
-    }
+    thread_local char buffer[NUMBER_TEXT];
+    FormatNumber(buffer, number);
     return buffer;
 }
 
+// -------------------------------------------------------------------------------------------------
+char*
+Database::FormatNumber(char* buffer, double number)
+/*!
+  std::to_chars does not depend on the locale and gives the shortest round trip text, e.g. 0.1
+  and 1e+300. Large values keep all their digits unlike with "%f".
+*/
+{
+    char* end = to_chars(buffer, buffer + NUMBER_TEXT - 1, number).ptr;
+    *end = 0;
+    return end;
+}
+char*
+Database::FormatNumber(char* buffer, long long number)
+{
+    char* end = to_chars(buffer, buffer + NUMBER_TEXT - 1, number).ptr;
+    *end = 0;
+    return end;
+}
+
 // ------------------------------------------------------------------------------------------
 // Static functions
 
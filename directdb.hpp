@@ -13,6 +13,19 @@
 #include <fstream>
 #include <stdint.h>
 #include <sstream>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <string_view>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
 
 namespace ddb {
 
@@ -33,7 +46,70 @@ enum class DT
     TIME, // Timestamp: Date and time
     NUM,  // Numeric (double)
     DAY,  // Date only
-    CHR   // Single character
+    CHR,      // Single character
+    // PostgreSQL row sets read the result in binary format when a BLOB, VEC_ or DEC field is
+    // bound. Values are the same as from the text format but each type accepts only the columns
+    // it can be converted from, e.g. DT::STR text, number, date, array and json columns and
+    // DT::TIME date and timestamp. Others (uuid, interval, time, ...) fail the query: cast them
+    // in the query. Timestamptz is accepted when the session TimeZone is UTC.
+    BLOB,     // Binary data (Blob). PostgreSQL bytea.
+    VEC_LONG, // std::vector<long>. PostgreSQL int2[], int4[], int8[].
+    VEC_NUM,  // std::vector<double>. PostgreSQL float4[], float8[], numeric[].
+    VEC_STR,  // std::vector<std::string>. PostgreSQL text[], varchar[].
+    DEC       // Fixed-point Decimal. PostgreSQL numeric.
+};
+
+//! Binary value of DT::BLOB.
+/*! Blob does not own the bytes. When read by GetNext it points into the row set's result and is
+  valid until the next GetNext, Query or Reset. Copy the bytes to keep them. In BulkParams it
+  points to the caller's memory which must stay valid until the statement has been executed.
+*/
+struct Blob
+{
+    Blob()
+      : data(0)
+      , size(0)
+    {}
+    Blob(const void* data_in, size_t size_in)
+      : data(static_cast<const unsigned char*>(data_in))
+      , size(size_in)
+    {}
+    const unsigned char* begin() const { return data; }
+    const unsigned char* end() const { return data + size; }
+    bool empty() const { return size == 0; }
+
+    const unsigned char* data;
+    size_t size;
+};
+
+//! Fixed-point value of DT::DEC.
+/*! Value is units / 10^scale, e.g. Decimal(12345, 2) is 123.45. Conversions to and from text and
+  PostgreSQL numeric are exact and do not go through double. Units are 64 bits so the value has at
+  most 18 significant digits; values that do not fit are reported as errors.
+*/
+struct Decimal
+{
+    Decimal()
+      : units(0)
+      , scale(0)
+    {}
+    Decimal(long long units_in, int scale_in)
+      : units(units_in)
+      , scale(scale_in)
+    {}
+
+    bool Parse(const char* text, size_t len);
+    bool Parse(const std::string& text) { return Parse(text.data(), text.size()); }
+    bool Rescale(int scale_in);
+    char* Format(char* buffer) const;
+    std::string ToString() const;
+    double ToDouble() const;
+
+    static const int MAX_SCALE = 18;
+    static const size_t MAX_TEXT = 24; //!< Buffer size for Format, terminating zero included.
+
+    long long units;
+    int scale;
 };
 
 // Schema types to query with FindSchemaItem
@@ -59,17 +135,454 @@ const short int FLAG_TRANSACT_ON = 0x0004;
 class BoundField
 {
   public:
+    //! Modes of the std::optional access function.
+    enum
+    {
+        OPT_RESET,
+        OPT_EMPLACE,
+        OPT_GET
+    };
+
     BoundField(DT, void*);
     virtual ~BoundField();
 
+    /*! Returns the address GetNext writes the value to, or null if the value is NULL and there
+        is nothing to write. Without a NULL indicator or std::optional NULL is written as zero,
+        empty string or zeroed tm as before.
+     */
+    void* Target(bool is_null)
+    {
+        if (null_ind)
+            *null_ind = is_null;
+        if (optional)
+            return optional(data, is_null ? OPT_RESET : OPT_EMPLACE);
+        return is_null && null_ind ? 0 : data;
+    }
+    //! Returns the address of the current value and whether it is NULL.
+    const void* Source(bool& is_null)
+    {
+        if (optional) {
+            void* value = optional(data, OPT_GET);
+            is_null = !value;
+            return value;
+        }
+        is_null = null_ind && *null_ind;
+        return data;
+    }
+
     DT type;          //!< Field type. One of DDBT... constants
-    void* data;       //!< Pointer to client data buffer.
+    void* data;       //!< Pointer to client data buffer or to std::optional.
+    bool* null_ind;   //!< Set to true/false by GetNext for NULL/value. Can be null.
+    void* (*optional)(void* opt, int mode); //!< Access function when data is std::optional.
     BoundField* next; //!< Pointer to next bound field. Null signifies end of the list.
 };
 
+//! std::optional access function for BoundField.
+template <class T>
+void*
+OptionalAccess(void* opt, int mode)
+{
+    std::optional<T>* value = static_cast<std::optional<T>*>(opt);
+    if (mode == BoundField::OPT_RESET) {
+        value->reset();
+        return 0;
+    }
+    if (mode == BoundField::OPT_EMPLACE && !*value)
+        value->emplace();
+    return *value ? &**value : 0;
+}
+
 class RowSet;
 class RSInterface;
 
+//! Appends the bound variable's value to 'data' in native form (internal use).
+void
+PackValue(std::string& data, DT type, const void* value);
+//! Reads a value written by PackValue into the bound variable. Returns the next read position.
+const char*
+UnpackValue(const char* data, DT type, void* value);
+//! Appends the vector of a VEC_ type as text: {1,2,3} for PostgreSQL or [1,2,3] if json is true.
+void
+FormatArray(DT type, const void* values, bool json, std::string& out);
+//! Parses {1,2,3} or [1,2,3] text into the vector of a VEC_ type. NULL elements become 0 or "".
+bool
+ParseArray(DT type, const char* text, void* values);
+//! Sets the variable to the value used for NULL: zero, empty string, zeroed tm or empty Blob.
+void
+ClearValue(DT type, void* value);
+//! Appends NULL flag and the value unless it is NULL (internal use).
+void
+PackField(std::string& data, DT type, const void* value, bool is_null);
+//! Reads a value written by PackField into the bound field. Returns the next read position.
+const char*
+UnpackField(const char* data, BoundField* field);
+
+//! Storage for one value of any type for row sets that read rows on behalf of the caller.
+struct ValueSlot
+{
+    int i;
+    long l;
+    double d;
+    bool b;
+    char c;
+    tm t;
+    std::string s;
+    Blob x;
+    std::vector<long> vl;
+    std::vector<double> vd;
+    std::vector<std::string> vs;
+    Decimal m;
+    bool null;
+
+    //! Returns the member that holds the given type, i.e. the pointer to pass to Bind.
+    void* Address(DT type);
+};
+
+// -------------------------------------------------------------------------------------------------
+//! Parameter columns for Database::ExecuteBulk.
+/*! Each bound column is an array with one value per row. Values are read from the caller's
+  memory during ExecuteBulk so the arrays must stay valid until it returns. All columns must have
+  the same number of rows. Array element types are the same as with RowSet::Bind, i.e. DT::INT is
+  int[], DT::STR is std::string[], DT::TIME is tm[], etc.
+
+  Statement refers to the columns with $1, $2, ... in bind order. This works with PostgreSQL and
+  Sqlite alike. DT::BLOB values are Blob[] and they are sent as binary without copying. VEC_
+  values are arrays of vectors. PostgreSQL gets them as array text, e.g. {1,2,3}, which the
+  server converts to the parameter's type, e.g. int4[] or varchar[], and Sqlite as JSON array
+  text.
+*/
+class BulkParams
+{
+  public:
+    struct Column
+    {
+        DT type;
+        const void* data;
+    };
+
+    BulkParams() { rows = 0; }
+
+    bool Bind(DT type, const void* data, size_t count);
+    bool Bind(const std::vector<int>& values)
+    {
+        return Bind(DT::INT, values.data(), values.size());
+    }
+    bool Bind(const std::vector<long>& values)
+    {
+        return Bind(DT::LONG, values.data(), values.size());
+    }
+    bool Bind(const std::vector<double>& values)
+    {
+        return Bind(DT::NUM, values.data(), values.size());
+    }
+    bool Bind(const std::vector<std::string>& values)
+    {
+        return Bind(DT::STR, values.data(), values.size());
+    }
+    bool Bind(const std::vector<tm>& values)
+    {
+        return Bind(DT::TIME, values.data(), values.size());
+    }
+    bool Bind(const std::vector<Blob>& values)
+    {
+        return Bind(DT::BLOB, values.data(), values.size());
+    }
+    bool Bind(const std::vector<Decimal>& values)
+    {
+        return Bind(DT::DEC, values.data(), values.size());
+    }
+    bool Bind(const std::vector<std::vector<long>>& values)
+    {
+        return Bind(DT::VEC_LONG, values.data(), values.size());
+    }
+    bool Bind(const std::vector<std::vector<double>>& values)
+    {
+        return Bind(DT::VEC_NUM, values.data(), values.size());
+    }
+    bool Bind(const std::vector<std::vector<std::string>>& values)
+    {
+        return Bind(DT::VEC_STR, values.data(), values.size());
+    }
+    void Clear()
+    {
+        columns.clear();
+        rows = 0;
+    }
+    size_t GetRows() const { return rows; }
+    size_t GetColumns() const { return columns.size(); }
+    const Column& GetColumn(size_t col) const { return columns[col]; }
+
+    //! Appends text presentation of the value and terminating zero to 'out'.
+    void FormatText(size_t row, size_t col, std::string& out) const;
+
+  protected:
+    std::vector<Column> columns;
+    size_t rows;
+};
+
+// -------------------------------------------------------------------------------------------------
+//! Append-only buffer for building SQL statements.
+/*! QueryBuffer replaces the string stream as the RowSet query. Text is kept zero terminated in
+  one growing buffer so that it can be handed to the database client library as it is. Clear
+  keeps the reserved memory, i.e. repeated queries with the same row set do not allocate.
+
+  Output operator (<<) is supported for the same basic types as with std::stringstream so that
+  the usual 'rs->query << "SELECT ..." << id' code works unchanged.
+*/
+class QueryBuffer
+{
+  public:
+    QueryBuffer();
+    ~QueryBuffer() { delete[] buffer; }
+    QueryBuffer(const QueryBuffer&) = delete;
+    QueryBuffer& operator=(const QueryBuffer&) = delete;
+
+    //! Empties the statement. Reserved memory is kept for the next query.
+    void Clear()
+    {
+        length = 0;
+        buffer[0] = 0;
+    }
+    //! Returns zero terminated statement text.
+    const char* GetText() const { return buffer; }
+    //! Returns statement length in bytes without the terminating zero.
+    size_t GetLength() const { return length; }
+    bool IsEmpty() const { return length == 0; }
+    //! Makes sure that at least 'size' more bytes can be appended without reallocation.
+    void Reserve(size_t size)
+    {
+        if (length + size >= capacity)
+            grow(size);
+    }
+
+    QueryBuffer& Append(const char* text, size_t len);
+    QueryBuffer& Append(const char* text);
+    QueryBuffer& Append(const std::string& text) { return Append(text.data(), text.size()); }
+    QueryBuffer& Append(char ch);
+    QueryBuffer& Append(int number) { return Append((long long)number); }
+    QueryBuffer& Append(unsigned int number) { return Append((unsigned long long)number); }
+    QueryBuffer& Append(long number) { return Append((long long)number); }
+    QueryBuffer& Append(unsigned long number) { return Append((unsigned long long)number); }
+    QueryBuffer& Append(long long number);
+    QueryBuffer& Append(unsigned long long number);
+    //! Appends shortest representation of the number that reads back to the same value.
+    QueryBuffer& Append(double number);
+    //! Appends the decimal exactly with its scale.
+    QueryBuffer& Append(const Decimal& number);
+    //! Appends the text as a quoted SQL string literal. Text is cleaned as with CleanStr.
+    QueryBuffer& AppendStr(const char* text, size_t len);
+    QueryBuffer& AppendStr(const std::string& text)
+    {
+        return AppendStr(text.data(), text.size());
+    }
+    //! Appends a quoted SQL identifier (e.g. table or column name).
+    QueryBuffer& AppendIdent(const char* name, size_t len);
+    QueryBuffer& AppendIdent(const std::string& name)
+    {
+        return AppendIdent(name.data(), name.size());
+    }
+
+    template <class T>
+    QueryBuffer& operator<<(const T& value)
+    {
+        return Append(value);
+    }
+
+    // std::stringstream compatibility.
+    std::string str() const { return std::string(buffer, length); }
+    void str(const char* text)
+    {
+        Clear();
+        Append(text);
+    }
+    long tellp() const { return (long)length; }
+
+  protected:
+    void grow(size_t size);
+
+    char* buffer;    //!< Zero terminated statement.
+    size_t length;   //!< Current statement length.
+    size_t capacity; //!< Reserved size for the buffer.
+};
+
+// -------------------------------------------------------------------------------------------------
+//! Writes query results as JSON. See RowSet::WriteJson.
+/*! Result is an array with one object per row ([{"id":1,"name":"x"},...]) or one array per row
+  ([[1,"x"],...]). Values keep the database's native types: numbers are written as JSON numbers,
+  booleans as true/false and NULLs as null. BLOBs are written as strings in the PostgreSQL hex
+  format (\\x0102...).
+
+  Without a sink the whole JSON is collected into the writer's buffer. With a sink the buffer is
+  handed to the sink each time a row ends and at least chunk size bytes are pending, i.e. the
+  response can be sent while the query is still being read. Buffer is reused between chunks.
+*/
+class JsonWriter
+{
+  public:
+    enum LAYOUT
+    {
+        OBJECTS, //!< Each row is an object with the column names as keys.
+        ARRAYS   //!< Each row is an array of values in column order.
+    };
+    //! Receives the output. Returning false stops the writing and fails the WriteJson.
+    typedef std::function<bool(const char* data, size_t len)> Sink;
+
+    JsonWriter(LAYOUT layout_in = OBJECTS);
+    JsonWriter(const Sink& sink_in, size_t chunk_in = 0x4000, LAYOUT layout_in = OBJECTS);
+    ~JsonWriter();
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    //! Returns the text written since the last flush. Zero terminated.
+    const char* GetText() const { return buffer; }
+    size_t GetLength() const { return length; }
+    //! Clears the buffer. Row sets call this at the start of WriteJson when there is no sink.
+    void Clear();
+
+    // Row set interface. Values are written in column order after BeginRow.
+    void BeginResult();
+    void AddColumn(const char* name, size_t len);
+    void AddColumn(const char* name);
+    void BeginRow();
+    void Null();
+    void Bool(bool value);
+    void Number(long long value);
+    //! NaN and infinity are written as null.
+    void Number(double value);
+    //! Writes a number that is already valid JSON number text.
+    void Number(const char* text, size_t len) { Raw(text, len); }
+    void String(const char* text, size_t len);
+    void Binary(const void* data, size_t len);
+    //! Writes the text without escaping, e.g. a JSON column.
+    void Raw(const char* text, size_t len);
+    //! Ends the row. \retval bool False if the sink refused the output.
+    bool EndRow();
+    //! Ends the array and flushes the rest. \retval bool False if the sink refused the output.
+    bool EndResult();
+
+  protected:
+    void value();
+    void quote(const char* text, size_t len);
+    void reserve(size_t size)
+    {
+        if (length + size >= capacity)
+            grow(size);
+    }
+    void grow(size_t size);
+    bool flush();
+
+    LAYOUT layout;
+    Sink sink;
+    size_t chunk;    //!< Flush threshold with a sink.
+    char* buffer;    //!< Zero terminated output.
+    size_t length;   //!< Current output length.
+    size_t capacity; //!< Reserved size for the buffer.
+    std::vector<std::string> keys; //!< Quoted and escaped column names with the colon.
+    size_t column;  //!< Next column of the current row.
+    size_t rows;    //!< Rows written in the current result.
+};
+
+// -------------------------------------------------------------------------------------------------
+//! Client side cache for query results.
+/*! Cache is opt-in: it is attached to one or more Database objects with SetResultCache and it
+  is used only through the Cached...Function and QueryCached functions. Results are stored by
+  the SQL text (parameters are part of the text) and the result type. Cache is thread safe and
+  the same object can be shared by all connections of a pool. Keys are divided into shards,
+  each with its own lock and LRU list so that threads rarely wait for each other.
+
+  Each entry has a time to live and a list of tags, typically the names of the tables the query
+  reads. After modifying a table the application calls Invalidate with the table name. When the
+  memory cap is reached the least recently used entries are dropped.
+*/
+class ResultCache
+{
+  public:
+    typedef std::shared_ptr<const std::string> Data;
+
+    struct Stats
+    {
+        size_t hits;
+        size_t misses;
+        size_t evictions;   //!< Entries dropped due to the memory cap.
+        size_t expired;     //!< Entries dropped due to TTL.
+        size_t invalidated; //!< Entries dropped by Invalidate.
+        size_t entries;
+        size_t bytes;
+    };
+
+    /*! \param max_bytes Memory cap for keys and data.
+        \param ttl_ms Default time to live for entries.
+        \param shard_count Number of independently locked shards.
+     */
+    ResultCache(size_t max_bytes = 0x4000000, unsigned int ttl_ms = 60000,
+                unsigned int shard_count = 16);
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    //! Returns the data for the key or empty pointer if there is no valid entry.
+    Data Get(const std::string& key);
+    /*! Stores data for the key replacing any existing entry.
+        \param ttl_ms Time to live. Zero uses the cache default.
+        \param tags Comma separated list of tags, e.g. table names. Can be null.
+     */
+    void Put(const std::string& key, Data data, unsigned int ttl_ms, const char* tags);
+    //! Removes all entries with the tag. Returns the number of entries removed.
+    size_t Invalidate(const char* tag);
+    void Clear();
+    Stats GetStats();
+    unsigned int GetDefaultTTL() { return default_ttl; }
+
+  protected:
+    struct Entry
+    {
+        std::string key;
+        Data data;
+        std::vector<std::string> tags;
+        std::chrono::steady_clock::time_point expires;
+        size_t bytes;
+    };
+    struct Shard
+    {
+        std::mutex mutex;
+        std::list<Entry> lru; //!< Most recently used first.
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+        //! Keys of the entries by tag. Views refer to the entries' keys.
+        std::unordered_map<std::string, std::unordered_set<std::string_view>> tagged;
+        size_t bytes;
+        Stats stats;
+    };
+    Shard& shardOf(const std::string& key);
+    void erase(Shard& shard, std::list<Entry>::iterator it);
+
+    std::unique_ptr<Shard[]> shards;
+    unsigned int shard_count;
+    size_t shard_bytes;       //!< Memory cap for one shard.
+    unsigned int default_ttl; //!< Default time to live in milliseconds.
+};
+
+// -------------------------------------------------------------------------------------------------
+//! Controls how a lost connection is restored. See Database::SetReconnectPolicy.
+struct ReconnectPolicy
+{
+    ReconnectPolicy()
+    {
+        enabled = true;
+        initial_ms = 100;
+        max_ms = 30000;
+        multiplier = 2.0;
+        jitter = 0.5;
+        connect_timeout_ms = 5000;
+        replay_reads = true;
+    }
+    bool enabled;                    //!< Reconnect automatically when the connection is lost.
+    unsigned int initial_ms;         //!< Wait after the first failed attempt.
+    unsigned int max_ms;             //!< Upper limit for the wait.
+    double multiplier;               //!< Wait grows by this after each failed attempt.
+    double jitter;                   //!< Random part of the wait, 0 - 1.
+    unsigned int connect_timeout_ms; //!< Time limit for one reconnect attempt.
+    bool replay_reads;               //!< Rerun failed reads outside transactions after reconnect.
+};
+
 // -------------------------------------------------------------------------------------------------
 //! Database class represents the connection to the database.
 /*! This class wraps the connection functionality. Each database application must have at
@@ -221,7 +734,8 @@ class Database
         In PostgreSQL field type is SEQUENCE,
         in MySql the field type is AUTO INCREMENT.
         For other databases this function returns 0. Please see further details from your database
-       manual. \retval unsigned int Auto increment field value from last insert.
+       manual. On PostgreSQL this costs an extra round trip; ExecuteInsert avoids it.
+       \retval unsigned int Auto increment field value from last insert.
      */
     virtual unsigned long GetInsertId() = 0;
 
@@ -247,21 +761,73 @@ class Database
     // END OF PURE VIRTUAL FUNCTIONS
     //------------------------------------------------------------------------------------------
 
+    /*! Executes the INSERT, UPDATE or DELETE statement once for each row in the parameter
+        columns. Statement is prepared only once. If there is no transaction on, the rows are
+        run inside one transaction that is rolled back if any row fails.
+        \param query SQL statement with $1, $2,... placeholders for the parameter columns.
+        \param params Parameter columns.
+        \param affected If given, receives the number of rows affected by each parameter row.
+        \retval int Total number of rows affected, -1 on error.
+     */
+    virtual int ExecuteBulk(const std::string& query,
+                            const BulkParams& params,
+                            std::vector<int>* affected = 0);
+
+    /*! Executes the INSERT and returns the generated keys from the same round trip by appending
+        RETURNING clause to the statement. Works with multi-row VALUES as well.
+        \param insert INSERT statement without RETURNING.
+        \param keys Key column or comma separated list of key columns.
+        \param ids Receives the key values row by row. With several key columns the values of
+                   one row follow each other.
+        \retval bool True on success.
+     */
+    virtual bool ExecuteInsert(const std::string& insert,
+                               const char* keys,
+                               std::vector<long long>& ids);
+
+    /*! Same as ExecuteBulk for INSERT statement but also returns the generated keys. See
+        ExecuteInsert for the keys and ids.
+        \retval int Number of rows inserted, -1 on error.
+     */
+    virtual int ExecuteBulkInsert(const std::string& insert,
+                                  const BulkParams& params,
+                                  const char* keys,
+                                  std::vector<long long>& ids);
+
     /*! Prints floating point numbers in a safe manner. Comma is swapped to dot to accommodate
         SQL standards if the current locale uses comma as decimal separator.
         \param buffer Pointer to resulting number string.
-        \param format Printf-style format for the number.
+        \param format Printf-style format for the number. Null uses FormatNumber.
         \double number The number that sould be printed.
         \retval int Number of characters printed into buffer.
     */
     virtual int PrintNumber(char* buffer, const char* format, double number);
 
-    /*! Prints floating point numbers in a safe manner. Comma is swapped to dot to accommodate
-        SQL standards if the current locale uses comma as decimal separator.
+    /*! Prints the number with FormatNumber into a thread local buffer.
         \param number Number that should be printed.
-        \retval std::string& Reference to text representation of the number.
+        \retval const char* Text of the number. Valid until the next call from the same thread.
      */
     virtual const char* PrintNumber(double number);
+
+    //! Buffer size for FormatNumber, terminating zero included.
+    static const size_t NUMBER_TEXT = 32;
+    /*! Writes the shortest text that reads back to the same number. Decimal separator is always
+        a dot whatever the locale is. Only the given buffer is used so these can be called from
+        multiple threads at once.
+        \param buffer At least NUMBER_TEXT bytes.
+        \param number Number to print.
+        \retval char* Pointer to the terminating zero.
+     */
+    static char* FormatNumber(char* buffer, double number);
+    static char* FormatNumber(char* buffer, long long number);
+    static char* FormatNumber(char* buffer, long number)
+    {
+        return FormatNumber(buffer, (long long)number);
+    }
+    static char* FormatNumber(char* buffer, int number)
+    {
+        return FormatNumber(buffer, (long long)number);
+    }
     /*! All strings are passed to the database as they are. Problems can occur if user editable
         fields are transferred directly into the database because hyphen ('), backslash (\\)
         newline (\\n) and carriage return (\\r) have special meaning in SQL statements. This
@@ -281,9 +847,95 @@ class Database
      */
     bool IsTransaction() { return (flags & FLAG_TRANSACT_ON) != 0; }
 
+    /*! Attaches a result cache to this database. Cache is not owned by the database and it can
+        be shared between databases. Null detaches the cache.
+     */
+    void SetResultCache(ResultCache* cache_in) { cache = cache_in; }
+    ResultCache* GetResultCache() { return cache; }
+
+    /*! Cached versions of the Execute...Function functions. Without an attached cache these
+        are the same as the uncached functions. Failed queries are not cached.
+        \param ttl_ms Time to live for the result. Zero uses the cache default.
+        \param tags Comma separated tags for the result, e.g. names of the tables in the query.
+     */
+    bool CachedIntFunction(const std::string& query, int& val, unsigned int ttl_ms = 0,
+                           const char* tags = 0);
+    bool CachedLongFunction(const std::string& query, long& val, unsigned int ttl_ms = 0,
+                            const char* tags = 0);
+    bool CachedDoubleFunction(const std::string& query, double& val, unsigned int ttl_ms = 0,
+                              const char* tags = 0);
+    bool CachedBoolFunction(const std::string& query, bool& val, unsigned int ttl_ms = 0,
+                            const char* tags = 0);
+    bool CachedStrFunction(const std::string& query, std::string& result,
+                           unsigned int ttl_ms = 0, const char* tags = 0);
+    bool CachedDateFunction(const std::string& query, tm& val, unsigned int ttl_ms = 0,
+                            const char* tags = 0);
+
+    /*! Runs the row set query through the cache. On a miss the query is run and all rows are
+        read into the cache. In both cases the rows are then returned by the normal GetNext
+        calls. Meant for small results only. Result is not cached if reading it fails or times
+        out.
+        \param rs Row set with bound variables and query text.
+        \retval bool True on success.
+     */
+    bool QueryCached(RowSet* rs, unsigned int ttl_ms = 0, const char* tags = 0);
+
+    //! Removes cached results with the tag. Call this after modifying the tagged table.
+    size_t InvalidateCache(const char* tag) { return cache ? cache->Invalidate(tag) : 0; }
+
+    /*! Sets time limit for the statements run after this call. Statement that runs longer is
+        stopped and the call fails. IsTimeout tells apart these failures from the others.
+        Connection remains usable after the timeout.
+        \param ms Time limit in milliseconds. Zero disables the limit.
+        \retval bool True if the limit was set.
+     */
+    virtual bool SetStatementTimeout(unsigned int ms)
+    {
+        stmt_timeout = ms;
+        return true;
+    }
+    unsigned int GetStatementTimeout() { return stmt_timeout; }
+    /*! Returns true if the last failed call was stopped by the statement timeout or by Cancel.
+        Value is meaningful only right after a failed call.
+     */
+    bool IsTimeout() { return timed_out; }
+    /*! Requests the running statement to stop. This is the only function that can be called
+        from another thread (e.g. from a watchdog) while the statement runs.
+        \retval bool True if the request was sent.
+     */
+    virtual bool Cancel() { return false; }
+
+    /*! Sets how a lost connection is restored. When a call finds the connection broken it makes
+        one reconnect attempt. If the attempt fails the calls fail fast until the backoff wait
+        has passed, i.e. a server failover does not cause a reconnect stampede. Reads that
+        failed due to the lost connection outside transactions are run again after a successful
+        reconnect. Modifications are never repeated automatically.
+     */
+    void SetReconnectPolicy(const ReconnectPolicy& policy) { reconnect_policy = policy; }
+    const ReconnectPolicy& GetReconnectPolicy() { return reconnect_policy; }
+
     // --
     virtual const char* CleanStr(const char* str);
     virtual std::string CleanStr(const std::string& str);
+
+    /*! Returns the exact number of bytes CleanCopy writes for given string (terminating zero
+        is not included).
+        \param str Original string.
+        \param len Length of the original string.
+     */
+    static size_t CleanLength(const char* str, size_t len);
+    /*! Cleans the string the same way as CleanStr into caller's buffer. These functions do not
+        use the object's scratch buffer and can be called from multiple threads at once.
+        \param to Target buffer. Must have room for CleanLength(str, len) + 1 bytes.
+        \param str Original string.
+        \param len Length of the original string.
+        \retval size_t Number of bytes written, excluding the terminating zero.
+     */
+    static size_t CleanCopy(char* to, const char* str, size_t len);
+    //! Appends the cleaned string to the end of 'to'.
+    static void AppendClean(std::string& to, const char* str, size_t len);
+    //! Writes the cleaned string into the query stream.
+    static void AppendClean(std::ostream& to, const char* str, size_t len);
     virtual const char* GetCleanHtml(const std::string& str);
     enum CLEANTYPE
     {
@@ -336,6 +988,10 @@ class Database
     size_t scratch_size;         //!< size for the current buffer.
     char*  last_error;           //!< Buffer for last error description.
     size_t le_size;              //!< Size for last error.   
+    ResultCache* cache;          //!< Optional result cache. Not owned.
+    unsigned int stmt_timeout;   //!< Statement time limit in ms. Zero for no limit.
+    bool timed_out;              //!< True if the last statement was stopped by timeout.
+    ReconnectPolicy reconnect_policy; //!< Automatic reconnect settings.
 };
 
 // -------------------------------------------------------------------------------------------------
@@ -356,11 +1012,32 @@ class RowSet
 */
 {
     friend class Database;
+    friend class MaterializedResult;
+    friend class ArrowExporter;
 
   public:
     virtual ~RowSet();
 
     virtual bool Bind(DT type, void* data);
+    /*! Binds a variable with a NULL indicator. GetNext sets the indicator and leaves the variable
+        untouched when the value is NULL. Indicators can be an array, one for each field.
+     */
+    bool Bind(DT type, void* data, bool* is_null);
+    //! Binds std::optional. GetNext resets it when the value is NULL.
+    bool Bind(std::optional<int>& value) { return bindOptional(DT::INT, value); }
+    bool Bind(std::optional<long>& value) { return bindOptional(DT::LONG, value); }
+    bool Bind(std::optional<double>& value) { return bindOptional(DT::NUM, value); }
+    bool Bind(std::optional<bool>& value) { return bindOptional(DT::BOOL, value); }
+    bool Bind(std::optional<char>& value) { return bindOptional(DT::CHR, value); }
+    bool Bind(std::optional<std::string>& value) { return bindOptional(DT::STR, value); }
+    bool Bind(std::optional<tm>& value) { return bindOptional(DT::TIME, value); }
+    bool Bind(std::optional<Blob>& value) { return bindOptional(DT::BLOB, value); }
+    bool Bind(std::optional<Decimal>& value) { return bindOptional(DT::DEC, value); }
+    bool Bind(std::vector<long>& values) { return Bind(DT::VEC_LONG, &values); }
+    bool Bind(std::vector<double>& values) { return Bind(DT::VEC_NUM, &values); }
+    bool Bind(std::vector<std::string>& values) { return Bind(DT::VEC_STR, &values); }
+    //! Binds the same variable with the same NULL handling as the given field.
+    bool Bind(const BoundField& source);
 
     /*! Sends the query statement to the database and waits for it to execute.
         Caller should have bound all fields from the SELECT-clause. Please note that
@@ -381,14 +1058,19 @@ class RowSet
         have been fetched. If partial result has been retrieved, Reset-function should be called
         to make sure row set is not left into unsyncronized state (problem with MySql especially)
 
-        \retval Number of fields converted. Note that this can be less than was specified in
-        the query since some of the field values could have been NULLs. In this case the bound
-        data is cleared (actual operation depends on the data type). If return value is zero
-        then there is no more rows in the result set (= no fields converted). Bound variables
-        remain unaltered in this case.
+        \retval Number of fields processed. NULL values are included: the bound variable is
+        cleared (actual operation depends on the data type), std::optional is reset and with a
+        NULL indicator only the indicator is set. Value can be less than the number of bound
+        fields only if the query has fewer columns. If return value is zero then there is no
+        more rows in the result set or the read failed, see IsFailed. Bound variables remain
+        unaltered in this case.
         \sa Reset
       */
     virtual int GetNext() = 0;
+    /*! Returns true if the last GetNext returned zero due to an error or timeout instead of the
+        end of the result. The error is in the database's last error.
+     */
+    bool IsFailed() { return failed; }
 
     /*! Releases the query results. If partial result set is read this function should be called to
         make sure the result set is left into proper state (MySql needs this). Query calls this
@@ -396,31 +1078,42 @@ class RowSet
      */
     virtual void Reset() {}
 
+    /*! Runs the query and writes all rows into the JSON writer. Bound variables are not needed
+        nor used: column names and value types come from the database result. Rows are written
+        as they are read so with a streaming writer the output starts before the query ends.
+        Supported by the PostgreSQL and Sqlite row sets and by ShardedRowSet with a shard key.
+        Others fail without an error message.
+        \retval long Number of rows written, -1 on error.
+     */
+    virtual long WriteJson(JsonWriter& out);
+
     /*! Returns number of fields currently bound */
     size_t GetFieldCount() { return field_count; }
     /*! Returns current row count */
     size_t GetRowCount() { return row_count; }
 
-    std::stringstream query; //!< Query statement.
+    QueryBuffer query; //!< Query statement.
 
   protected:
     RowSet();
     bool InsertField(BoundField* newField);
     bool ValidateBind(DT type, void* data);
-    static char* GetQueryBuffer(std::iostream&);
+    template <class T>
+    bool bindOptional(DT type, std::optional<T>& value)
+    {
+        BoundField* field = new BoundField(type, &value);
+        field->optional = OptionalAccess<T>;
+        return InsertField(field);
+    }
+    //! Returns the next row from the cached result. See Database::QueryCached.
+    int GetNextCached();
 
     BoundField* fieldRoot; //!< First field of the bound field list.
     size_t field_count;    //!< Number of fields bound for this row set.
     size_t row_count;
-
-  private:
-    static void InitQueryBuffer();    // Called by Database
-    static void DeleteQueryBuffer() { // Called by Database
-        if (query_buffer)
-            delete[] query_buffer;
-    }
-    static size_t query_max;
-    static char *query_buffer;
+    ResultCache::Data cached; //!< Result from the cache while it is being read.
+    size_t cached_pos;        //!< Read position in the cached result.
+    bool failed;              //!< GetNext stopped on an error. Query clears this.
 };
 
 // -------------------------------------------------------------------------------------------------
@@ -455,6 +1148,367 @@ class RSInterface
     RowSet* rs;
 };
 
+// -------------------------------------------------------------------------------------------------
+//! Database facade over several shards.
+/*! Each shard is a connected Database (PostgreSQL, Sqlite or any mix). Shard is chosen by the
+  caller's shard key (e.g. tenant id) with consistent hashing, so adding a shard moves only
+  about 1/N of the keys. After SetShardKey all Database calls go to the key's shard, i.e. the
+  existing code works unchanged once the key is set.
+
+  Without a key the row set queries are scatter-gather: the query is run on all shards in
+  parallel and the rows are returned in the order they arrive through the normal GetNext calls.
+  Each shard reads only a few chunks of rows ahead of the caller, as PartitionedRowSet does, so
+  the memory use stays bounded. Other
+  calls need the key, i.e. a forgotten SetShardKey is an error and not a write to every shard.
+  ExecuteModifyAll and UpdateStructureAll run the statement on every shard on purpose.
+  Transactions are per shard; there are no transactions across the shards.
+*/
+class ShardedDatabase : public Database
+{
+    friend class ShardedRowSet;
+
+  public:
+    //! \param vnodes Number of points each shard gets on the hash ring.
+    ShardedDatabase(unsigned int vnodes = 64);
+    ~ShardedDatabase();
+
+    /*! Adds a connected database as a shard. ShardedDatabase takes the ownership.
+        \param name Unique and stable name for the shard. Key placement depends on it.
+     */
+    void AddShard(const std::string& name, Database* db);
+    size_t GetShardCount() { return shards.size(); }
+    Database* GetShard(size_t ndx) { return shards[ndx].db; }
+    //! Returns the shard for the key without changing the current shard.
+    Database* Route(const std::string& key);
+    //! Routes the following calls to the key's shard.
+    void SetShardKey(const std::string& key) { active = Route(key); }
+    void SetShardKey(long long key) { SetShardKey(std::to_string(key)); }
+    //! Following row set queries go to all shards.
+    void ClearShardKey() { active = 0; }
+    Database* GetActiveShard() { return active; }
+    //! Runs the statement on every shard. \retval int Sum of the affected rows, -1 on error.
+    int ExecuteModifyAll(const std::string& query);
+    //! Runs the command on every shard, e.g. schema changes.
+    bool UpdateStructureAll(const std::string& command);
+
+    // Database interface
+    RDBM GetType();
+    bool Connect(const char* constr);
+    bool Disconnect();
+    bool IsConnectOK();
+    bool ResetConnection();
+    RowSet* CreateRowSet();
+    bool CreateRowSet(RSInterface*);
+    bool StartTransaction();
+    bool Commit();
+    bool RollBack();
+    bool ExecuteIntFunction(const std::string& query, int& val);
+    bool ExecuteLongFunction(const std::string& query, long& val);
+    bool ExecuteDoubleFunction(const std::string& query, double& val);
+    bool ExecuteBoolFunction(const std::string& query, bool& val);
+    bool ExecuteStrFunction(const std::string& query, std::string& result);
+    bool ExecuteDateFunction(const std::string& query, tm& val);
+    int ExecuteModify(const std::string& query);
+    unsigned long GetInsertId();
+    bool UpdateStructure(const std::string& command);
+    std::string GetErrorDescription(RowSet* rs = 0);
+    bool FindSchemaItem(ST, const char* name);
+    int ExecuteBulk(const std::string& query,
+                    const BulkParams& params,
+                    std::vector<int>* affected = 0);
+    bool ExecuteInsert(const std::string& insert, const char* keys, std::vector<long long>& ids);
+    int ExecuteBulkInsert(const std::string& insert,
+                          const BulkParams& params,
+                          const char* keys,
+                          std::vector<long long>& ids);
+    bool SetStatementTimeout(unsigned int ms);
+    bool Cancel();
+
+  protected:
+    struct Shard
+    {
+        std::string name;
+        Database* db;
+    };
+    Database* current();
+    void copyError(Database* db) { SetLastError(db->GetLastError()); }
+
+    std::vector<Shard> shards;
+    std::vector<std::pair<uint64_t, size_t>> ring; //!< Hash ring points, sorted by hash.
+    unsigned int vnodes;
+    Database* active; //!< Shard of the current key or null.
+};
+
+// -------------------------------------------------------------------------------------------------
+//! Row set of ShardedDatabase. See ShardedDatabase for the scatter-gather queries.
+class ShardedRowSet : public RowSet
+{
+    friend class ShardedDatabase;
+
+  public:
+    ~ShardedRowSet();
+
+    bool Query();
+    int GetNext();
+    void Reset();
+    //! Needs the shard key. Rows of several shards are not merged into one JSON result.
+    long WriteJson(JsonWriter& out);
+
+  protected:
+    ShardedRowSet(ShardedDatabase* sdb_in);
+
+    //! Query of one shard with its own storage for the bound values.
+    struct Part
+    {
+        Database* db;
+        RowSet* rs;
+        std::vector<ValueSlot> values;
+        std::deque<std::string> chunks; //!< Rows packed with PackValue, waiting for the reader.
+        bool started; //!< Query has returned.
+        bool queried; //!< Query succeeded.
+        bool done;
+        bool ok;
+    };
+    bool gather();
+    void run(Part* part);
+    bool nextChunk();
+
+    ShardedDatabase* sdb;
+    RowSet* direct;          //!< Row set on the single shard when the key is set.
+    std::vector<Part> parts; //!< Scatter-gather queries.
+    std::vector<std::thread> workers;
+    std::mutex part_mutex;
+    std::condition_variable data_cv;  //!< Signals new chunk or a started or finished shard.
+    std::condition_variable space_cv; //!< Signals that the reader has taken a chunk.
+    std::string chunk;                //!< Chunk being read.
+    size_t chunk_pos;
+    size_t part_ndx; //!< Part checked first for the next chunk.
+    bool stop;
+};
+
+// -------------------------------------------------------------------------------------------------
+//! Runs a key range query in parallel partitions.
+/*! The key range [low, high) is split into one partition per connection and the partitions are
+  queried at the same time, each by its own thread on its own connection. Query text refers to
+  the partition's range with {low} and {high}, e.g.
+
+      SELECT id, name FROM item WHERE id >= {low} AND id < {high} ORDER BY id
+
+  Rows are read into the bound variables with GetNext or into bound vectors with GetBatch. By
+  default rows are returned in the order they arrive from the partitions. SetOrdered(true)
+  returns the partitions in the range order which is the key order when the query is ordered by
+  the key. Each partition reads only a few chunks ahead of the caller so the memory use stays
+  bounded in both modes.
+
+  Connections are not owned. A connection is used by one thread only, except SqlitePool which can
+  be added as many times as it has readers. Query errors are reported when the rows are read:
+  GetNext and GetBatch return zero and IsFailed returns true.
+*/
+class PartitionedRowSet : public RowSet
+{
+  public:
+    PartitionedRowSet();
+    ~PartitionedRowSet();
+
+    void AddConnection(Database* db) { connections.push_back(db); }
+    size_t GetPartitionCount() { return connections.size(); }
+    //! Sets the key range [low, high) to split.
+    void SetRange(long long low_in, long long high_in)
+    {
+        low = low_in;
+        high = high_in;
+    }
+    //! Returns the rows in the key range order instead of the arrival order.
+    void SetOrdered(bool ordered_in) { ordered = ordered_in; }
+    //! Sets the number of rows passed from a partition to the reader at a time.
+    void SetChunkRows(size_t rows) { chunk_rows = rows ? rows : 1; }
+
+    /*! Binds a std::vector for GetBatch. Vector element type follows RowSet::Bind, e.g.
+        DT::INT is std::vector<int> and DT::BOOL is std::vector<bool>. DT::BLOB and the VEC_
+        types cannot be read in batches. Use either Bind or BindBatch with one query.
+     */
+    bool BindBatch(DT type, void* values);
+    bool BindBatch(std::vector<int>& values) { return BindBatch(DT::INT, &values); }
+    bool BindBatch(std::vector<long>& values) { return BindBatch(DT::LONG, &values); }
+    bool BindBatch(std::vector<double>& values) { return BindBatch(DT::NUM, &values); }
+    bool BindBatch(std::vector<std::string>& values) { return BindBatch(DT::STR, &values); }
+    bool BindBatch(std::vector<tm>& values) { return BindBatch(DT::TIME, &values); }
+    bool BindBatch(std::vector<Decimal>& values) { return BindBatch(DT::DEC, &values); }
+    //! Replaces the contents of the bound vectors with at most max_rows rows. Returns the rows.
+    size_t GetBatch(size_t max_rows);
+
+    bool Query();
+    int GetNext();
+    void Reset();
+
+    const char* GetLastError() { return last_error.c_str(); }
+
+  protected:
+    struct Part
+    {
+        Database* db;
+        RowSet* rs;
+        std::vector<ValueSlot> values;
+        std::deque<std::string> chunks; //!< Rows packed with PackValue, waiting for the reader.
+        bool done;
+        bool ok;
+        std::string error;
+    };
+    void run(Part* part);
+    bool nextChunk();
+    bool takeChunk(Part& part);
+    bool fail(Part& part);
+
+    std::vector<Database*> connections;
+    std::vector<std::pair<DT, void*>> batch; //!< Vectors bound with BindBatch.
+    std::vector<DT> types;                   //!< Types of the packed values.
+    std::vector<Part> parts;
+    std::vector<std::thread> workers;
+    std::mutex part_mutex;
+    std::condition_variable data_cv;  //!< Signals new chunk or a finished partition.
+    std::condition_variable space_cv; //!< Signals that the reader has taken a chunk.
+    std::string chunk;                //!< Chunk being read.
+    size_t chunk_pos;
+    size_t part_ndx; //!< Partition read next.
+    size_t chunk_rows;
+    long long low, high;
+    bool ordered;
+    bool stop;
+    std::string last_error;
+};
+
+// -------------------------------------------------------------------------------------------------
+//! Query result held in memory in a compact columnar form.
+/*! Load runs the row set's query and copies all rows. Columns and their types are the row set's
+  bound fields, i.e. bind as for GetNext and then call Load instead of the GetNext loop. Fixed
+  width values are stored contiguously per column and all strings and BLOBs of the result share
+  one byte arena, so a result takes a few allocations whatever the row count is.
+
+  Rows are accessed by row and column number. Getter must match the column type, e.g. GetStr for
+  DT::STR; getters do not check it. Returned string views and Blobs point into the arena and are
+  valid until the next Load or Clear. Moving the result is cheap and keeps them valid. VEC_
+  types are not supported.
+*/
+class MaterializedResult
+{
+  public:
+    MaterializedResult()
+      : rows(0)
+    {}
+    MaterializedResult(MaterializedResult&&) = default;
+    MaterializedResult& operator=(MaterializedResult&&) = default;
+    MaterializedResult(const MaterializedResult&) = delete;
+    MaterializedResult& operator=(const MaterializedResult&) = delete;
+
+    /*! Runs the query and reads all rows. Previous content is cleared. Row set is reset at the end.
+        \retval bool False if there are no bound fields, a field type is not supported or the
+        query fails. Also reading the rows can fail or time out; the result is then cleared.
+        Query errors are in the database's last error.
+     */
+    bool Load(RowSet* rs);
+    //! Removes rows and columns. Reserved memory is kept for the next Load.
+    void Clear();
+    /*! Orders the rows by the column. Sort is stable so sorting by several columns is done from
+        the last key to the first. NULLs are first in ascending order.
+     */
+    void Sort(size_t col, bool ascending = true);
+
+    size_t GetRows() const { return rows; }
+    size_t GetColumns() const { return columns.size(); }
+    DT GetType(size_t col) const { return columns[col].type; }
+
+    bool IsNull(size_t row, size_t col) const { return columns[col].nulls[order[row]]; }
+    int GetInt(size_t row, size_t col) const { return value<int>(row, col); }
+    long GetLong(size_t row, size_t col) const { return value<long>(row, col); }
+    double GetNum(size_t row, size_t col) const { return value<double>(row, col); }
+    bool GetBool(size_t row, size_t col) const { return value<bool>(row, col); }
+    char GetChr(size_t row, size_t col) const { return value<char>(row, col); }
+    const tm& GetTime(size_t row, size_t col) const { return value<tm>(row, col); }
+    const Decimal& GetDec(size_t row, size_t col) const { return value<Decimal>(row, col); }
+    std::string_view GetStr(size_t row, size_t col) const
+    {
+        const Span& span = value<Span>(row, col);
+        return std::string_view(arena.data() + span.offset, span.size);
+    }
+    Blob GetBlob(size_t row, size_t col) const
+    {
+        const Span& span = value<Span>(row, col);
+        return Blob(arena.data() + span.offset, span.size);
+    }
+
+  protected:
+    //! Location of a string or BLOB in the arena.
+    struct Span
+    {
+        size_t offset;
+        size_t size;
+    };
+    struct Column
+    {
+        DT type;
+        size_t width;            //!< Bytes per value in data.
+        std::vector<char> data;  //!< Values in load order.
+        std::vector<bool> nulls; //!< NULL flags in load order.
+    };
+    template <class T>
+    const T& value(size_t row, size_t col) const
+    {
+        const Column& column = columns[col];
+        return *reinterpret_cast<const T*>(column.data.data() + order[row] * column.width);
+    }
+    void append(Column& column, const void* value, bool is_null);
+
+    std::vector<Column> columns;
+    std::vector<size_t> order; //!< Load order row numbers in the current sort order.
+    std::vector<char> arena;   //!< Bytes of the strings and BLOBs.
+    size_t rows;
+};
+
+// -------------------------------------------------------------------------------------------------
+//! Writes query results as Apache Arrow IPC record batches.
+/*! Columns are the row set's bound fields as with MaterializedResult. Types are mapped to
+  DT::INT int32, LONG int64, NUM float64, BOOL bool, STR utf8, TIME timestamp[s] and DAY date32.
+  Times are taken as UTC. Other types are not supported.
+
+  NULLs go to the validity bitmaps for fields bound with a NULL indicator or std::optional.
+  Fields bound without either are never NULL. Columns are named with SetColumnNames, the
+  default names are f0, f1, ...
+
+  Format is written directly so the Arrow library is not needed. IPC_FILE is the random access
+  file format (.arrow, Feather V2) and IPC_STREAM the streaming format. Written data is little
+  endian as is the host.
+*/
+class ArrowExporter
+{
+  public:
+    enum FORMAT
+    {
+        IPC_FILE,
+        IPC_STREAM
+    };
+
+    ArrowExporter(size_t batch_rows_in = 0x10000)
+      : batch_rows(batch_rows_in ? batch_rows_in : 1)
+    {}
+    //! Sets the maximum number of rows in a record batch.
+    void SetBatchRows(size_t rows) { batch_rows = rows ? rows : 1; }
+    void SetColumnNames(const std::vector<std::string>& names_in) { names = names_in; }
+
+    /*! Runs the row set's query and writes all rows. Row set is reset at the end. If reading
+        the rows fails or times out the output is left incomplete, i.e. without the end of
+        stream marker and footer, and the file version removes the file.
+        \retval long Number of rows written, -1 on error. See GetLastError.
+     */
+    long Export(RowSet* rs, std::ostream& out, FORMAT format = IPC_FILE);
+    long Export(RowSet* rs, const char* path, FORMAT format = IPC_FILE);
+    const char* GetLastError() { return last_error.c_str(); }
+
+  protected:
+    size_t batch_rows;
+    std::vector<std::string> names;
+    std::string last_error;
+};
+
 // =============================================================================
 //  INLINE FUNCTIONS
 
@@ -0,0 +1,303 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <string.h>
+#include <cmath>
+#include <charconv>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "directdb.hpp"
+
+using namespace std;
+
+namespace ddb {
+
+// -------------------------------------------------------------------------------------------------
+// Finds the next character that must be escaped in a JSON string: quote, backslash or a control
+// character. The scan uses SSE2 to skip 16 bytes at a time when it is available.
+static const char*
+findEscape(const char* str, const char* end)
+{
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    while (end - str >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+        // Unsigned chunk <= 0x1f.
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask)
+            return str + __builtin_ctz(mask);
+        str += 16;
+    }
+#endif
+    while (str < end && *str != '"' && *str != '\\' && (unsigned char)*str >= 0x20)
+        str++;
+    return str;
+}
+
+// -------------------------------------------------------------------------------------------------
+JsonWriter::JsonWriter(LAYOUT layout_in)
+  : layout(layout_in)
+  , chunk(0)
+  , length(0)
+  , capacity(0x1000)
+  , column(0)
+  , rows(0)
+{
+    buffer = new char[capacity];
+    buffer[0] = 0;
+}
+JsonWriter::JsonWriter(const Sink& sink_in, size_t chunk_in, LAYOUT layout_in)
+  : layout(layout_in)
+  , sink(sink_in)
+  , chunk(chunk_in)
+  , length(0)
+  , column(0)
+  , rows(0)
+{
+    // Room for a chunk and the row that goes over it.
+    capacity = chunk + 0x1000;
+    buffer = new char[capacity];
+    buffer[0] = 0;
+}
+JsonWriter::~JsonWriter()
+{
+    delete[] buffer;
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+JsonWriter::grow(size_t size)
+/*!
+  Allocation failure throws std::bad_alloc like in QueryBuffer.
+*/
+{
+    size_t newcap = capacity;
+    while (length + size >= newcap)
+        newcap *= 2;
+    char* newbuf = new char[newcap];
+    memcpy(newbuf, buffer, length);
+    delete[] buffer;
+    buffer = newbuf;
+    capacity = newcap;
+}
+void
+JsonWriter::Clear()
+{
+    length = 0;
+    buffer[0] = 0;
+}
+bool
+JsonWriter::flush()
+{
+    if (!sink || !length)
+        return true;
+    bool rv = sink(buffer, length);
+    Clear();
+    return rv;
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+JsonWriter::BeginResult()
+/*!
+  Starts the array. Column names are cleared, i.e. the row set adds them after this.
+*/
+{
+    keys.clear();
+    rows = 0;
+    reserve(1);
+    buffer[length++] = '[';
+    buffer[length] = 0;
+}
+void
+JsonWriter::AddColumn(const char* name, size_t len)
+{
+    // Key is escaped once with the same code as the values.
+    size_t start = length;
+    quote(name, len);
+    string key(buffer + start, length - start);
+    key += ':';
+    keys.push_back(move(key));
+    length = start;
+    buffer[length] = 0;
+}
+void
+JsonWriter::AddColumn(const char* name)
+{
+    AddColumn(name, strlen(name));
+}
+void
+JsonWriter::BeginRow()
+{
+    reserve(2);
+    if (rows++)
+        buffer[length++] = ',';
+    buffer[length++] = layout == OBJECTS ? '{' : '[';
+    buffer[length] = 0;
+    column = 0;
+}
+bool
+JsonWriter::EndRow()
+{
+    reserve(1);
+    buffer[length++] = layout == OBJECTS ? '}' : ']';
+    buffer[length] = 0;
+    if (sink && length >= chunk)
+        return flush();
+    return true;
+}
+bool
+JsonWriter::EndResult()
+{
+    reserve(1);
+    buffer[length++] = ']';
+    buffer[length] = 0;
+    return flush();
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+JsonWriter::value()
+/*!
+  Writes the separator and, for objects, the key of the next column. Columns beyond the named
+  ones get empty keys, which only happens if the row set and the result disagree.
+*/
+{
+    if (column) {
+        reserve(1);
+        buffer[length++] = ',';
+    }
+    if (layout == OBJECTS) {
+        if (column < keys.size()) {
+            const string& key = keys[column];
+            reserve(key.size());
+            memcpy(buffer + length, key.data(), key.size());
+            length += key.size();
+        } else {
+            reserve(3);
+            memcpy(buffer + length, "\"\":", 3);
+            length += 3;
+        }
+    }
+    column++;
+}
+void
+JsonWriter::Null()
+{
+    Raw("null", 4);
+}
+void
+JsonWriter::Bool(bool value)
+{
+    if (value)
+        Raw("true", 4);
+    else
+        Raw("false", 5);
+}
+void
+JsonWriter::Number(long long number)
+{
+    value();
+    reserve(Database::NUMBER_TEXT);
+    length = Database::FormatNumber(buffer + length, number) - buffer;
+}
+void
+JsonWriter::Number(double number)
+{
+    if (!isfinite(number)) {
+        Null();
+        return;
+    }
+    value();
+    reserve(Database::NUMBER_TEXT);
+    length = Database::FormatNumber(buffer + length, number) - buffer;
+}
+void
+JsonWriter::Raw(const char* text, size_t len)
+{
+    value();
+    reserve(len);
+    memcpy(buffer + length, text, len);
+    length += len;
+    buffer[length] = 0;
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+JsonWriter::String(const char* text, size_t len)
+{
+    value();
+    quote(text, len);
+}
+void
+JsonWriter::quote(const char* text, size_t len)
+/*!
+  Text is expected to be UTF-8. Only the characters that JSON requires are escaped.
+*/
+{
+    static const char hex[] = "0123456789abcdef";
+    const char* end = text + len;
+    reserve(len + 2);
+    buffer[length++] = '"';
+    while (text < end) {
+        const char* hit = findEscape(text, end);
+        memcpy(buffer + length, text, hit - text);
+        length += hit - text;
+        if (hit == end)
+            break;
+        reserve(end - hit + 6);
+        buffer[length++] = '\\';
+        switch (*hit) {
+        case '"':
+        case '\\':
+            buffer[length++] = *hit;
+            break;
+        case '\n':
+            buffer[length++] = 'n';
+            break;
+        case '\r':
+            buffer[length++] = 'r';
+            break;
+        case '\t':
+            buffer[length++] = 't';
+            break;
+        default:
+            memcpy(buffer + length, "u00", 3);
+            length += 3;
+            buffer[length++] = hex[(unsigned char)*hit >> 4];
+            buffer[length++] = hex[*hit & 0xf];
+        }
+        text = hit + 1;
+    }
+    buffer[length++] = '"';
+    buffer[length] = 0;
+}
+void
+JsonWriter::Binary(const void* data, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    value();
+    reserve(2 * len + 5);
+    memcpy(buffer + length, "\"\\\\x", 4);
+    length += 4;
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t ndx = 0; ndx < len; ndx++) {
+        buffer[length++] = hex[bytes[ndx] >> 4];
+        buffer[length++] = hex[bytes[ndx] & 0xf];
+    }
+    buffer[length++] = '"';
+    buffer[length] = 0;
+}
+
+}; // namespace ddb
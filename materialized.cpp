@@ -0,0 +1,224 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <string.h>
+#include <algorithm>
+#include <numeric>
+
+#include "directdb.hpp"
+
+using namespace std;
+
+namespace ddb {
+
+// -------------------------------------------------------------------------------------------------
+static size_t
+valueWidth(DT type)
+{
+    switch (type) {
+    case DT::INT:
+        return sizeof(int);
+    case DT::LONG:
+        return sizeof(long);
+    case DT::NUM:
+        return sizeof(double);
+    case DT::BOOL:
+        return sizeof(bool);
+    case DT::BIT:
+    case DT::CHR:
+        return sizeof(char);
+    case DT::TIME:
+    case DT::DAY:
+        return sizeof(tm);
+    case DT::DEC:
+        return sizeof(Decimal);
+    case DT::STR:
+    case DT::BLOB:
+        return 2 * sizeof(size_t);
+    case DT::VEC_LONG:
+    case DT::VEC_NUM:
+    case DT::VEC_STR:
+        break;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+MaterializedResult::Load(RowSet* rs)
+{
+    Clear();
+    for (BoundField* field = rs->fieldRoot; field; field = field->next) {
+        size_t width = valueWidth(field->type);
+        if (!width) {
+            columns.clear();
+            return false;
+        }
+        columns.push_back(Column{ field->type, width, {}, {} });
+    }
+    if (columns.empty() || !rs->Query())
+        return false;
+    while (rs->GetNext() > 0) {
+        size_t col = 0;
+        for (BoundField* field = rs->fieldRoot; field; field = field->next, col++) {
+            bool is_null;
+            const void* value = field->Source(is_null);
+            append(columns[col], value, is_null);
+        }
+        rows++;
+    }
+    bool failed = rs->IsFailed();
+    rs->Reset();
+    if (failed) {
+        Clear();
+        return false;
+    }
+    order.resize(rows);
+    iota(order.begin(), order.end(), 0);
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+MaterializedResult::append(Column& column, const void* value, bool is_null)
+/*!
+  NULL takes the same space as a value so that the values can be found by the row number.
+*/
+{
+    size_t pos = column.data.size();
+    column.data.resize(pos + column.width);
+    column.nulls.push_back(is_null);
+    char* target = column.data.data() + pos;
+    if (is_null || !value) {
+        memset(target, 0, column.width);
+        return;
+    }
+    Span span;
+    switch (column.type) {
+    case DT::STR: {
+        const string* str = (const string*)value;
+        span.offset = arena.size();
+        span.size = str->size();
+        arena.insert(arena.end(), str->begin(), str->end());
+        memcpy(target, &span, sizeof(span));
+        break;
+    }
+    case DT::BLOB: {
+        const Blob* blob = (const Blob*)value;
+        span.offset = arena.size();
+        span.size = blob->size;
+        arena.insert(arena.end(), blob->begin(), blob->end());
+        memcpy(target, &span, sizeof(span));
+        break;
+    }
+    default:
+        memcpy(target, value, column.width);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+MaterializedResult::Clear()
+{
+    columns.clear();
+    order.clear();
+    arena.clear();
+    rows = 0;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Decimals with different scales are compared at the common scale when it fits.
+static int
+compareDecimal(const Decimal& a, const Decimal& b)
+{
+    Decimal left(a), right(b);
+    if (left.scale != right.scale) {
+        int scale = left.scale > right.scale ? left.scale : right.scale;
+        if (!left.Rescale(scale) || !right.Rescale(scale)) {
+            double da = a.ToDouble(), db = b.ToDouble();
+            return da < db ? -1 : da > db ? 1 : 0;
+        }
+    }
+    return left.units < right.units ? -1 : left.units > right.units ? 1 : 0;
+}
+
+static int
+compareTime(const tm& a, const tm& b)
+{
+    const int left[] = { a.tm_year, a.tm_mon, a.tm_mday, a.tm_hour, a.tm_min, a.tm_sec };
+    const int right[] = { b.tm_year, b.tm_mon, b.tm_mday, b.tm_hour, b.tm_min, b.tm_sec };
+    for (size_t ndx = 0; ndx < sizeof(left) / sizeof(int); ndx++) {
+        if (left[ndx] != right[ndx])
+            return left[ndx] < right[ndx] ? -1 : 1;
+    }
+    return 0;
+}
+
+template <class T>
+static int
+compareValue(const char* a, const char* b)
+{
+    const T& left = *reinterpret_cast<const T*>(a);
+    const T& right = *reinterpret_cast<const T*>(b);
+    return left < right ? -1 : right < left ? 1 : 0;
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+MaterializedResult::Sort(size_t col, bool ascending)
+/*!
+  Only the row order is sorted, the values stay where they are.
+*/
+{
+    if (col >= columns.size())
+        return;
+    const Column& column = columns[col];
+    const char* data = column.data.data();
+    const char* text = arena.data();
+    size_t width = column.width;
+    auto compare = [&](size_t a, size_t b) {
+        bool null_a = column.nulls[a], null_b = column.nulls[b];
+        if (null_a || null_b)
+            return null_a != null_b ? null_a : false;
+        const char* left = data + a * width;
+        const char* right = data + b * width;
+        switch (column.type) {
+        case DT::INT:
+            return compareValue<int>(left, right) < 0;
+        case DT::LONG:
+            return compareValue<long>(left, right) < 0;
+        case DT::NUM:
+            return compareValue<double>(left, right) < 0;
+        case DT::BOOL:
+            return compareValue<bool>(left, right) < 0;
+        case DT::BIT:
+        case DT::CHR:
+            return compareValue<char>(left, right) < 0;
+        case DT::TIME:
+        case DT::DAY:
+            return compareTime(*(const tm*)left, *(const tm*)right) < 0;
+        case DT::DEC:
+            return compareDecimal(*(const Decimal*)left, *(const Decimal*)right) < 0;
+        case DT::STR:
+        case DT::BLOB: {
+            const Span* span_a = (const Span*)left;
+            const Span* span_b = (const Span*)right;
+            return string_view(text + span_a->offset, span_a->size)
+                   < string_view(text + span_b->offset, span_b->size);
+        }
+        default:
+            return false;
+        }
+    };
+    if (ascending)
+        stable_sort(order.begin(), order.end(), compare);
+    else
+        stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return compare(b, a); });
+}
+
+}; // namespace ddb
@@ -0,0 +1,385 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <string.h>
+#include <time.h>
+
+#include "directdb.hpp"
+
+using namespace std;
+
+namespace ddb {
+
+// Chunks a partition may have waiting for the reader before its thread blocks.
+const size_t MAX_CHUNKS = 4;
+
+// -------------------------------------------------------------------------------------------------
+static void
+replaceAll(string& text, const char* from, const string& to)
+{
+    size_t len = strlen(from);
+    for (size_t pos = text.find(from); pos != string::npos; pos = text.find(from, pos + to.size()))
+        text.replace(pos, len, to);
+}
+
+// -------------------------------------------------------------------------------------------------
+PartitionedRowSet::PartitionedRowSet()
+{
+    chunk_pos = 0;
+    part_ndx = 0;
+    chunk_rows = 256;
+    low = 0;
+    high = 0;
+    ordered = false;
+    stop = false;
+    failed = false;
+}
+PartitionedRowSet::~PartitionedRowSet()
+{
+    Reset();
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+PartitionedRowSet::BindBatch(DT type, void* values)
+{
+    if (!ValidateBind(type, values) || (type >= DT::BLOB && type != DT::DEC))
+        return false;
+    batch.push_back(make_pair(type, values));
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+PartitionedRowSet::Reset()
+/*!
+  Stops the partition threads. A thread stops when it has read its next chunk of rows.
+*/
+{
+    {
+        lock_guard<mutex> lock(part_mutex);
+        stop = true;
+    }
+    space_cv.notify_all();
+    for (thread& worker : workers)
+        worker.join();
+    workers.clear();
+    for (Part& part : parts)
+        delete part.rs;
+    parts.clear();
+    chunk.clear();
+    chunk_pos = 0;
+    part_ndx = 0;
+    stop = false;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+PartitionedRowSet::Query()
+/*!
+  Splits the range and starts one thread per partition. Returns as soon as the threads have
+  been started.
+  \retval bool False if the query could not be started. See GetLastError.
+*/
+{
+    Reset();
+    row_count = 0;
+    failed = false;
+    last_error.clear();
+    if (connections.empty()) {
+        last_error = "PartitionedRowSet: no connections.";
+        return false;
+    }
+    if (high <= low) {
+        last_error = "PartitionedRowSet: empty key range.";
+        return false;
+    }
+    if ((fieldRoot != 0) == !batch.empty()) {
+        last_error = "PartitionedRowSet: use either Bind or BindBatch.";
+        return false;
+    }
+    types.clear();
+    for (BoundField* field = fieldRoot; field; field = field->next)
+        types.push_back(field->type);
+    for (auto& column : batch)
+        types.push_back(column.first);
+
+    // Unsigned math so that the full long long range does not overflow.
+    unsigned long long span = (unsigned long long)high - (unsigned long long)low;
+    unsigned long long count = connections.size();
+    if (span < count)
+        count = span;
+    unsigned long long step = span / count + (span % count ? 1 : 0);
+
+    parts.resize(count);
+    string text(query.GetText(), query.GetLength());
+    for (size_t ndx = 0; ndx < parts.size(); ndx++) {
+        Part& part = parts[ndx];
+        part.db = connections[ndx];
+        part.done = false;
+        part.ok = false;
+        part.rs = part.db->CreateRowSet();
+        if (!part.rs) {
+            last_error = part.db->GetErrorDescription(0);
+            Reset();
+            return false;
+        }
+        part.values.resize(types.size());
+        for (size_t fn = 0; fn < types.size(); fn++)
+            part.rs->Bind(types[fn], part.values[fn].Address(types[fn]), &part.values[fn].null);
+
+        long long plow = (long long)((unsigned long long)low + step * ndx);
+        long long phigh = ndx + 1 == parts.size()
+                              ? high
+                              : (long long)((unsigned long long)low + step * (ndx + 1));
+        string ptext(text);
+        replaceAll(ptext, "{low}", to_string(plow));
+        replaceAll(ptext, "{high}", to_string(phigh));
+        part.rs->query << ptext;
+    }
+    for (Part& part : parts)
+        workers.emplace_back(&PartitionedRowSet::run, this, &part);
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+PartitionedRowSet::run(Part* part)
+/*!
+  Partition thread. Packs the rows into chunks and hands them over to the reader.
+*/
+{
+    bool ok = part->rs->Query();
+    string rows;
+    size_t rows_in = 0;
+    for (int count; ok && (count = part->rs->GetNext()) > 0;) {
+        rows.append((const char*)&count, sizeof(count));
+        for (size_t fn = 0; fn < types.size(); fn++) {
+            ValueSlot& slot = part->values[fn];
+            PackField(rows, types[fn], slot.Address(types[fn]), slot.null);
+        }
+        if (++rows_in < chunk_rows)
+            continue;
+        unique_lock<mutex> lock(part_mutex);
+        space_cv.wait(lock, [this, part] { return stop || part->chunks.size() < MAX_CHUNKS; });
+        if (stop)
+            return;
+        part->chunks.push_back(move(rows));
+        lock.unlock();
+        data_cv.notify_one();
+        rows.clear();
+        rows_in = 0;
+    }
+    if (ok && part->rs->IsFailed())
+        ok = false;
+    string error;
+    if (!ok)
+        error = part->db->GetErrorDescription(part->rs);
+    {
+        lock_guard<mutex> lock(part_mutex);
+        if (!rows.empty())
+            part->chunks.push_back(move(rows));
+        part->error = error;
+        part->ok = ok;
+        part->done = true;
+    }
+    data_cv.notify_one();
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+PartitionedRowSet::takeChunk(Part& part)
+{
+    if (part.chunks.empty())
+        return false;
+    chunk = move(part.chunks.front());
+    part.chunks.pop_front();
+    chunk_pos = 0;
+    space_cv.notify_all();
+    return true;
+}
+
+bool
+PartitionedRowSet::fail(Part& part)
+{
+    failed = true;
+    last_error = part.error;
+    return false;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+PartitionedRowSet::nextChunk()
+/*!
+  Waits for the next chunk. In the arrival order the partitions are visited round robin so that
+  a fast partition does not starve the others.
+  \retval bool False at the end of the rows or on error.
+*/
+{
+    unique_lock<mutex> lock(part_mutex);
+    for (;;) {
+        if (ordered) {
+            for (; part_ndx < parts.size(); part_ndx++) {
+                Part& part = parts[part_ndx];
+                if (takeChunk(part))
+                    return true;
+                if (!part.done)
+                    break;
+                if (!part.ok)
+                    return fail(part);
+            }
+            if (part_ndx == parts.size())
+                return false;
+        } else {
+            bool pending = false;
+            for (size_t nth = 0; nth < parts.size(); nth++) {
+                size_t ndx = (part_ndx + nth) % parts.size();
+                Part& part = parts[ndx];
+                if (takeChunk(part)) {
+                    part_ndx = ndx + 1;
+                    return true;
+                }
+                if (!part.done)
+                    pending = true;
+                else if (!part.ok)
+                    return fail(part);
+            }
+            if (!pending)
+                return false;
+        }
+        data_cv.wait(lock);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+int
+PartitionedRowSet::GetNext()
+{
+    if (!fieldRoot || failed)
+        return 0;
+    if (chunk_pos >= chunk.size() && !nextChunk()) {
+        Reset();
+        return 0;
+    }
+    const char* data = chunk.data() + chunk_pos;
+    int count;
+    memcpy(&count, data, sizeof(count));
+    data += sizeof(count);
+    for (BoundField* field = fieldRoot; field; field = field->next)
+        data = UnpackField(data, field);
+    chunk_pos = data - chunk.data();
+    row_count++;
+    return count;
+}
+
+// -------------------------------------------------------------------------------------------------
+template <class T>
+static void
+appendSlot(void* values, T& value)
+{
+    ((vector<T>*)values)->push_back(value);
+}
+
+size_t
+PartitionedRowSet::GetBatch(size_t max_rows)
+{
+    for (auto& column : batch) {
+        switch (column.first) {
+        case DT::INT:
+            ((vector<int>*)column.second)->clear();
+            break;
+        case DT::LONG:
+            ((vector<long>*)column.second)->clear();
+            break;
+        case DT::NUM:
+            ((vector<double>*)column.second)->clear();
+            break;
+        case DT::BOOL:
+            ((vector<bool>*)column.second)->clear();
+            break;
+        case DT::BIT:
+        case DT::CHR:
+            ((vector<char>*)column.second)->clear();
+            break;
+        case DT::TIME:
+        case DT::DAY:
+            ((vector<tm>*)column.second)->clear();
+            break;
+        case DT::STR:
+            ((vector<string>*)column.second)->clear();
+            break;
+        case DT::DEC:
+            ((vector<Decimal>*)column.second)->clear();
+            break;
+        case DT::BLOB: // Rejected by BindBatch.
+        case DT::VEC_LONG:
+        case DT::VEC_NUM:
+        case DT::VEC_STR:
+            break;
+        }
+    }
+    if (batch.empty() || failed)
+        return 0;
+    // NULL values are added as zero, empty string or zeroed tm.
+    vector<ValueSlot> slots(batch.size());
+    vector<BoundField> fields;
+    for (size_t fn = 0; fn < batch.size(); fn++)
+        fields.emplace_back(batch[fn].first, slots[fn].Address(batch[fn].first));
+    size_t rows = 0;
+    while (rows < max_rows) {
+        if (chunk_pos >= chunk.size() && !nextChunk()) {
+            Reset();
+            break;
+        }
+        const char* data = chunk.data() + chunk_pos + sizeof(int);
+        for (size_t fn = 0; fn < batch.size(); fn++) {
+            auto& column = batch[fn];
+            ValueSlot& slot = slots[fn];
+            data = UnpackField(data, &fields[fn]);
+            switch (column.first) {
+            case DT::INT:
+                appendSlot(column.second, slot.i);
+                break;
+            case DT::LONG:
+                appendSlot(column.second, slot.l);
+                break;
+            case DT::NUM:
+                appendSlot(column.second, slot.d);
+                break;
+            case DT::BOOL:
+                appendSlot(column.second, slot.b);
+                break;
+            case DT::BIT:
+            case DT::CHR:
+                appendSlot(column.second, slot.c);
+                break;
+            case DT::TIME:
+            case DT::DAY:
+                appendSlot(column.second, slot.t);
+                break;
+            case DT::STR:
+                ((vector<string>*)column.second)->push_back(move(slot.s));
+                break;
+            case DT::DEC:
+                appendSlot(column.second, slot.m);
+                break;
+            case DT::BLOB:
+            case DT::VEC_LONG:
+            case DT::VEC_NUM:
+            case DT::VEC_STR:
+                break;
+            }
+        }
+        chunk_pos = data - chunk.data();
+        row_count++;
+        rows++;
+    }
+    return rows;
+}
+
+}; // namespace ddb
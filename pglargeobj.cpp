@@ -0,0 +1,261 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <limits.h>
+#include <libpq/libpq-fs.h>
+
+#define __DDB_POSTGRE__
+#include "directdb.hpp"
+
+using namespace std;
+
+namespace ddb {
+
+// -------------------------------------------------------------------------------------------------
+Oid
+Postgre::CreateLargeObject()
+/*!
+  \retval Oid Id of the new empty object, InvalidOid on error.
+*/
+{
+    if (!checkConnection())
+        return InvalidOid;
+    Oid oid = lo_create(connection, InvalidOid);
+    if (oid == InvalidOid) {
+        SetLastError("CreateLargeObject failed: ");
+        AppendLastError(PQerrorMessage(connection));
+    }
+    return oid;
+}
+
+// -------------------------------------------------------------------------------------------------
+PostgreLargeObject*
+Postgre::OpenLargeObject(Oid oid, bool write)
+/*!
+  Must be called inside a transaction.
+  \retval PostgreLargeObject* New handle that the caller deletes, or null on error.
+*/
+{
+    if (!(flags & FLAG_TRANSACT_ON)) {
+        SetLastError("OpenLargeObject: large objects need a transaction.");
+        return 0;
+    }
+    int fd = lo_open(connection, oid, write ? INV_READ | INV_WRITE : INV_READ);
+    if (fd < 0) {
+        SetLastError("OpenLargeObject failed: ");
+        AppendLastError(PQerrorMessage(connection));
+        return 0;
+    }
+    return new PostgreLargeObject(this, fd);
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+Postgre::UnlinkLargeObject(Oid oid)
+{
+    if (!checkConnection())
+        return false;
+    if (lo_unlink(connection, oid) < 0) {
+        SetLastError("UnlinkLargeObject failed: ");
+        AppendLastError(PQerrorMessage(connection));
+        return false;
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+Oid
+Postgre::ImportLargeObject(int fd, size_t buffer_size)
+/*!
+  Streams everything from the file descriptor into a new large object. Runs in its own
+  transaction unless one is already open.
+  \retval Oid Id of the new object, InvalidOid on error.
+*/
+{
+    bool own_tx = !(flags & FLAG_TRANSACT_ON);
+    if (own_tx && !StartTransaction())
+        return InvalidOid;
+    Oid oid = CreateLargeObject();
+    PostgreLargeObject* lo = oid == InvalidOid ? 0 : OpenLargeObject(oid, true);
+    bool ok = false;
+    if (lo) {
+        lo->SetBufferSize(buffer_size);
+        ok = lo->WriteFrom(fd) >= 0;
+        delete lo;
+    }
+    if (own_tx) {
+        if (ok)
+            ok = Commit();
+        else
+            RollBack();
+    }
+    return ok ? oid : InvalidOid;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+Postgre::ExportLargeObject(Oid oid, int fd, size_t buffer_size)
+/*!
+  Streams the large object into the file descriptor.
+*/
+{
+    bool own_tx = !(flags & FLAG_TRANSACT_ON);
+    if (own_tx && !StartTransaction())
+        return false;
+    PostgreLargeObject* lo = OpenLargeObject(oid, false);
+    bool ok = false;
+    if (lo) {
+        lo->SetBufferSize(buffer_size);
+        ok = lo->ReadTo(fd) >= 0;
+        delete lo;
+    }
+    // Nothing was changed. Commit just ends the transaction.
+    if (own_tx)
+        Commit();
+    return ok;
+}
+
+// =================================================================================================
+PostgreLargeObject::PostgreLargeObject(Postgre* db_in, int fd_in)
+  : db(db_in)
+  , lo_fd(fd_in)
+{
+    buffer_size = 0x40000;
+}
+PostgreLargeObject::~PostgreLargeObject()
+{
+    if (db->GetPGConn())
+        lo_close(db->GetPGConn(), lo_fd);
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+PostgreLargeObject::failed(const char* call)
+{
+    db->SetLastError(call);
+    db->AppendLastError(PQerrorMessage(db->GetPGConn()));
+    return false;
+}
+
+// -------------------------------------------------------------------------------------------------
+int
+PostgreLargeObject::Read(void* data, size_t length)
+{
+    if (length > INT_MAX)
+        length = INT_MAX;
+    int rv = lo_read(db->GetPGConn(), lo_fd, (char*)data, length);
+    if (rv < 0)
+        failed("Large object read failed: ");
+    return rv;
+}
+bool
+PostgreLargeObject::Write(const void* data, size_t length)
+{
+    const char* ptr = (const char*)data;
+    while (length) {
+        size_t part = length > INT_MAX ? INT_MAX : length;
+        int rv = lo_write(db->GetPGConn(), lo_fd, ptr, part);
+        if (rv <= 0)
+            return failed("Large object write failed: ");
+        ptr += rv;
+        length -= rv;
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+long long
+PostgreLargeObject::Seek(long long offset, int whence)
+{
+    long long rv = lo_lseek64(db->GetPGConn(), lo_fd, offset, whence);
+    if (rv < 0)
+        failed("Large object seek failed: ");
+    return rv;
+}
+long long
+PostgreLargeObject::Tell()
+{
+    long long rv = lo_tell64(db->GetPGConn(), lo_fd);
+    if (rv < 0)
+        failed("Large object tell failed: ");
+    return rv;
+}
+long long
+PostgreLargeObject::GetSize()
+{
+    long long pos = Tell();
+    if (pos < 0)
+        return -1;
+    long long size = Seek(0, SEEK_END);
+    if (size < 0 || Seek(pos, SEEK_SET) < 0)
+        return -1;
+    return size;
+}
+bool
+PostgreLargeObject::Truncate(long long length)
+{
+    if (lo_truncate64(db->GetPGConn(), lo_fd, length) < 0)
+        return failed("Large object truncate failed: ");
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+long long
+PostgreLargeObject::ReadTo(int fd)
+{
+    if (!buffer)
+        buffer.reset(new char[buffer_size]);
+    long long total = 0;
+    for (;;) {
+        int rv = Read(buffer.get(), buffer_size);
+        if (rv < 0)
+            return -1;
+        if (rv == 0)
+            return total;
+        for (int done = 0; done < rv;) {
+            ssize_t written = write(fd, buffer.get() + done, rv - done);
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                db->SetLastError("Large object export - write failed: ");
+                db->AppendLastError(strerror(errno));
+                return -1;
+            }
+            done += written;
+        }
+        total += rv;
+    }
+}
+long long
+PostgreLargeObject::WriteFrom(int fd)
+{
+    if (!buffer)
+        buffer.reset(new char[buffer_size]);
+    long long total = 0;
+    for (;;) {
+        ssize_t rv = read(fd, buffer.get(), buffer_size);
+        if (rv < 0) {
+            if (errno == EINTR)
+                continue;
+            db->SetLastError("Large object import - read failed: ");
+            db->AppendLastError(strerror(errno));
+            return -1;
+        }
+        if (rv == 0)
+            return total;
+        if (!Write(buffer.get(), rv))
+            return -1;
+        total += rv;
+    }
+}
+
+}; // namespace ddb
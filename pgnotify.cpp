@@ -0,0 +1,182 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <algorithm>
+#include <cpp4scripts.hpp>
+
+#define __DDB_POSTGRE__
+#include "directdb.hpp"
+
+using namespace std;
+
+namespace ddb {
+
+// -------------------------------------------------------------------------------------------------
+bool
+Postgre::Listen(const char* channel)
+/*!
+  Subscribes this connection to the channel. Notifications are delivered by ProcessNotifies
+  and WaitNotifies. Channel name is quoted, i.e. it is case sensitive.
+*/
+{
+    if (!connection || !channel) {
+        SetLastError("Listen: no connection or channel.");
+        return false;
+    }
+    QueryBuffer sql;
+    sql << "LISTEN ";
+    sql.AppendIdent(channel, strlen(channel));
+    if (!UpdateStructure(sql.GetText()))
+        return false;
+    if (find(listen_channels.begin(), listen_channels.end(), channel) == listen_channels.end())
+        listen_channels.push_back(channel);
+    return true;
+}
+bool
+Postgre::Unlisten(const char* channel)
+/*!
+  \param channel Channel name or null to unsubscribe from all channels.
+*/
+{
+    if (!connection) {
+        SetLastError("Unlisten: no connection.");
+        return false;
+    }
+    QueryBuffer sql;
+    sql << "UNLISTEN ";
+    if (channel) {
+        sql.AppendIdent(channel, strlen(channel));
+        invalidate_channels.erase(
+            remove(invalidate_channels.begin(), invalidate_channels.end(), channel),
+            invalidate_channels.end());
+        listen_channels.erase(remove(listen_channels.begin(), listen_channels.end(), channel),
+                              listen_channels.end());
+    } else {
+        sql << '*';
+        invalidate_channels.clear();
+        listen_channels.clear();
+    }
+    return UpdateStructure(sql.GetText());
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+Postgre::Notify(const char* channel, const char* payload)
+/*!
+  Sends notification through pg_notify so that the payload does not need quoting. Inside a
+  transaction the notification is delivered at commit.
+*/
+{
+    if (!connection || !channel) {
+        SetLastError("Notify: no connection or channel.");
+        return false;
+    }
+    const char* values[2] = { channel, payload ? payload : "" };
+    PGresult* result =
+        PQexecParams(connection, "SELECT pg_notify($1,$2)", 2, 0, values, 0, 0, 0);
+    if (!result || PQresultStatus(result) != PGRES_TUPLES_OK) {
+        SetLastError("Notify failed: ");
+        AppendResultError(result);
+        PQclear(result);
+        return false;
+    }
+    PQclear(result);
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+Postgre::ListenInvalidate(const char* channel)
+/*!
+  Listens to the channel and drops entries from the attached result cache when notifications
+  arrive. Payload is a comma separated list of tags, e.g. table names. Empty payload
+  invalidates the channel name as a tag. Notifications are sent typically by a trigger:
+  PERFORM pg_notify('ddb_invalidate', TG_TABLE_NAME).
+*/
+{
+    if (!Listen(channel))
+        return false;
+    if (find(invalidate_channels.begin(), invalidate_channels.end(), channel) ==
+        invalidate_channels.end())
+        invalidate_channels.push_back(channel);
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+int
+Postgre::ProcessNotifies()
+/*!
+  Reads the pending input without blocking and delivers the received notifications to the
+  cache and to the handler. Notifications that arrived during the other queries are delivered
+  as well.
+  \retval int Number of notifications delivered, -1 if the connection failed.
+*/
+{
+    if (!connection)
+        return -1;
+    if (!PQconsumeInput(connection)) {
+        SetLastError("ProcessNotifies: ");
+        AppendLastError(PQerrorMessage(connection));
+        return -1;
+    }
+    int count = 0;
+    for (PGnotify* notify; (notify = PQnotifies(connection)) != 0; count++) {
+        if (cache && find(invalidate_channels.begin(), invalidate_channels.end(),
+                          notify->relname) != invalidate_channels.end()) {
+            string tag;
+            for (const char* ptr = notify->extra;; ptr++) {
+                if (*ptr && *ptr != ',') {
+                    if (*ptr != ' ')
+                        tag += *ptr;
+                    continue;
+                }
+                if (!tag.empty())
+                    cache->Invalidate(tag.c_str());
+                tag.clear();
+                if (!*ptr)
+                    break;
+            }
+            if (!*notify->extra)
+                cache->Invalidate(notify->relname);
+        }
+        if (notify_handler)
+            notify_handler(notify->relname, notify->extra, notify->be_pid);
+        PQfreemem(notify);
+    }
+    return count;
+}
+
+// -------------------------------------------------------------------------------------------------
+int
+Postgre::WaitNotifies(int timeout_ms)
+/*!
+  Waits until notifications arrive or the timeout expires.
+  \param timeout_ms Maximum wait time. Negative waits forever.
+  \retval int Number of notifications delivered, -1 on error.
+*/
+{
+    int count = ProcessNotifies();
+    if (count != 0)
+        return count;
+    pollfd pfd;
+    pfd.fd = PQsocket(connection);
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int rv = poll(&pfd, 1, timeout_ms);
+    if (rv < 0) {
+        SetLastError("WaitNotifies: poll failed: ");
+        AppendLastError(strerror(errno));
+        return -1;
+    }
+    return rv ? ProcessNotifies() : 0;
+}
+
+}; // namespace ddb
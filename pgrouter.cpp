@@ -0,0 +1,439 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <cpp4scripts.hpp>
+
+#define __DDB_POSTGRE__
+#include "directdb.hpp"
+
+using namespace std;
+
+namespace ddb {
+
+// Replication lag in milliseconds. Replica that has replayed everything it has received is not
+// behind even if the last replayed transaction is old (i.e. the primary has been idle). On the
+// primary the functions return null and the lag is zero.
+static const char* LAG_QUERY =
+    "SELECT COALESCE(CASE WHEN pg_last_wal_receive_lsn() = pg_last_wal_replay_lsn() THEN 0 "
+    "ELSE EXTRACT(EPOCH FROM now() - pg_last_xact_replay_timestamp()) * 1000 END, 0)";
+
+// -------------------------------------------------------------------------------------------------
+PostgreRouter::PostgreRouter()
+{
+    feat_support |= FEATURE_TRANSACTIONS;
+    feat_support |= FEATURE_AUTOTRIM;
+    feat_on |= FEATURE_TRANSACTIONS;
+    feat_on |= FEATURE_AUTOTRIM;
+    flags |= FLAG_INITIALIZED;
+    balance = ROUND_ROBIN;
+    next = 0;
+    max_lag = 0;
+    lag_interval = 1000;
+}
+
+// -------------------------------------------------------------------------------------------------
+PostgreRouter::~PostgreRouter()
+{
+    if (flags & FLAG_CONNECTED)
+        Disconnect();
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+PostgreRouter::Connect(const char* constr)
+/*!
+  \param constr Connection strings of the primary and the replicas separated with '|', e.g.
+    "host=db1 dbname=app|host=db2 dbname=app|host=db3 dbname=app".
+*/
+{
+    if (!constr) {
+        SetLastError("Connect: empty or incorrect connections string.");
+        return false;
+    }
+    vector<string> parts;
+    for (const char* start = constr;;) {
+        const char* end = strchr(start, '|');
+        parts.push_back(end ? string(start, end - start) : string(start));
+        if (!end)
+            break;
+        start = end + 1;
+    }
+    string first = parts.front();
+    parts.erase(parts.begin());
+    return Connect(first.c_str(), parts);
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+PostgreRouter::Connect(const char* primary_constr, const vector<string>& replica_constr)
+/*!
+  Connection to the primary must succeed. Replicas that cannot be connected are left out with
+  a warning so that the service can start while a replica is down.
+*/
+{
+    if (flags & FLAG_CONNECTED) {
+        SetLastError("Connect: router is already connected.");
+        return false;
+    }
+    primary.SetStatementTimeout(stmt_timeout);
+    if (!primary.Connect(primary_constr)) {
+        copyError(&primary);
+        return false;
+    }
+    for (const string& constr : replica_constr) {
+        Replica replica;
+        replica.db = new Postgre();
+        replica.db->SetStatementTimeout(stmt_timeout);
+        if (!replica.db->Connect(constr.c_str())) {
+            CS_VAPRT_WARN("PostgreRouter - replica left out: %s", replica.db->GetLastError());
+            delete replica.db;
+            continue;
+        }
+        replica.usable = true;
+        replica.latency_ms = 0;
+        replica.lag_ms = 0;
+        replicas.push_back(replica);
+    }
+    flags |= FLAG_CONNECTED;
+    CheckReplicas();
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+PostgreRouter::Disconnect()
+{
+    for (Replica& replica : replicas)
+        delete replica.db;
+    replicas.clear();
+    primary.Disconnect();
+    flags &= ~(FLAG_CONNECTED | FLAG_TRANSACT_ON);
+    return true;
+}
+bool
+PostgreRouter::ResetConnection()
+{
+    for (Replica& replica : replicas)
+        replica.usable = replica.db->ResetConnection();
+    if (!primary.ResetConnection()) {
+        copyError(&primary);
+        return false;
+    }
+    flags &= ~FLAG_TRANSACT_ON;
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+PostgreRouter::SetMaxLag(unsigned int max_lag_ms, unsigned int interval_ms)
+{
+    max_lag = max_lag_ms;
+    lag_interval = interval_ms;
+}
+bool
+PostgreRouter::SetStatementTimeout(unsigned int ms)
+{
+    stmt_timeout = ms;
+    bool rv = primary.SetStatementTimeout(ms);
+    for (Replica& replica : replicas)
+        replica.db->SetStatementTimeout(ms);
+    return rv;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+PostgreRouter::checkLag(Replica& replica)
+/*!
+  The check is also a health check and a latency sample. A replica with a lost connection gets
+  back into use when its reconnect succeeds.
+*/
+{
+    double lag;
+    auto start = chrono::steady_clock::now();
+    bool ok = replica.db->ExecuteDoubleFunction(LAG_QUERY, lag);
+    replica.checked = chrono::steady_clock::now();
+    if (!ok) {
+        CS_VAPRT_WARN("PostgreRouter - replica check failed: %s", replica.db->GetLastError());
+        replica.usable = false;
+        return false;
+    }
+    double ms = chrono::duration<double, milli>(replica.checked - start).count();
+    replica.latency_ms = replica.latency_ms > 0 ? 0.8 * replica.latency_ms + 0.2 * ms : ms;
+    replica.lag_ms = lag;
+    replica.usable = max_lag == 0 || lag <= max_lag;
+    return replica.usable;
+}
+size_t
+PostgreRouter::CheckReplicas()
+{
+    size_t usable = 0;
+    for (Replica& replica : replicas) {
+        if (checkLag(replica))
+            usable++;
+    }
+    return usable;
+}
+
+// -------------------------------------------------------------------------------------------------
+Postgre*
+PostgreRouter::PickReader()
+{
+    if (IsTransaction() || replicas.empty())
+        return &primary;
+    auto now = chrono::steady_clock::now();
+    auto interval = chrono::milliseconds(lag_interval);
+    Replica* best = 0;
+    for (size_t count = 0; count < replicas.size(); count++) {
+        size_t ndx = (next + count) % replicas.size();
+        Replica& replica = replicas[ndx];
+        if (now - replica.checked >= interval)
+            checkLag(replica);
+        if (!replica.usable)
+            continue;
+        if (balance == ROUND_ROBIN) {
+            next = ndx + 1;
+            return replica.db;
+        }
+        if (!best || replica.latency_ms < best->latency_ms)
+            best = &replica;
+    }
+    return best ? best->db : &primary;
+}
+PostgreRouter::Replica*
+PostgreRouter::findReplica(Postgre* db)
+{
+    for (Replica& replica : replicas) {
+        if (replica.db == db)
+            return &replica;
+    }
+    return 0;
+}
+void
+PostgreRouter::readDone(Postgre* db, chrono::steady_clock::time_point start, bool ok)
+/*!
+  Updates the latency average. Replica whose connection failed is skipped until its next check.
+*/
+{
+    Replica* replica = findReplica(db);
+    if (!replica)
+        return;
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    replica->latency_ms = 0.8 * replica->latency_ms + 0.2 * ms;
+    if (!ok && !db->IsConnectOK())
+        replica->usable = false;
+}
+
+// -------------------------------------------------------------------------------------------------
+RowSet*
+PostgreRouter::CreateRowSet()
+{
+    if (!(flags & FLAG_CONNECTED)) {
+        SetLastError("Attempt to use member functions without a connection to the database.");
+        return 0;
+    }
+    return new PostgreRouterRowSet(this);
+}
+bool
+PostgreRouter::CreateRowSet(RSInterface* cif)
+{
+    if (!(flags & FLAG_CONNECTED)) {
+        SetLastError("Attempt to use member functions without a connection to the database.");
+        return false;
+    }
+    cif->PostCreate(new PostgreRouterRowSet(this));
+    return true;
+}
+string
+PostgreRouter::GetErrorDescription(RowSet*)
+{
+    return string(GetLastError());
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+PostgreRouter::StartTransaction()
+{
+    if (!primary.StartTransaction()) {
+        copyError(&primary);
+        return false;
+    }
+    flags |= FLAG_TRANSACT_ON;
+    return true;
+}
+bool
+PostgreRouter::Commit()
+{
+    bool rv = primary.Commit();
+    // Transaction stays on if the primary's connection was lost, until RollBack.
+    if (!primary.IsTransaction())
+        flags &= ~FLAG_TRANSACT_ON;
+    if (!rv)
+        copyError(&primary);
+    return rv;
+}
+bool
+PostgreRouter::RollBack()
+{
+    flags &= ~FLAG_TRANSACT_ON;
+    if (!primary.RollBack()) {
+        copyError(&primary);
+        return false;
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Reads run on a replica. If the replica's connection fails the read is repeated on the primary.
+#define ROUTER_READ(call)                                                                          \
+    Postgre* db = PickReader();                                                                    \
+    auto start = chrono::steady_clock::now();                                                      \
+    bool rv = db->call;                                                                            \
+    readDone(db, start, rv);                                                                       \
+    if (!rv && db != &primary && !db->IsConnectOK()) {                                             \
+        db = &primary;                                                                             \
+        rv = db->call;                                                                             \
+    }                                                                                              \
+    if (!rv)                                                                                       \
+        copyError(db);                                                                             \
+    return rv;
+
+bool
+PostgreRouter::ExecuteIntFunction(const string& query, int& val)
+{
+    ROUTER_READ(ExecuteIntFunction(query, val))
+}
+bool
+PostgreRouter::ExecuteLongFunction(const string& query, long& val)
+{
+    ROUTER_READ(ExecuteLongFunction(query, val))
+}
+bool
+PostgreRouter::ExecuteDoubleFunction(const string& query, double& val)
+{
+    ROUTER_READ(ExecuteDoubleFunction(query, val))
+}
+bool
+PostgreRouter::ExecuteBoolFunction(const string& query, bool& val)
+{
+    ROUTER_READ(ExecuteBoolFunction(query, val))
+}
+bool
+PostgreRouter::ExecuteStrFunction(const string& query, string& result)
+{
+    ROUTER_READ(ExecuteStrFunction(query, result))
+}
+bool
+PostgreRouter::ExecuteDateFunction(const string& query, tm& val)
+{
+    ROUTER_READ(ExecuteDateFunction(query, val))
+}
+
+// -------------------------------------------------------------------------------------------------
+int
+PostgreRouter::ExecuteModify(const string& query)
+{
+    int rv = primary.ExecuteModify(query);
+    if (rv < 0)
+        copyError(&primary);
+    return rv;
+}
+bool
+PostgreRouter::UpdateStructure(const string& command)
+{
+    bool rv = primary.UpdateStructure(command);
+    if (!rv)
+        copyError(&primary);
+    return rv;
+}
+unsigned long
+PostgreRouter::GetInsertId()
+{
+    return primary.GetInsertId();
+}
+bool
+PostgreRouter::FindSchemaItem(ST stype, const char* name)
+{
+    return primary.FindSchemaItem(stype, name);
+}
+int
+PostgreRouter::ExecuteBulk(const string& query, const BulkParams& params, vector<int>* affected)
+{
+    int rv = primary.ExecuteBulk(query, params, affected);
+    if (rv < 0)
+        copyError(&primary);
+    return rv;
+}
+bool
+PostgreRouter::ExecuteInsert(const string& insert, const char* keys, vector<long long>& ids)
+{
+    bool rv = primary.ExecuteInsert(insert, keys, ids);
+    if (!rv)
+        copyError(&primary);
+    return rv;
+}
+int
+PostgreRouter::ExecuteBulkInsert(const string& insert,
+                                 const BulkParams& params,
+                                 const char* keys,
+                                 vector<long long>& ids)
+{
+    int rv = primary.ExecuteBulkInsert(insert, params, keys, ids);
+    if (rv < 0)
+        copyError(&primary);
+    return rv;
+}
+
+// =================================================================================================
+PostgreRouterRowSet::PostgreRouterRowSet(PostgreRouter* router_in)
+  : PostgreRowSet(&router_in->primary)
+  , router(router_in)
+{}
+// -------------------------------------------------------------------------------------------------
+bool
+PostgreRouterRowSet::Query()
+/*!
+  Whole result is read in Query so the row set does not need to hold on to the connection.
+*/
+{
+    Postgre* reader = router->PickReader();
+    Reset();
+    db = reader;
+    auto start = chrono::steady_clock::now();
+    bool rv = PostgreRowSet::Query();
+    router->readDone(reader, start, rv);
+    if (!rv && reader != &router->primary && !reader->IsConnectOK()) {
+        db = &router->primary;
+        rv = PostgreRowSet::Query();
+    }
+    if (!rv)
+        router->copyError(db);
+    return rv;
+}
+
+// -------------------------------------------------------------------------------------------------
+long
+PostgreRouterRowSet::WriteJson(JsonWriter& out)
+/*!
+  Unlike Query this is not repeated on the primary if the replica fails, since part of the
+  output may already have been written.
+*/
+{
+    Postgre* reader = router->PickReader();
+    Reset();
+    db = reader;
+    auto start = chrono::steady_clock::now();
+    long rv = PostgreRowSet::WriteJson(out);
+    router->readDone(reader, start, rv >= 0);
+    if (rv < 0)
+        router->copyError(db);
+    return rv;
+}
+
+}; // namespace ddb
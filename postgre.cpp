@@ -10,6 +10,9 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <charconv>
+#include <random>
+#include <poll.h>
 #include <cpp4scripts.hpp>
 
 #define __DDB_POSTGRE__
@@ -39,6 +42,8 @@ Postgre::Postgre()
     feat_on |= FEATURE_AUTOTRIM;
     flags |= FLAG_INITIALIZED;
     connection = 0;
+    cancel_obj = 0;
+    backoff_ms = 0;
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -72,6 +77,9 @@ Postgre::Connect(const char* constr)
     flags |= FLAG_CONNECTED;
     CS_VAPRT_INFO("Postgre client encoding id=%d", PQclientEncoding(connection));
     PQsetNoticeProcessor(connection, &PQNoticeProcessor, 0);
+    cancel_obj = PQgetCancel(connection);
+    if (stmt_timeout)
+        return applyTimeout();
     return true;
 }
 
@@ -79,8 +87,15 @@ Postgre::Connect(const char* constr)
 bool
 Postgre::Disconnect()
 {
+    if (cancel_obj)
+        PQfreeCancel(cancel_obj);
+    cancel_obj = 0;
     if (connection)
         PQfinish(connection);
+    connection = 0;
+    prepared.clear();
+    listen_channels.clear();
+    invalidate_channels.clear();
     flags &= ~FLAG_CONNECTED;
     return true;
 }
@@ -95,9 +110,209 @@ Postgre::IsConnectOK()
 // -------------------------------------------------------------------------------------------------
 bool
 Postgre::ResetConnection()
+/*!
+  Resets the connection right away regardless of the reconnect backoff. An open transaction is
+  lost with the old connection.
+*/
+{
+    if (!connection)
+        return false;
+    if (!resetPoll())
+        return false;
+    backoff_ms = 0;
+    flags &= ~FLAG_TRANSACT_ON;
+    return restoreSession();
+}
+// -------------------------------------------------------------------------------------------------
+bool
+Postgre::resetPoll()
+/*!
+  Resets the connection with the non-blocking PQresetStart / PQresetPoll so that the attempt
+  is limited by the policy's connect timeout.
+*/
+{
+    auto deadline = chrono::steady_clock::now() +
+                    chrono::milliseconds(reconnect_policy.connect_timeout_ms);
+    if (!PQresetStart(connection)) {
+        SetLastError("Reconnect failed: ");
+        AppendLastError(PQerrorMessage(connection));
+        return false;
+    }
+    PostgresPollingStatusType status = PGRES_POLLING_WRITING;
+    while (status != PGRES_POLLING_OK && status != PGRES_POLLING_FAILED) {
+        int wait = chrono::duration_cast<chrono::milliseconds>(deadline -
+                                                               chrono::steady_clock::now())
+                       .count();
+        if (wait <= 0) {
+            SetLastError("Reconnect failed: timeout.");
+            return false;
+        }
+        pollfd pfd;
+        pfd.fd = PQsocket(connection);
+        pfd.events = status == PGRES_POLLING_READING ? POLLIN : POLLOUT;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, wait) < 0 && errno != EINTR)
+            break;
+        status = PQresetPoll(connection);
+    }
+    if (status != PGRES_POLLING_OK) {
+        SetLastError("Reconnect failed: ");
+        AppendLastError(PQerrorMessage(connection));
+        return false;
+    }
+    return true;
+}
+// -------------------------------------------------------------------------------------------------
+bool
+Postgre::restoreSession()
+/*!
+  Server side session state is lost with the connection. Settings, prepared statements and
+  listened channels are restored. The transaction is not: callers clear it with RollBack.
+*/
+{
+    if (cancel_obj)
+        PQfreeCancel(cancel_obj);
+    cancel_obj = PQgetCancel(connection);
+    if (stmt_timeout && !applyTimeout())
+        return false;
+    for (auto& stmt : prepared) {
+        PGresult* result = PQprepare(connection, stmt.second.c_str(), stmt.first.c_str(), 0, 0);
+        bool ok = result && PQresultStatus(result) == PGRES_COMMAND_OK;
+        PQclear(result);
+        if (!ok) {
+            prepared.clear();
+            break;
+        }
+    }
+    vector<string> channels;
+    channels.swap(listen_channels);
+    for (const string& channel : channels)
+        Listen(channel.c_str());
+    CS_PRINT_NOTE("Postgre - connection restored.");
+    return true;
+}
+// -------------------------------------------------------------------------------------------------
+bool
+Postgre::reconnect()
+/*!
+  Makes one reconnect attempt unless the backoff wait is still on. Wait grows after each
+  failed attempt and has a random part so that clients do not reconnect in sync.
+*/
+{
+    auto now = chrono::steady_clock::now();
+    if (backoff_ms && now < next_reconnect) {
+        SetLastError("Connection lost. Waiting before the next reconnect attempt.");
+        return false;
+    }
+    if (resetPoll()) {
+        backoff_ms = 0;
+        return restoreSession();
+    }
+    const ReconnectPolicy& rp = reconnect_policy;
+    if (!backoff_ms)
+        backoff_ms = rp.initial_ms;
+    else if (backoff_ms * rp.multiplier < rp.max_ms)
+        backoff_ms *= rp.multiplier;
+    else
+        backoff_ms = rp.max_ms;
+    static thread_local minstd_rand rng(random_device{}());
+    double factor = 1.0 - rp.jitter * uniform_real_distribution<double>(0.0, 1.0)(rng);
+    next_reconnect = now + chrono::milliseconds((long)(backoff_ms * factor));
+    return false;
+}
+// -------------------------------------------------------------------------------------------------
+bool
+Postgre::checkConnection()
+/*!
+  Called before statements. Returns false if the connection is lost and cannot be restored.
+  Connection lost during a transaction is not restored until the caller calls RollBack, i.e.
+  statements would otherwise autocommit silently after the reconnect.
+*/
+{
+    if (!connection) {
+        SetLastError("Attempt to use member functions without a connection to the database.");
+        return false;
+    }
+    if (PQstatus(connection) == CONNECTION_OK)
+        return true;
+    if (flags & FLAG_TRANSACT_ON) {
+        SetLastError("Connection lost during transaction. Call RollBack to reconnect.");
+        return false;
+    }
+    if (!reconnect_policy.enabled) {
+        SetLastError("Connection to the database has been lost.");
+        return false;
+    }
+    return reconnect();
+}
+// -------------------------------------------------------------------------------------------------
+PGresult*
+Postgre::ExecRead(const char* query, bool binary)
+/*!
+  \param binary Request the result in binary format. Query must be a single statement.
+*/
+{
+    if (!checkConnection())
+        return 0;
+    bool in_tx = IsTransaction();
+    PGresult* result = binary ? PQexecParams(connection, query, 0, 0, 0, 0, 0, 1)
+                              : PQexec(connection, query);
+    if (PQstatus(connection) == CONNECTION_OK || !reconnect_policy.enabled)
+        return result;
+    // Connection was lost during the statement.
+    PQclear(result);
+    if (in_tx) {
+        SetLastError("Connection lost during transaction. Call RollBack to reconnect.");
+        return 0;
+    }
+    if (!reconnect() || !reconnect_policy.replay_reads)
+        return 0;
+    return binary ? PQexecParams(connection, query, 0, 0, 0, 0, 0, 1) : PQexec(connection, query);
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+Postgre::SetStatementTimeout(unsigned int ms)
+/*!
+  Uses the server's statement_timeout setting. Server stops the statement and the connection
+  stays usable. Setting is sent only when it changes, i.e. there is no cost per statement.
+*/
+{
+    stmt_timeout = ms;
+    return connection ? applyTimeout() : true;
+}
+bool
+Postgre::applyTimeout()
 {
-    PQreset(connection);
-    return IsConnectOK();
+    string sql("SET statement_timeout = ");
+    sql += to_string(stmt_timeout);
+    return UpdateStructure(sql);
+}
+bool
+Postgre::Cancel()
+/*!
+  Sends cancel request for the running statement through a separate connection.
+*/
+{
+    char errbuf[256];
+    if (!cancel_obj)
+        return false;
+    return PQcancel(cancel_obj, errbuf, sizeof(errbuf)) ? true : false;
+}
+void
+Postgre::AppendResultError(PGresult* result)
+/*!
+  SQLSTATE 57014 (query_canceled) is set both for the statement timeout and for Cancel.
+*/
+{
+    if (!result) {
+        timed_out = false;
+        AppendLastError(PQerrorMessage(connection));
+        return;
+    }
+    const char* state = PQresultErrorField(result, PG_DIAG_SQLSTATE);
+    timed_out = state && !strcmp(state, "57014");
+    AppendLastError(PQresultErrorMessage(result));
 }
 // -------------------------------------------------------------------------------------------------
 RowSet*
@@ -148,6 +363,8 @@ Postgre::StartTransaction()
         return false;
     }
 
+    if (!checkConnection())
+        return false;
     PGresult* result = PQexec(connection, "BEGIN");
     PQclear(result);
 
@@ -167,6 +384,10 @@ Postgre::Commit()
         SetLastError("Commit/RollBack: The transaction has not been started.");
         return false;
     }
+    if (PQstatus(connection) != CONNECTION_OK) {
+        SetLastError("Commit: Connection lost during transaction. Call RollBack to reconnect.");
+        return false;
+    }
 
     PGresult* result = PQexec(connection, "COMMIT");
     PQclear(result);
@@ -178,6 +399,10 @@ Postgre::Commit()
 // -------------------------------------------------------------------------------------------------
 bool
 Postgre::RollBack()
+/*!
+  If the connection was lost during the transaction the server has already rolled it back. The
+  transaction is then cleared and the connection restored.
+*/
 {
     if (!(flags & FLAG_CONNECTED)) {
         SetLastError("Attempt to use member functions without a connection to the database.");
@@ -187,11 +412,22 @@ Postgre::RollBack()
         SetLastError("Commit/RollBack: The transaction has not been started.");
         return false;
     }
+    flags &= ~FLAG_TRANSACT_ON;
+    if (PQstatus(connection) != CONNECTION_OK) {
+        // Server rolled the transaction back when the connection was lost.
+        if (!reconnect_policy.enabled) {
+            SetLastError("Connection to the database has been lost.");
+            return false;
+        }
+        return reconnect();
+    }
 
     PGresult* result = PQexec(connection, "ROLLBACK");
     PQclear(result);
 
-    flags &= ~FLAG_TRANSACT_ON;
+    // SET inside the transaction is rolled back too.
+    if (stmt_timeout)
+        applyTimeout();
     return true;
 }
 
@@ -201,12 +437,12 @@ Postgre::ExecuteIntFunction(const string& query, int& val)
 {
     if (query.length() == 0)
         return false;
-    PGresult* result = PQexec(connection, query.c_str());
+    PGresult* result = ExecRead(query.c_str());
 
     if (!result || PQresultStatus(result) != PGRES_TUPLES_OK) {
         if (result) {
             SetLastError("ExecuteIntFunction failed: ");
-            AppendLastError(PQresultErrorMessage(result));
+            AppendResultError(result);
             PQclear(result);
         }
         return false;
@@ -226,12 +462,12 @@ Postgre::ExecuteLongFunction(const string& query, long& val)
 {
     if (query.length() == 0)
         return false;
-    PGresult* result = PQexec(connection, query.c_str());
+    PGresult* result = ExecRead(query.c_str());
 
     if (!result || PQresultStatus(result) != PGRES_TUPLES_OK) {
         if (result) {
             SetLastError("ExecuteLongFunction failed: ");
-            AppendLastError(PQresultErrorMessage(result));
+            AppendResultError(result);
             PQclear(result);
         }
         return false;
@@ -251,12 +487,12 @@ Postgre::ExecuteDoubleFunction(const string& query, double& val)
 {
     if (query.length() == 0)
         return false;
-    PGresult* result = PQexec(connection, query.c_str());
+    PGresult* result = ExecRead(query.c_str());
 
     if (!result || PQresultStatus(result) != PGRES_TUPLES_OK) {
         if (result) {
             SetLastError("ExecuteDoubleFunction failed: ");
-            AppendLastError(PQresultErrorMessage(result));
+            AppendResultError(result);
             PQclear(result);
         }
         return false;
@@ -281,12 +517,12 @@ Postgre::ExecuteBoolFunction(const string& query, bool& val)
 {
     if (query.length() == 0)
         return false;
-    PGresult* result = PQexec(connection, query.c_str());
+    PGresult* result = ExecRead(query.c_str());
 
     if (!result || PQresultStatus(result) != PGRES_TUPLES_OK) {
         if (result) {
             SetLastError("ExecuteBoolFunction failed: ");
-            AppendLastError(PQresultErrorMessage(result));
+            AppendResultError(result);
             PQclear(result);
         }
         return false;
@@ -311,11 +547,11 @@ Postgre::ExecuteStrFunction(const string& query, string& answer)
 {
     if (query.length() == 0)
         return false;
-    PGresult* result = PQexec(connection, query.c_str());
+    PGresult* result = ExecRead(query.c_str());
     if (!result || PQresultStatus(result) != PGRES_TUPLES_OK) {
         if (result) {
             SetLastError("ExecuteStrFunction failed: ");
-            AppendLastError(PQresultErrorMessage(result));
+            AppendResultError(result);
             PQclear(result);
         }
         return false;
@@ -345,12 +581,12 @@ Postgre::ExecuteDateFunction(const string& query, tm& val)
     tm* tmPtr;
     if (query.length() == 0)
         return false;
-    PGresult* result = PQexec(connection, query.c_str());
+    PGresult* result = ExecRead(query.c_str());
 
     if (!result || PQresultStatus(result) != PGRES_TUPLES_OK) {
         if (result) {
             SetLastError("ExecuteDateFunction failed: ");
-            AppendLastError(PQresultErrorMessage(result));
+            AppendResultError(result);
             PQclear(result);
         }
         return false;
@@ -376,11 +612,13 @@ Postgre::ExecuteModify(const string& modify)
 {
     if (modify.length() == 0)
         return -1;
+    if (!checkConnection())
+        return -1;
     PGresult* result = PQexec(connection, modify.c_str());
     if (!result || PQresultStatus(result) != PGRES_COMMAND_OK) {
         if (result) {
             SetLastError("ExecuteModify - Failed: ");
-            AppendLastError(PQresultErrorMessage(result));
+            AppendResultError(result);
             PQclear(result);
         }
         return -1;
@@ -398,16 +636,19 @@ Postgre::UpdateStructure(const string& command)
 {
     if (command.length() == 0)
         return false;
+    if (!checkConnection())
+        return false;
     PGresult* result = PQexec(connection, command.c_str());
 
     if (!result || PQresultStatus(result) != PGRES_COMMAND_OK) {
         if (result) {
             SetLastError("ExecuteModify failed: ");
-            AppendLastError(PQresultErrorMessage(result));
+            AppendResultError(result);
             PQclear(result);
         }
         return false;
     }
+    PQclear(result);
     return true;
 }
 
@@ -422,17 +663,280 @@ Postgre::GetInsertId()
     }
     if (PQresultStatus(result) != PGRES_TUPLES_OK) {
         SetLastError("GetInsertId Failed: ");
-        AppendLastError(PQresultErrorMessage(result));
+        AppendResultError(result);
         PQclear(result);
         return 0;
     }
-    char* endptr;
-    char* resultStr = PQgetvalue(result, 0, 0);
-    errno = 0;
-    unsigned long rv = strtoul(resultStr, &endptr, 10);
-    if (errno)
+    vector<long long> ids;
+    appendKeys(result, ids);
+    PQclear(result);
+    return ids.empty() || ids[0] < 0 ? 0 : (unsigned long)ids[0];
+}
+
+// -------------------------------------------------------------------------------------------------
+int
+Postgre::ExecuteBulk(const string& query, const BulkParams& params, vector<int>* affected)
+{
+    return runBulk(query, params, affected, 0);
+}
+int
+Postgre::ExecuteBulkInsert(const string& insert,
+                           const BulkParams& params,
+                           const char* keys,
+                           vector<long long>& ids)
+{
+    ids.clear();
+    if (!keys || !*keys) {
+        SetLastError("ExecuteBulkInsert - key columns are missing.");
+        return -1;
+    }
+    return runBulk(insert + " RETURNING " + keys, params, 0, &ids);
+}
+// -------------------------------------------------------------------------------------------------
+int
+Postgre::runBulk(const string& query,
+                 const BulkParams& params,
+                 vector<int>* affected,
+                 vector<long long>* ids)
+/*!
+  Statement is prepared once per connection and the rows are sent in pipeline mode when libpq
+  supports it. Otherwise each row is a separate PQexecPrepared round trip.
+*/
+{
+    if (query.length() == 0 || params.GetColumns() == 0)
+        return -1;
+    if (!checkConnection())
+        return -1;
+    const char* name = prepareCached(query);
+    if (!name)
+        return -1;
+    bool own_tx = !IsTransaction();
+    if (own_tx && !StartTransaction())
+        return -1;
+    if (affected) {
+        affected->clear();
+        affected->reserve(params.GetRows());
+    }
+    int total;
+#ifdef LIBPQ_HAS_PIPELINING
+    total = bulkPipeline(name, params, affected, ids);
+#else
+    total = bulkPrepared(name, params, affected, ids);
+#endif
+    if (own_tx) {
+        if (total < 0)
+            RollBack();
+        else if (!Commit())
+            return -1;
+    }
+    return total;
+}
+// -------------------------------------------------------------------------------------------------
+const char*
+Postgre::prepareCached(const string& query)
+/*!
+  Returns the server side statement name for the query. Names are forgotten on reset and
+  disconnect since the server drops the statements with the session.
+*/
+{
+    auto it = prepared.find(query);
+    if (it != prepared.end())
+        return it->second.c_str();
+    string name("ddb_bulk_");
+    name += to_string(prepared.size() + 1);
+    PGresult* result = PQprepare(connection, name.c_str(), query.c_str(), 0, 0);
+    if (!result || PQresultStatus(result) != PGRES_COMMAND_OK) {
+        SetLastError("ExecuteBulk - prepare failed: ");
+        AppendResultError(result);
+        PQclear(result);
         return 0;
-    return rv;
+    }
+    PQclear(result);
+    return prepared.emplace(query, name).first->second.c_str();
+}
+// -------------------------------------------------------------------------------------------------
+const char* const*
+Postgre::bulkValues(const BulkParams& params, size_t row)
+/*!
+  Converts one row into text parameters. Blobs are sent as binary straight from the caller's
+  memory. Arrays are sent as text, e.g. {1,2,3}, so that the server converts them to the
+  column's array type (int4[], numeric[], varchar[], ...). Pointers, value_lengths and
+  value_formats are valid until the next call.
+*/
+{
+    size_t cols = params.GetColumns();
+    value_offsets.resize(cols);
+    value_ptrs.resize(cols);
+    value_lengths.resize(cols);
+    value_formats.resize(cols);
+    text_buffer.clear();
+    for (size_t col = 0; col < cols; col++) {
+        const BulkParams::Column& column = params.GetColumn(col);
+        value_offsets[col] = text_buffer.size();
+        // Decimals are sent as text, the exact numeric input format.
+        if (column.type == DT::BLOB) {
+            value_formats[col] = 1;
+            value_lengths[col] = static_cast<const Blob*>(column.data)[row].size;
+        } else {
+            value_formats[col] = 0;
+            value_lengths[col] = 0;
+            params.FormatText(row, col, text_buffer);
+        }
+    }
+    for (size_t col = 0; col < cols; col++) {
+        const BulkParams::Column& column = params.GetColumn(col);
+        if (column.type == DT::BLOB) {
+            const Blob& blob = static_cast<const Blob*>(column.data)[row];
+            value_ptrs[col] = blob.data ? (const char*)blob.data : "";
+        } else
+            value_ptrs[col] = text_buffer.data() + value_offsets[col];
+    }
+    return value_ptrs.data();
+}
+// -------------------------------------------------------------------------------------------------
+int
+Postgre::bulkResult(PGresult* result, vector<int>* affected, vector<long long>* ids)
+/*!
+  Collects the affected count and the returned keys of one row's result.
+  \retval int Number of affected rows, -1 if the row failed.
+*/
+{
+    ExecStatusType status = PQresultStatus(result);
+    if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK) {
+        SetLastError("ExecuteBulk failed: ");
+        AppendResultError(result);
+        return -1;
+    }
+    if (ids && status == PGRES_TUPLES_OK)
+        appendKeys(result, *ids);
+    int count = strtol(PQcmdTuples(result), 0, 10);
+    if (affected)
+        affected->push_back(count);
+    return count;
+}
+// -------------------------------------------------------------------------------------------------
+int
+Postgre::bulkPrepared(const char* name,
+                      const BulkParams& params,
+                      vector<int>* affected,
+                      vector<long long>* ids)
+{
+    int total = 0;
+    for (size_t row = 0; row < params.GetRows(); row++) {
+        const char* const* values = bulkValues(params, row);
+        PGresult* result = PQexecPrepared(connection, name, params.GetColumns(), values,
+                                          value_lengths.data(), value_formats.data(), 0);
+        if (!result) {
+            SetLastError("ExecuteBulk failed: ");
+            AppendLastError(PQerrorMessage(connection));
+            return -1;
+        }
+        int count = bulkResult(result, affected, ids);
+        PQclear(result);
+        if (count < 0)
+            return -1;
+        total += count;
+    }
+    return total;
+}
+// -------------------------------------------------------------------------------------------------
+int
+Postgre::bulkPipeline(const char* name,
+                      const BulkParams& params,
+                      vector<int>* affected,
+                      vector<long long>* ids)
+/*!
+  Rows are sent in chunks followed by a sync so that the command results the server sends back
+  cannot fill up the socket buffers while we are still writing.
+*/
+{
+#ifdef LIBPQ_HAS_PIPELINING
+    const size_t CHUNK = 1000;
+    if (!PQenterPipelineMode(connection))
+        return bulkPrepared(name, params, affected, ids);
+    int total = 0;
+    for (size_t start = 0; start < params.GetRows() && total >= 0; start += CHUNK) {
+        size_t end = start + CHUNK < params.GetRows() ? start + CHUNK : params.GetRows();
+        size_t sent = start;
+        for (; sent < end; sent++) {
+            const char* const* values = bulkValues(params, sent);
+            if (!PQsendQueryPrepared(connection, name, params.GetColumns(), values,
+                                     value_lengths.data(), value_formats.data(), 0))
+                break;
+        }
+        if (sent < end || !PQpipelineSync(connection)) {
+            SetLastError("ExecuteBulk - send failed: ");
+            AppendLastError(PQerrorMessage(connection));
+            total = -1;
+            if (sent == start)
+                break;
+            PQpipelineSync(connection);
+        }
+        // Each query gives its result followed by null. The sync gives PGRES_PIPELINE_SYNC.
+        for (PGresult* result; (result = PQgetResult(connection)) != 0;) {
+            ExecStatusType status = PQresultStatus(result);
+            if (status == PGRES_PIPELINE_SYNC) {
+                PQclear(result);
+                break;
+            }
+            if (status != PGRES_PIPELINE_ABORTED && total >= 0) {
+                int count = bulkResult(result, affected, ids);
+                total = count < 0 ? -1 : total + count;
+            }
+            PQclear(result);
+            PQgetResult(connection);
+        }
+    }
+    PQexitPipelineMode(connection);
+    return total;
+#else
+    return bulkPrepared(name, params, affected, ids);
+#endif
+}
+// -------------------------------------------------------------------------------------------------
+void
+Postgre::appendKeys(PGresult* result, vector<long long>& ids)
+{
+    int rows = PQntuples(result);
+    int cols = PQnfields(result);
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            const char* value = PQgetvalue(result, row, col);
+            long long id = 0;
+            from_chars(value, value + PQgetlength(result, row, col), id);
+            ids.push_back(id);
+        }
+    }
+}
+// -------------------------------------------------------------------------------------------------
+bool
+Postgre::ExecuteInsert(const string& insert, const char* keys, vector<long long>& ids)
+/*!
+  Keys come back with the insert so there is no separate lastval() round trip.
+*/
+{
+    ids.clear();
+    if (insert.length() == 0)
+        return false;
+    if (!keys || !*keys) {
+        SetLastError("ExecuteInsert - key columns are missing.");
+        return false;
+    }
+    string query(insert);
+    query += " RETURNING ";
+    query += keys;
+    if (!checkConnection())
+        return false;
+    PGresult* result = PQexec(connection, query.c_str());
+    if (!result || PQresultStatus(result) != PGRES_TUPLES_OK) {
+        SetLastError("ExecuteInsert failed: ");
+        AppendResultError(result);
+        PQclear(result);
+        return false;
+    }
+    appendKeys(result, ids);
+    PQclear(result);
+    return true;
 }
 
 // ==========================================================================================
@@ -468,13 +972,17 @@ Postgre::CreateDatabase(const string& dbname, const string& owner)
     rs->query << "SELECT datname FROM pg_database";
     rs->Query();
     while (rs->GetNext()) {
-        if (!rsname.compare(dbname))
+        if (!rsname.compare(dbname)) {
+            delete rs;
             return true;
+        }
     }
     // Create database
-    rs->query.str("");
+    rs->query.Clear();
     rs->query << "CREATE DATABASE " << dbname << " OWNER=" << owner;
-    if (!UpdateStructure(rs->query.str())) {
+    bool created = UpdateStructure(rs->query.str());
+    delete rs;
+    if (!created) {
         SetLastError("Unable to create database.");
         return false;
     }
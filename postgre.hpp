@@ -10,13 +10,19 @@
 #define DDB_POSTGRE_H_FILE
 
 #include <libpq-fe.h>
+#include <map>
+#include <functional>
 
 namespace ddb {
 
+class PostgreLargeObject;
+
 // -------------------------------------------------------------------------------------------------
 //! Class defines PostgreSQL specific implementation to Database-interface.
 class Postgre : public Database
 {
+    friend class PostgreRowSet;
+
   public:
     Postgre();
     ~Postgre();
@@ -47,11 +53,45 @@ class Postgre : public Database
     bool UpdateStructure(const std::string& command);
     std::string GetErrorDescription(RowSet* rs);
     bool FindSchemaItem(ST stype, const char* name) { return false; } // TODO
+    int ExecuteBulk(const std::string& query,
+                    const BulkParams& params,
+                    std::vector<int>* affected = 0);
+    bool ExecuteInsert(const std::string& insert, const char* keys, std::vector<long long>& ids);
+    int ExecuteBulkInsert(const std::string& insert,
+                          const BulkParams& params,
+                          const char* keys,
+                          std::vector<long long>& ids);
 
     // Unique interface
     PGconn* GetPGConn();
     bool IsConnected() { return connection == 0 ? false : true; }
 
+    // LISTEN / NOTIFY
+    typedef std::function<void(const char* channel, const char* payload, int pid)> NotifyHandler;
+    bool Listen(const char* channel);
+    bool Unlisten(const char* channel);
+    bool Notify(const char* channel, const char* payload = 0);
+    bool ListenInvalidate(const char* channel);
+    void SetNotifyHandler(NotifyHandler handler) { notify_handler = handler; }
+    int ProcessNotifies();
+    int WaitNotifies(int timeout_ms);
+    //! Returns the connection socket for the application's own poll/epoll loop.
+    int GetSocket() { return connection ? PQsocket(connection) : -1; }
+
+    bool SetStatementTimeout(unsigned int ms);
+    bool Cancel();
+    //! Appends the result's error message to the last error and detects the timeout.
+    void AppendResultError(PGresult* result);
+    //! Runs a read-only statement. Statement is repeated once if the connection was lost.
+    PGresult* ExecRead(const char* query, bool binary = false);
+
+    // Large objects
+    Oid CreateLargeObject();
+    PostgreLargeObject* OpenLargeObject(Oid oid, bool write = false);
+    bool UnlinkLargeObject(Oid oid);
+    Oid ImportLargeObject(int fd, size_t buffer_size = 0x40000);
+    bool ExportLargeObject(Oid oid, int fd, size_t buffer_size = 0x40000);
+
     // Admin commands
     bool CreateUser(const std::string& uid, const std::string& pwd);
     bool CreateDatabase(const std::string& dbname, const std::string& owner);
@@ -65,12 +105,91 @@ class Postgre : public Database
     }
 
   protected:
+    const char* prepareCached(const std::string& query);
+    bool applyTimeout();
+    bool checkConnection();
+    bool reconnect();
+    bool resetPoll();
+    bool restoreSession();
+    int runBulk(const std::string& query,
+                const BulkParams& params,
+                std::vector<int>* affected,
+                std::vector<long long>* ids);
+    int bulkPipeline(const char* name,
+                     const BulkParams& params,
+                     std::vector<int>* affected,
+                     std::vector<long long>* ids);
+    int bulkPrepared(const char* name,
+                     const BulkParams& params,
+                     std::vector<int>* affected,
+                     std::vector<long long>* ids);
+    int bulkResult(PGresult* result, std::vector<int>* affected, std::vector<long long>* ids);
+    void appendKeys(PGresult* result, std::vector<long long>& ids);
+    const char* const* bulkValues(const BulkParams& params, size_t row);
+
     PGconn* connection;
+    PGcancel* cancel_obj; //!< Cancel request object of the current connection.
+    std::map<std::string, std::string> prepared; //!< ExecuteBulk statement names by query.
+    std::string text_buffer;                     //!< Conversion buffer for bulk parameters.
+    std::vector<const char*> value_ptrs;         //!< Parameter pointers into text_buffer.
+    std::vector<size_t> value_offsets;           //!< Parameter offsets in text_buffer.
+    std::vector<int> value_lengths;              //!< Parameter lengths of binary values.
+    std::vector<int> value_formats;              //!< Parameter formats, 1 for binary.
+    NotifyHandler notify_handler;                //!< Receives the notifications.
+    std::vector<std::string> invalidate_channels; //!< Channels whose payloads are cache tags.
+    std::vector<std::string> listen_channels;     //!< Channels restored after reconnect.
+    std::chrono::steady_clock::time_point next_reconnect; //!< No reconnect attempts before this.
+    unsigned int backoff_ms;                              //!< Current reconnect wait.
 };
 
 void
 PQNoticeProcessor(void*, const char* message);
 
+// -------------------------------------------------------------------------------------------------
+//! Stream handle of a PostgreSQL large object.
+/*! Created by Postgre::OpenLargeObject. Large objects can only be used inside a transaction and
+  the handle is closed by the server at the end of the transaction, i.e. delete the handle before
+  Commit or RollBack. ReadTo and WriteFrom copy between the object and a file descriptor through
+  a buffer of the given size so that the object is never in memory as a whole. Errors are set to
+  the database.
+*/
+class PostgreLargeObject
+{
+    friend class Postgre;
+
+  public:
+    ~PostgreLargeObject();
+
+    //! \retval int Bytes read, 0 at the end and -1 on error.
+    int Read(void* buffer, size_t length);
+    bool Write(const void* buffer, size_t length);
+    //! Moves the position. whence is SEEK_SET, SEEK_CUR or SEEK_END. Returns the new position.
+    long long Seek(long long offset, int whence = SEEK_SET);
+    long long Tell();
+    long long GetSize();
+    bool Truncate(long long length);
+
+    //! Sets the buffer size of ReadTo and WriteFrom.
+    void SetBufferSize(size_t size)
+    {
+        buffer_size = size ? size : 1;
+        buffer.reset();
+    }
+    //! Copies from the current position to the end into fd. Returns the bytes or -1.
+    long long ReadTo(int fd);
+    //! Copies everything from fd to the current position. Returns the bytes or -1.
+    long long WriteFrom(int fd);
+
+  protected:
+    PostgreLargeObject(Postgre* db_in, int fd_in);
+    bool failed(const char* call);
+
+    Postgre* db;
+    int lo_fd; //!< Large object descriptor.
+    size_t buffer_size;
+    std::unique_ptr<char[]> buffer;
+};
+
 // -------------------------------------------------------------------------------------------------
 //! Class defines PostgreSQL specific implementation to RowSet-interface.
 class PostgreRowSet : public RowSet
@@ -83,14 +202,135 @@ class PostgreRowSet : public RowSet
     bool Query();
     int GetNext();
     void Reset();
+    long WriteJson(JsonWriter& out);
 
   protected:
     PostgreRowSet(Database*);
+    int getNextBinary();
+    bool checkBinary();
 
     Postgre* db;          //!< Pointer to databse object.
     size_t max_rows;      //!< Total number of records in the current query.
     PGresult* result;     //!< Pointer to the result structure.
     bool result_complete; //!< True if the results have been retrieved..
+    bool binary;          //!< Result is in binary format. Used when a DT::BLOB is bound.
+};
+
+// -------------------------------------------------------------------------------------------------
+//! PostgreSQL primary with read replicas.
+/*! Router sends the RowSet queries and Execute...Function reads to the replicas and everything
+  else, i.e. modifications, inserts and transactions, to the primary. While a transaction is on
+  the reads go to the primary too so that they see the uncommitted changes. Replicas are picked
+  either in turn or by the lowest measured read latency.
+
+  Replica lag is checked with pg_last_xact_replay_timestamp at most once per check interval. A
+  replica that is more behind than the allowed lag or whose connection fails is skipped until
+  the next check. If no replica is usable the reads go to the primary.
+
+  Like Postgre, the router is meant for one thread at a time.
+*/
+class PostgreRouter : public Database
+{
+    friend class PostgreRouterRowSet;
+
+  public:
+    enum BALANCE
+    {
+        ROUND_ROBIN,
+        LEAST_LATENCY
+    };
+
+    PostgreRouter();
+    ~PostgreRouter();
+
+    // Database interface
+    RDBM GetType() { return RDBM::POSTGRES; }
+    bool Connect(const char* constr);
+    bool Connect(const char* primary, const std::vector<std::string>& replicas);
+    bool Disconnect();
+    bool IsConnectOK() { return primary.IsConnectOK(); }
+    bool ResetConnection();
+    //
+    RowSet* CreateRowSet();
+    bool CreateRowSet(RSInterface*);
+    //
+    bool StartTransaction();
+    bool Commit();
+    bool RollBack();
+    //
+    bool ExecuteIntFunction(const std::string& query, int& val);
+    bool ExecuteLongFunction(const std::string& query, long& val);
+    bool ExecuteDoubleFunction(const std::string& query, double& val);
+    bool ExecuteBoolFunction(const std::string& query, bool& val);
+    bool ExecuteStrFunction(const std::string& query, std::string& result);
+    bool ExecuteDateFunction(const std::string& query, tm& val);
+    //
+    int ExecuteModify(const std::string& query);
+    unsigned long GetInsertId();
+    bool UpdateStructure(const std::string& command);
+    std::string GetErrorDescription(RowSet* rs);
+    bool FindSchemaItem(ST stype, const char* name);
+    int ExecuteBulk(const std::string& query,
+                    const BulkParams& params,
+                    std::vector<int>* affected = 0);
+    bool ExecuteInsert(const std::string& insert, const char* keys, std::vector<long long>& ids);
+    int ExecuteBulkInsert(const std::string& insert,
+                          const BulkParams& params,
+                          const char* keys,
+                          std::vector<long long>& ids);
+    bool SetStatementTimeout(unsigned int ms);
+
+    // Unique interface
+    void SetBalance(BALANCE balance_in) { balance = balance_in; }
+    /*! \param max_lag_ms Replica that is more behind is skipped. Zero disables the check.
+        \param interval_ms How often the lag of each replica is checked.
+     */
+    void SetMaxLag(unsigned int max_lag_ms, unsigned int interval_ms = 1000);
+    //! Checks the lag of all replicas now. Returns the number of usable replicas.
+    size_t CheckReplicas();
+    Postgre* GetPrimary() { return &primary; }
+    size_t GetReplicaCount() { return replicas.size(); }
+    Postgre* GetReplica(size_t ndx) { return replicas[ndx].db; }
+    bool IsReplicaUsable(size_t ndx) { return replicas[ndx].usable; }
+    //! Returns the connection the next read would use.
+    Postgre* PickReader();
+
+  protected:
+    struct Replica
+    {
+        Postgre* db;
+        bool usable;
+        double latency_ms; //!< Moving average of the read time.
+        double lag_ms;     //!< Replication lag at the last check.
+        std::chrono::steady_clock::time_point checked;
+    };
+    bool checkLag(Replica& replica);
+    Replica* findReplica(Postgre* db);
+    void readDone(Postgre* db, std::chrono::steady_clock::time_point start, bool ok);
+    void copyError(Postgre* db) { SetLastError(db->GetLastError()); }
+
+    Postgre primary;
+    std::vector<Replica> replicas;
+    BALANCE balance;
+    size_t next;              //!< Next replica for the round robin.
+    unsigned int max_lag;     //!< Allowed replica lag in ms.
+    unsigned int lag_interval; //!< Lag check interval in ms.
+};
+
+// -------------------------------------------------------------------------------------------------
+//! Row set that runs its queries on the router's read connection.
+class PostgreRouterRowSet : public PostgreRowSet
+{
+    friend class PostgreRouter;
+
+  public:
+    bool Query();
+    long WriteJson(JsonWriter& out);
+
+  protected:
+    PostgreRouterRowSet(PostgreRouter* router_in);
+
+    PostgreRouter* router;
 };
 
 inline PGconn*
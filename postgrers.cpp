@@ -12,6 +12,9 @@
 #include <libpq-fe.h>
 #include <stdlib.h>
 #include <cstdarg>
+#include <climits>
+#include <cmath>
+#include <charconv>
 #include <cpp4scripts.hpp>
 
 #define __DDB_POSTGRE__
@@ -32,6 +35,7 @@ PostgreRowSet::PostgreRowSet(Database* db_in)
     max_rows = 0;
     result = 0;
     result_complete = true;
+    binary = false;
 
     db = (Postgre*)db_in;
 }
@@ -54,23 +58,33 @@ PostgreRowSet::Query()
         db->SetLastError("Query called without bound variables.");
         return false;
     }
-    if (query.tellp() < 1) {
+    if (query.IsEmpty()) {
         db->SetLastError("PostgreRowSet::Query - Empty query. Aborted.");
         return false;
     }
-    if (result_complete == false)
+    if (result_complete == false || cached)
         Reset();
+    failed = false;
 
-    result = PQexec(db->GetPGConn(), GetQueryBuffer(query));
+    binary = false;
+    for (BoundField* field = fieldRoot; field; field = field->next) {
+        if (field->type >= DT::BLOB)
+            binary = true;
+    }
+    result = db->ExecRead(query.GetText(), binary);
     if (!result || PQresultStatus(result) != PGRES_TUPLES_OK) {
         db->SetLastError("Query failed:");
-        db->AppendLastError(PQresultErrorMessage(result));
+        db->AppendResultError(result);
         Reset();
         return false;
     }
     result_complete = false;
     max_rows = PQntuples(result);
     row_count = 0;
+    if (binary && !checkBinary()) {
+        Reset();
+        return false;
+    }
     return true;
 }
 
@@ -78,10 +92,12 @@ PostgreRowSet::Query()
 int
 PostgreRowSet::GetNext()
 {
-    int maxFields, nField, count;
+    int maxFields, nField;
     BoundField* field;
     char* resultStr;
 
+    if (cached)
+        return GetNextCached();
     if (result_complete == true)
         return 0;
 
@@ -91,77 +107,77 @@ PostgreRowSet::GetNext()
         Reset();
         return 0;
     }
+    if (binary)
+        return getNextBinary();
     bool trim = db->IsFeatureOn(FEATURE_AUTOTRIM);
     maxFields = PQnfields(result);
     field = fieldRoot;
     nField = 0;
-    count = 0;
     while (field) {
+        // Empty string is a value. NULL is only known from PQgetisnull.
+        bool is_null = PQgetisnull(result, row_count, nField);
+        void* data = field->Target(is_null);
         resultStr = PQgetvalue(result, row_count, nField);
-        if (resultStr) {
+        if (data && resultStr) {
             switch (field->type) {
             case DT::INT:
-                if (resultStr[0] == '\0')
-                    *(static_cast<int*>(field->data)) = 0;
-                else {
-                    *(static_cast<int*>(field->data)) = strtol(resultStr, 0, 10);
-                    count++;
-                }
+                if (is_null)
+                    *(static_cast<int*>(data)) = 0;
+                else
+                    *(static_cast<int*>(data)) = strtol(resultStr, 0, 10);
                 break;
             case DT::LONG:
-                if (resultStr[0] == '\0')
-                    *(static_cast<long*>(field->data)) = 0;
-                else {
-                    *(static_cast<long*>(field->data)) = strtol(resultStr, 0, 10);
-                    count++;
-                }
+                if (is_null)
+                    *(static_cast<long*>(data)) = 0;
+                else
+                    *(static_cast<long*>(data)) = strtol(resultStr, 0, 10);
                 break;
             case DT::STR:
-                if (resultStr[0] == '\0')
-                    static_cast<string*>(field->data)->clear();
+                if (is_null)
+                    static_cast<string*>(data)->clear();
                 else {
-                    *(static_cast<std::string*>(field->data)) = resultStr;
+                    static_cast<string*>(data)->assign(
+                        resultStr, PQgetlength(result, row_count, nField));
                     if (trim)
-                        Database::TrimTail(static_cast<std::string*>(field->data));
-                    count++;
+                        Database::TrimTail(static_cast<std::string*>(data));
                 }
                 break;
             case DT::BOOL:
-                if (resultStr[0] == '\0')
-                    *(static_cast<bool*>(field->data)) = 0;
-                else {
-                    *(static_cast<bool*>(field->data)) = resultStr[0] == 't' ? true : false;
-                    count++;
-                }
+                if (is_null)
+                    *(static_cast<bool*>(data)) = 0;
+                else
+                    *(static_cast<bool*>(data)) = resultStr[0] == 't' ? true : false;
                 break;
 
             case DT::TIME:
             case DT::DAY:
-                if (resultStr[0] == '\0')
-                    memset(field->data, 0, sizeof(tm));
-                else {
-                    Postgre::ExtractTimestamp(resultStr, (tm*)field->data);
-                    count++;
-                }
+                if (is_null)
+                    memset(data, 0, sizeof(tm));
+                else
+                    Postgre::ExtractTimestamp(resultStr, (tm*)data);
                 break;
 
             case DT::NUM:
-                if (resultStr[0] == '\0')
-                    *(static_cast<double*>(field->data)) = 0;
+                if (is_null)
+                    *(static_cast<double*>(data)) = 0;
                 else {
                     if (db->IsCommaDecimal()) {
                         char* commaPoint = strchr(resultStr, '.');
                         if (commaPoint)
                             *commaPoint = ',';
                     }
-                    *(static_cast<double*>(field->data)) = strtod(resultStr, 0);
-                    count++;
+                    *(static_cast<double*>(data)) = strtod(resultStr, 0);
                 }
                 break;
             case DT::CHR:
             case DT::BIT:
-                *(static_cast<char*>(field->data)) = resultStr[0];
-                count++;
+                *(static_cast<char*>(data)) = resultStr[0];
+                break;
+            case DT::BLOB: // Read with getNextBinary.
+            case DT::DEC:
+            case DT::VEC_LONG:
+            case DT::VEC_NUM:
+            case DT::VEC_STR:
                 break;
             }
         }
@@ -176,13 +192,631 @@ PostgreRowSet::GetNext()
         PQclear(result);
         result_complete = true;
     }
-    return count;
+    // NULL is a value too, i.e. each field of the row is included.
+    return nField;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Binary result format. Values are in network byte order. Type OIDs are from pg_type.h which is
+// not part of the client headers.
+
+const Oid BOOLOID = 16;
+const Oid INT8OID = 20;
+const Oid INT2OID = 21;
+const Oid INT4OID = 23;
+const Oid FLOAT4OID = 700;
+const Oid FLOAT8OID = 701;
+const Oid DATEOID = 1082;
+const Oid TIMESTAMPOID = 1114;
+const Oid TIMESTAMPTZOID = 1184;
+const Oid NUMERICOID = 1700;
+const Oid OIDOID = 26;
+const Oid BYTEAOID = 17;
+const Oid CHAROID = 18;
+const Oid NAMEOID = 19;
+const Oid TEXTOID = 25;
+const Oid BPCHAROID = 1042;
+const Oid VARCHAROID = 1043;
+const Oid JSONOID = 114;
+const Oid JSONBOID = 3802;
+const Oid INT2ARRAYOID = 1005;
+const Oid INT4ARRAYOID = 1007;
+const Oid INT8ARRAYOID = 1016;
+const Oid FLOAT4ARRAYOID = 1021;
+const Oid FLOAT8ARRAYOID = 1022;
+const Oid NUMERICARRAYOID = 1231;
+const Oid TEXTARRAYOID = 1009;
+const Oid BPCHARARRAYOID = 1014;
+const Oid VARCHARARRAYOID = 1015;
+
+// Seconds from 1970-01-01 to the PostgreSQL epoch 2000-01-01.
+const long long PG_EPOCH = 946684800;
+
+static uint64_t
+readBE(const char* value, int bytes)
+{
+    uint64_t result = 0;
+    for (int ndx = 0; ndx < bytes; ndx++)
+        result = result << 8 | (unsigned char)value[ndx];
+    return result;
+}
+
+// numeric is a base 10000 number: ndigits, weight, sign, dscale and the digits.
+static void
+numericText(const char* value, string& text)
+{
+    int ndigits = (int16_t)readBE(value, 2);
+    int weight = (int16_t)readBE(value + 2, 2);
+    int sign = readBE(value + 4, 2);
+    int dscale = (int16_t)readBE(value + 6, 2);
+    const char* digits = value + 8;
+    text.clear();
+    if (sign == 0xC000) {
+        text = "NaN";
+        return;
+    }
+    if (sign == 0x4000)
+        text += '-';
+    char buffer[8];
+    if (weight < 0)
+        text += '0';
+    for (int ndx = 0; ndx <= weight; ndx++) {
+        int digit = ndx < ndigits ? (int)readBE(digits + 2 * ndx, 2) : 0;
+        snprintf(buffer, sizeof(buffer), ndx ? "%04d" : "%d", digit);
+        text += buffer;
+    }
+    if (dscale <= 0)
+        return;
+    text += '.';
+    size_t point = text.size();
+    for (int ndx = weight + 1; (int)(text.size() - point) < dscale; ndx++) {
+        int digit = ndx >= 0 && ndx < ndigits ? (int)readBE(digits + 2 * ndx, 2) : 0;
+        snprintf(buffer, sizeof(buffer), "%04d", digit);
+        text += buffer;
+    }
+    text.resize(point + dscale);
+}
+
+// Decimal digits are collected straight into the units so that the value never goes through
+// double. Decimals beyond Decimal::MAX_SCALE are rounded.
+static bool
+numericDecimal(const char* value, Decimal& dec)
+{
+    int ndigits = (int16_t)readBE(value, 2);
+    int weight = (int16_t)readBE(value + 2, 2);
+    int sign = readBE(value + 4, 2);
+    int dscale = (int16_t)readBE(value + 6, 2);
+    const char* digits = value + 8;
+    if (sign != 0 && sign != 0x4000)
+        return false; // NaN or infinity
+    const unsigned long long limit = LLONG_MAX;
+    unsigned long long magnitude = 0;
+    for (int ndx = 0; ndx <= weight; ndx++) {
+        unsigned int digit = ndx < ndigits ? (unsigned int)readBE(digits + 2 * ndx, 2) : 0;
+        if (magnitude > (limit - digit) / 10000)
+            return false;
+        magnitude = magnitude * 10000 + digit;
+    }
+    int scale = dscale < Decimal::MAX_SCALE ? dscale : Decimal::MAX_SCALE;
+    int decimals = 0;
+    bool round_up = false;
+    for (int ndx = weight + 1; decimals < dscale && decimals <= scale; ndx++) {
+        unsigned int group = ndx >= 0 && ndx < ndigits ? (unsigned int)readBE(digits + 2 * ndx, 2)
+                                                       : 0;
+        for (unsigned int div = 1000; div && decimals < dscale && decimals <= scale; div /= 10) {
+            unsigned int digit = group / div % 10;
+            if (decimals++ == scale) {
+                round_up = digit >= 5;
+                break;
+            }
+            if (magnitude > (limit - digit) / 10)
+                return false;
+            magnitude = magnitude * 10 + digit;
+        }
+    }
+    if (round_up && ++magnitude > limit)
+        return false;
+    dec.units = sign ? -(long long)magnitude : (long long)magnitude;
+    dec.scale = scale;
+    return true;
+}
+
+static double
+binaryDouble(Oid oid, const char* value)
+{
+    switch (oid) {
+    case FLOAT4OID: {
+        uint32_t bits = readBE(value, 4);
+        float result;
+        memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+    case FLOAT8OID: {
+        uint64_t bits = readBE(value, 8);
+        double result;
+        memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+    case NUMERICOID: {
+        string text;
+        numericText(value, text);
+        return strtod(text.c_str(), 0);
+    }
+    case INT2OID:
+        return (int16_t)readBE(value, 2);
+    case INT4OID:
+        return (int32_t)readBE(value, 4);
+    case INT8OID:
+        return (int64_t)readBE(value, 8);
+    case OIDOID:
+        return (uint32_t)readBE(value, 4);
+    case BOOLOID:
+        return value[0];
+    }
+    return 0; // Rejected by checkBinary.
+}
+
+// Same text as the server's float output: the shortest text that reads back to the same value.
+static void
+floatText(Oid oid, const char* value, string& text)
+{
+    double number = binaryDouble(oid, value);
+    if (isnan(number)) {
+        text = "NaN";
+        return;
+    }
+    if (isinf(number)) {
+        text = number < 0 ? "-Infinity" : "Infinity";
+        return;
+    }
+    char buffer[32];
+    char* end = oid == FLOAT4OID
+                    ? to_chars(buffer, buffer + sizeof(buffer), (float)number).ptr
+                    : to_chars(buffer, buffer + sizeof(buffer), number).ptr;
+    text.assign(buffer, end - buffer);
+}
+
+// Numeric and float values are converted through their text as in the text format, e.g. 12.7
+// is 12.
+static long
+binaryLong(Oid oid, const char* value)
+{
+    switch (oid) {
+    case INT2OID:
+        return (int16_t)readBE(value, 2);
+    case INT4OID:
+        return (int32_t)readBE(value, 4);
+    case INT8OID:
+        return (int64_t)readBE(value, 8);
+    case OIDOID:
+        return (uint32_t)readBE(value, 4);
+    case BOOLOID:
+        return value[0];
+    case NUMERICOID:
+    case FLOAT4OID:
+    case FLOAT8OID: {
+        string text;
+        if (oid == NUMERICOID)
+            numericText(value, text);
+        else
+            floatText(oid, value, text);
+        return strtol(text.c_str(), 0, 10);
+    }
+    }
+    return 0; // Rejected by checkBinary.
+}
+
+static bool
+binaryDecimal(Oid oid, const char* value, int length, Decimal& dec)
+{
+    switch (oid) {
+    case NUMERICOID:
+        return numericDecimal(value, dec);
+    case INT2OID:
+    case INT4OID:
+    case INT8OID:
+        dec = Decimal(binaryLong(oid, value), 0);
+        return true;
+    case FLOAT4OID:
+    case FLOAT8OID: {
+        // 0.1 and not 0.1000000000000000055
+        string text;
+        floatText(oid, value, text);
+        return dec.Parse(text.c_str(), text.size());
+    }
+    }
+    // Text types.
+    return dec.Parse(value, length);
+}
+
+// Array: ndim, has null flag, element type, (size, lower bound) for each dimension and the
+// elements as length + value. Length -1 is NULL. Dimensions are flattened.
+static bool
+isArrayOid(Oid oid)
+{
+    switch (oid) {
+    case INT2ARRAYOID:
+    case INT4ARRAYOID:
+    case INT8ARRAYOID:
+    case FLOAT4ARRAYOID:
+    case FLOAT8ARRAYOID:
+    case NUMERICARRAYOID:
+    case TEXTARRAYOID:
+    case BPCHARARRAYOID:
+    case VARCHARARRAYOID:
+        return true;
+    }
+    return false;
+}
+
+static void
+binaryArray(const char* value, DT type, void* values)
+{
+    int ndim = (int32_t)readBE(value, 4);
+    Oid elem = readBE(value + 8, 4);
+    const char* ptr = value + 12;
+    size_t count = ndim ? 1 : 0;
+    for (int dim = 0; dim < ndim; dim++, ptr += 8)
+        count *= (int32_t)readBE(ptr, 4);
+    bool number = elem == INT2OID || elem == INT4OID || elem == INT8OID || elem == FLOAT4OID ||
+                  elem == FLOAT8OID || elem == NUMERICOID;
+    vector<long>* longs = (vector<long>*)values;
+    vector<double>* nums = (vector<double>*)values;
+    vector<string>* strs = (vector<string>*)values;
+    ClearValue(type, values);
+    // Elements are converted as single values, e.g. numeric and float elements go to VEC_LONG
+    // through their text as with ParseArray.
+    for (size_t ndx = 0; ndx < count; ndx++) {
+        int len = (int32_t)readBE(ptr, 4);
+        const char* item = ptr + 4;
+        ptr = item + (len > 0 ? len : 0);
+        if (type == DT::VEC_LONG) {
+            if (len < 0)
+                longs->push_back(0);
+            else
+                longs->push_back(number ? binaryLong(elem, item) : atol(string(item, len).c_str()));
+        } else if (type == DT::VEC_NUM) {
+            if (len < 0)
+                nums->push_back(0);
+            else
+                nums->push_back(number ? binaryDouble(elem, item)
+                                       : atof(string(item, len).c_str()));
+        } else {
+            strs->emplace_back();
+            if (len < 0)
+                continue;
+            string& text = strs->back();
+            if (elem == NUMERICOID)
+                numericText(item, text);
+            else if (elem == FLOAT4OID || elem == FLOAT8OID)
+                floatText(elem, item, text);
+            else if (number)
+                text = to_string(binaryLong(elem, item));
+            else
+                text.assign(item, len);
+        }
+    }
+}
+
+// Infinity and -infinity are the largest and smallest values of the type.
+static bool
+binaryInfinite(Oid oid, const char* value, bool& negative)
+{
+    if (oid == DATEOID) {
+        int32_t days = readBE(value, 4);
+        negative = days == INT32_MIN;
+        return days == INT32_MAX || days == INT32_MIN;
+    }
+    int64_t usec = readBE(value, 8);
+    negative = usec == INT64_MIN;
+    return usec == INT64_MAX || usec == INT64_MIN;
+}
+
+// Timestamptz is taken as UTC. checkBinary accepts it only when the session time zone is UTC so
+// the result is the same as the session time of the text format.
+static void
+binaryTime(Oid oid, const char* value, tm* result)
+{
+    memset(result, 0, sizeof(tm));
+    bool negative;
+    if (binaryInfinite(oid, value, negative))
+        return;
+    time_t seconds;
+    if (oid == DATEOID)
+        seconds = PG_EPOCH + (int32_t)readBE(value, 4) * 86400LL;
+    else {
+        // Microseconds. Floor so that times before 2000 get the right second.
+        long long usec = (int64_t)readBE(value, 8);
+        long long sec = usec / 1000000;
+        if (usec % 1000000 < 0)
+            sec--;
+        seconds = PG_EPOCH + sec;
+    }
+    gmtime_r(&seconds, result);
+    result->tm_wday = 0;
+    result->tm_yday = 0;
+    result->tm_isdst = -1;
+}
+
+// ISO text as with the default DateStyle, e.g. 2024-05-01 12:30:00.25+00.
+static void
+timeText(Oid oid, const char* value, string& text)
+{
+    bool negative;
+    if (binaryInfinite(oid, value, negative)) {
+        text = negative ? "-infinity" : "infinity";
+        return;
+    }
+    tm stamp;
+    char buffer[40];
+    binaryTime(oid, value, &stamp);
+    size_t len = strftime(buffer, sizeof(buffer),
+                          oid == DATEOID ? "%Y-%m-%d" : "%Y-%m-%d %H:%M:%S", &stamp);
+    if (oid != DATEOID) {
+        long long usec = (int64_t)readBE(value, 8) % 1000000;
+        if (usec < 0)
+            usec += 1000000;
+        if (usec) {
+            len += snprintf(buffer + len, sizeof(buffer) - len, ".%06lld", usec);
+            while (buffer[len - 1] == '0')
+                len--;
+        }
+        if (oid == TIMESTAMPTZOID) {
+            memcpy(buffer + len, "+00", 3);
+            len += 3;
+        }
+    }
+    text.assign(buffer, len);
+}
+
+// Hex format of the text output, e.g. \x0aff.
+static void
+byteaText(const char* value, int length, string& text)
+{
+    static const char hex[] = "0123456789abcdef";
+    text.resize(2 + 2 * (size_t)length);
+    text[0] = '\\';
+    text[1] = 'x';
+    for (int ndx = 0; ndx < length; ndx++) {
+        text[2 + 2 * ndx] = hex[(unsigned char)value[ndx] >> 4];
+        text[3 + 2 * ndx] = hex[value[ndx] & 0xF];
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+static bool
+isTextOid(Oid oid)
+{
+    return oid == TEXTOID || oid == VARCHAROID || oid == BPCHAROID || oid == NAMEOID;
+}
+
+// Types that getNextBinary can convert to the bound type.
+static bool
+binaryAccepts(DT type, Oid oid)
+{
+    bool integer = oid == INT2OID || oid == INT4OID || oid == INT8OID;
+    bool number = integer || oid == FLOAT4OID || oid == FLOAT8OID || oid == NUMERICOID;
+    switch (type) {
+    case DT::INT:
+    case DT::LONG:
+    case DT::NUM:
+        return number || oid == OIDOID || oid == BOOLOID;
+    case DT::BOOL:
+        return integer || oid == BOOLOID;
+    case DT::TIME:
+    case DT::DAY:
+        return oid == DATEOID || oid == TIMESTAMPOID || oid == TIMESTAMPTZOID;
+    case DT::CHR:
+    case DT::BIT:
+        return oid == BOOLOID || oid == CHAROID || isTextOid(oid);
+    case DT::BLOB:
+        return true;
+    case DT::DEC:
+        return number || isTextOid(oid);
+    case DT::VEC_LONG:
+    case DT::VEC_NUM:
+    case DT::VEC_STR:
+        return isArrayOid(oid) || isTextOid(oid);
+    case DT::STR:
+        return number || isArrayOid(oid) || isTextOid(oid) || oid == OIDOID || oid == BOOLOID
+               || oid == CHAROID || oid == DATEOID || oid == TIMESTAMPOID
+               || oid == TIMESTAMPTZOID || oid == JSONOID || oid == JSONBOID || oid == BYTEAOID;
+    }
+    return false;
+}
+
+static bool
+isUtc(const char* zone)
+{
+    static const char* names[] = { "UTC", "Etc/UTC", "UCT", "Etc/UCT", "GMT", "Etc/GMT",
+                                   "Zulu", "Etc/Zulu", "Universal", "Etc/Universal", 0 };
+    for (int ndx = 0; zone && names[ndx]; ndx++) {
+        if (!strcasecmp(zone, names[ndx]))
+            return true;
+    }
+    return false;
+}
+
+bool
+PostgreRowSet::checkBinary()
+/*!
+  Each bound type accepts only the column types it can be converted from, so that the values are
+  the same as with the text format. Others, e.g. uuid or interval into DT::STR or time into
+  DT::TIME, would end up as raw wire bytes and the query is refused instead.
+*/
+{
+    int maxFields = PQnfields(result);
+    int nField = 0;
+    const char* zone = PQparameterStatus(db->GetPGConn(), "TimeZone");
+    for (BoundField* field = fieldRoot; field && nField < maxFields;
+         field = field->next, nField++) {
+        Oid oid = PQftype(result, nField);
+        const char* error = 0;
+        if (!binaryAccepts(field->type, oid))
+            error = " cannot be converted to the bound type";
+        else if (oid == TIMESTAMPTZOID && field->type != DT::BLOB && !isUtc(zone))
+            error = " is timestamptz and the session TimeZone is not UTC";
+        if (error) {
+            db->SetLastError("Query - column ");
+            db->AppendLastError(PQfname(result, nField));
+            db->AppendLastError(error);
+            db->AppendLastError(" when DT::BLOB, DEC or VEC_ fields are bound. Cast it to ::text "
+                                "or to the bound type in the query.");
+            return false;
+        }
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+int
+PostgreRowSet::getNextBinary()
+/*!
+  Blobs point into the result so it is released on the call after the last row.
+*/
+{
+    if (row_count == max_rows) {
+        PQclear(result);
+        result_complete = true;
+        return 0;
+    }
+    bool trim = db->IsFeatureOn(FEATURE_AUTOTRIM);
+    int maxFields = PQnfields(result);
+    int nField = 0;
+    for (BoundField* field = fieldRoot; field && nField < maxFields;
+         field = field->next, nField++) {
+        bool is_null = PQgetisnull(result, row_count, nField);
+        void* data = field->Target(is_null);
+        if (!data)
+            continue;
+        if (is_null) {
+            ClearValue(field->type, data);
+            continue;
+        }
+        const char* value = PQgetvalue(result, row_count, nField);
+        int length = PQgetlength(result, row_count, nField);
+        Oid oid = PQftype(result, nField);
+        switch (field->type) {
+        case DT::INT:
+            *(static_cast<int*>(data)) = binaryLong(oid, value);
+            break;
+        case DT::LONG:
+            *(static_cast<long*>(data)) = binaryLong(oid, value);
+            break;
+        case DT::NUM:
+            *(static_cast<double*>(data)) = binaryDouble(oid, value);
+            break;
+        case DT::BOOL:
+            *(static_cast<bool*>(data)) =
+                oid == BOOLOID ? value[0] != 0 : binaryLong(oid, value) != 0;
+            break;
+        case DT::TIME:
+        case DT::DAY:
+            binaryTime(oid, value, (tm*)data);
+            break;
+        case DT::CHR:
+        case DT::BIT:
+            *(static_cast<char*>(data)) = oid == BOOLOID ? (value[0] ? 't' : 'f') : value[0];
+            break;
+        case DT::BLOB:
+            *(static_cast<Blob*>(data)) = Blob(value, length);
+            break;
+        case DT::DEC:
+            if (!binaryDecimal(oid, value, length, *static_cast<Decimal*>(data))) {
+                // NaN, Infinity and values that do not fit end the read.
+                db->SetLastError("GetNext - value does not fit into Decimal. Field ");
+                db->AppendLastError(to_string(nField + 1).c_str());
+                failed = true;
+                Reset();
+                return 0;
+            }
+            break;
+        case DT::VEC_LONG:
+        case DT::VEC_NUM:
+        case DT::VEC_STR:
+            if (isArrayOid(oid))
+                binaryArray(value, field->type, data);
+            else
+                ParseArray(field->type, value, data);
+            break;
+        case DT::STR: {
+            string* str = static_cast<string*>(data);
+            switch (oid) {
+            case INT2OID:
+            case INT4OID:
+            case INT8OID:
+            case OIDOID:
+                *str = to_string(binaryLong(oid, value));
+                break;
+            case FLOAT4OID:
+            case FLOAT8OID:
+                floatText(oid, value, *str);
+                break;
+            case NUMERICOID:
+                numericText(value, *str);
+                break;
+            case BOOLOID:
+                *str = value[0] ? "t" : "f";
+                break;
+            case INT2ARRAYOID:
+            case INT4ARRAYOID:
+            case INT8ARRAYOID:
+            case FLOAT4ARRAYOID:
+            case FLOAT8ARRAYOID:
+            case NUMERICARRAYOID:
+            case TEXTARRAYOID:
+            case BPCHARARRAYOID:
+            case VARCHARARRAYOID: {
+                vector<string> elements;
+                binaryArray(value, DT::VEC_STR, &elements);
+                str->clear();
+                FormatArray(DT::VEC_STR, &elements, false, *str);
+                break;
+            }
+            case DATEOID:
+            case TIMESTAMPOID:
+            case TIMESTAMPTZOID:
+                timeText(oid, value, *str);
+                break;
+            case BYTEAOID:
+                byteaText(value, length, *str);
+                break;
+            case JSONBOID:
+                // Version byte is in front of the JSON text.
+                if (length > 0 && value[0] == 1) {
+                    value++;
+                    length--;
+                }
+                str->assign(value, length);
+                break;
+            case TEXTOID:
+            case VARCHAROID:
+            case BPCHAROID:
+            case NAMEOID:
+            case CHAROID:
+            case JSONOID:
+                // Sent as they are.
+                str->assign(value, length);
+                if (trim)
+                    Database::TrimTail(str);
+                break;
+            default:
+                // Rejected by checkBinary.
+                str->clear();
+            }
+            break;
+        }
+        }
+    }
+    row_count++;
+    return nField;
 }
 
 // -------------------------------------------------------------------------------------------------
 void
 PostgreRowSet::Reset()
 {
+    cached.reset();
     if (result_complete)
         return;
     PQclear(result);
@@ -191,4 +825,104 @@ PostgreRowSet::Reset()
     result_complete = true;
 }
 
+// -------------------------------------------------------------------------------------------------
+static void
+jsonValue(JsonWriter& out, Oid oid, const char* value, int length)
+{
+    switch (oid) {
+    case INT2OID:
+    case INT4OID:
+    case INT8OID:
+    case OIDOID:
+        out.Number(value, length);
+        break;
+    case FLOAT4OID:
+    case FLOAT8OID:
+    case NUMERICOID:
+        // NaN, Infinity and -Infinity have no JSON number.
+        if (value[0] == 'N' || value[0] == 'I' || (value[0] == '-' && value[1] == 'I'))
+            out.Null();
+        else
+            out.Number(value, length);
+        break;
+    case BOOLOID:
+        out.Bool(value[0] == 't');
+        break;
+    case JSONOID:
+    case JSONBOID:
+        out.Raw(value, length);
+        break;
+    default:
+        // Text types and the text forms of the other types, e.g. bytea as \x0102.
+        out.String(value, length);
+    }
+}
+
+long
+PostgreRowSet::WriteJson(JsonWriter& out)
+/*!
+  Uses the single row mode so each row is written as soon as it arrives from the server.
+  Numbers, booleans and json columns keep their type. Other values are written as strings in
+  the PostgreSQL text format.
+*/
+{
+    if (query.IsEmpty()) {
+        db->SetLastError("PostgreRowSet::WriteJson - Empty query. Aborted.");
+        return -1;
+    }
+    if (result_complete == false || cached)
+        Reset();
+    if (!db->checkConnection())
+        return -1;
+    PGconn* conn = db->GetPGConn();
+    if (!PQsendQuery(conn, query.GetText())) {
+        db->SetLastError("WriteJson failed:");
+        db->AppendResultError(0);
+        return -1;
+    }
+    PQsetSingleRowMode(conn);
+
+    out.BeginResult();
+    vector<Oid> types;
+    bool ok = true, failed = false;
+    row_count = 0;
+    // Results are read to the end even after an error to leave the connection usable.
+    while (PGresult* res = PQgetResult(conn)) {
+        ExecStatusType status = PQresultStatus(res);
+        if (status == PGRES_SINGLE_TUPLE && ok && !failed) {
+            int columns = PQnfields(res);
+            if (types.empty()) {
+                for (int col = 0; col < columns; col++) {
+                    out.AddColumn(PQfname(res, col));
+                    types.push_back(PQftype(res, col));
+                }
+            }
+            out.BeginRow();
+            for (int col = 0; col < columns; col++) {
+                if (PQgetisnull(res, 0, col))
+                    out.Null();
+                else
+                    jsonValue(out, types[col], PQgetvalue(res, 0, col), PQgetlength(res, 0, col));
+            }
+            row_count++;
+            if (!out.EndRow()) {
+                ok = false;
+                db->Cancel();
+            }
+        } else if (status != PGRES_SINGLE_TUPLE && status != PGRES_TUPLES_OK && ok && !failed) {
+            failed = true;
+            db->SetLastError("WriteJson failed:");
+            db->AppendResultError(res);
+        }
+        PQclear(res);
+    }
+    if (failed)
+        return -1;
+    if (!ok || !out.EndResult()) {
+        db->SetLastError("WriteJson - output was refused.");
+        return -1;
+    }
+    return row_count;
+}
+
 }; // namespace ddb
@@ -0,0 +1,131 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <string.h>
+#include <charconv>
+
+#include "directdb.hpp"
+
+namespace ddb {
+
+// -------------------------------------------------------------------------------------------------
+QueryBuffer::QueryBuffer()
+/*!
+  Reserves room for a typical short statement.
+*/
+{
+    capacity = 0x100;
+    buffer = new char[capacity];
+    Clear();
+}
+// -------------------------------------------------------------------------------------------------
+void
+QueryBuffer::grow(size_t size)
+/*!
+  Reallocates the buffer so that 'size' more bytes and the terminating zero fit in.
+  Capacity is at least doubled to keep the appends amortized constant time.
+*/
+{
+    size_t newcap = capacity * 2;
+    if (newcap < length + size + 1)
+        newcap = length + size + 1;
+    char* newbuf = new char[newcap];
+    memcpy(newbuf, buffer, length + 1);
+    delete[] buffer;
+    buffer = newbuf;
+    capacity = newcap;
+}
+// -------------------------------------------------------------------------------------------------
+QueryBuffer&
+QueryBuffer::Append(const char* text, size_t len)
+{
+    Reserve(len);
+    memcpy(buffer + length, text, len);
+    length += len;
+    buffer[length] = 0;
+    return *this;
+}
+QueryBuffer&
+QueryBuffer::Append(const char* text)
+{
+    return Append(text, strlen(text));
+}
+QueryBuffer&
+QueryBuffer::Append(char ch)
+{
+    Reserve(1);
+    buffer[length++] = ch;
+    buffer[length] = 0;
+    return *this;
+}
+// -------------------------------------------------------------------------------------------------
+// 20 digits and a sign is enough for any 64 bit integer. Doubles need at most 24 characters in
+// the shortest round-trip form.
+QueryBuffer&
+QueryBuffer::Append(long long number)
+{
+    Reserve(24);
+    length = std::to_chars(buffer + length, buffer + capacity - 1, number).ptr - buffer;
+    buffer[length] = 0;
+    return *this;
+}
+QueryBuffer&
+QueryBuffer::Append(unsigned long long number)
+{
+    Reserve(24);
+    length = std::to_chars(buffer + length, buffer + capacity - 1, number).ptr - buffer;
+    buffer[length] = 0;
+    return *this;
+}
+QueryBuffer&
+QueryBuffer::Append(double number)
+{
+    Reserve(32);
+    length = std::to_chars(buffer + length, buffer + capacity - 1, number).ptr - buffer;
+    buffer[length] = 0;
+    return *this;
+}
+QueryBuffer&
+QueryBuffer::Append(const Decimal& number)
+{
+    Reserve(Decimal::MAX_TEXT);
+    length = number.Format(buffer + length) - buffer;
+    return *this;
+}
+// -------------------------------------------------------------------------------------------------
+QueryBuffer&
+QueryBuffer::AppendStr(const char* text, size_t len)
+{
+    Reserve(Database::CleanLength(text, len) + 2);
+    buffer[length++] = '\'';
+    length += Database::CleanCopy(buffer + length, text, len);
+    buffer[length++] = '\'';
+    buffer[length] = 0;
+    return *this;
+}
+// -------------------------------------------------------------------------------------------------
+QueryBuffer&
+QueryBuffer::AppendIdent(const char* name, size_t len)
+/*!
+  Identifier is enclosed in double quotes and the quotes inside the name are doubled.
+  Please note that quoted identifiers are case sensitive in PostgreSQL.
+*/
+{
+    Reserve(len * 2 + 2);
+    buffer[length++] = '"';
+    for (const char* end = name + len; name < end; name++) {
+        if (*name == '"')
+            buffer[length++] = '"';
+        buffer[length++] = *name;
+    }
+    buffer[length++] = '"';
+    buffer[length] = 0;
+    return *this;
+}
+
+}; // namespace ddb
@@ -16,9 +16,6 @@
 
 namespace ddb {
 
-size_t RowSet::query_max;
-char*  RowSet::query_buffer;
-
 // -------------------------------------------------------------------------------------------------
 BoundField::BoundField(DT type_in, void* data_in)
   : type(type_in)
@@ -31,6 +28,8 @@ BoundField::BoundField(DT type_in, void* data_in)
   \param data_in Pointer to client data.
 */
 {
+    null_ind = 0;
+    optional = 0;
     next = 0;
 }
 
@@ -51,6 +50,8 @@ RowSet::RowSet()
     fieldRoot = 0;
     field_count = 0;
     row_count = 0;
+    cached_pos = 0;
+    failed = false;
 }
 // -------------------------------------------------------------------------------------------------
 RowSet::~RowSet()
@@ -69,27 +70,6 @@ RowSet::~RowSet()
     fieldRoot = 0;
 }
 // -------------------------------------------------------------------------------------------------
-void // static function
-RowSet::InitQueryBuffer() 
-{
-    query_max = 0x400;
-    query_buffer = new char[query_max];
-}
-// -------------------------------------------------------------------------------------------------
-char* // static function
-RowSet::GetQueryBuffer(std::iostream& sql)
-{
-    size_t len = sql.tellp();
-    if (len > query_max-1) {
-        delete[] query_buffer;
-        query_max = len + 100;
-        query_buffer = new char[query_max];
-    }
-    sql.read(query_buffer, len);
-    query_buffer[len] = 0;
-    return query_buffer;
-}
-// -------------------------------------------------------------------------------------------------
 bool
 RowSet::ValidateBind(DT type, void* data)
 /*!
@@ -101,7 +81,7 @@ RowSet::ValidateBind(DT type, void* data)
     if (!data)
         return false;
     int tval = (int)type;
-    if (tval < 0 || tval > (int)DT::CHR)
+    if (tval < 0 || tval > (int)DT::DEC)
         return false;
     return true;
 }
@@ -129,6 +109,27 @@ RowSet::Bind(DT type, void* data)
     return InsertField(new BoundField(type, data));
 }
 
+// -------------------------------------------------------------------------------------------------
+bool
+RowSet::Bind(DT type, void* data, bool* is_null)
+{
+    if (!ValidateBind(type, data))
+        return false;
+    BoundField* field = new BoundField(type, data);
+    field->null_ind = is_null;
+    return InsertField(field);
+}
+bool
+RowSet::Bind(const BoundField& source)
+{
+    if (!ValidateBind(source.type, source.data))
+        return false;
+    BoundField* field = new BoundField(source.type, source.data);
+    field->null_ind = source.null_ind;
+    field->optional = source.optional;
+    return InsertField(field);
+}
+
 // -------------------------------------------------------------------------------------------------
 bool
 RowSet::InsertField(BoundField* newField)
@@ -165,4 +166,11 @@ RowSet::InsertField(BoundField* newField)
     return false;
 }
 
+// -------------------------------------------------------------------------------------------------
+long
+RowSet::WriteJson(JsonWriter&)
+{
+    return -1;
+}
+
 }; // namespace ddb
@@ -0,0 +1,559 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <thread>
+
+#include "directdb.hpp"
+
+using namespace std;
+
+namespace ddb {
+
+// Rows in a chunk and the chunks a shard may have waiting for the reader before its thread
+// blocks. Same as PartitionedRowSet's defaults.
+const size_t SHARD_CHUNK_ROWS = 256;
+const size_t SHARD_MAX_CHUNKS = 4;
+
+// -------------------------------------------------------------------------------------------------
+// FNV-1a. Key placement must not change between runs or builds so std::hash is not used.
+static uint64_t
+shardHash(const char* key, size_t len)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t ndx = 0; ndx < len; ndx++) {
+        hash ^= (unsigned char)key[ndx];
+        hash *= 0x100000001b3ULL;
+    }
+    // Final mix spreads the nearby keys (e.g. "1", "2") around the ring.
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// -------------------------------------------------------------------------------------------------
+ShardedDatabase::ShardedDatabase(unsigned int vnodes_in)
+{
+    vnodes = vnodes_in ? vnodes_in : 1;
+    active = 0;
+    feat_support |= FEATURE_TRANSACTIONS;
+    feat_on |= FEATURE_TRANSACTIONS;
+    flags |= FLAG_INITIALIZED;
+}
+ShardedDatabase::~ShardedDatabase()
+{
+    for (Shard& shard : shards)
+        delete shard.db;
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+ShardedDatabase::AddShard(const string& name, Database* db)
+{
+    size_t ndx = shards.size();
+    shards.push_back(Shard{ name, db });
+    for (unsigned int vn = 0; vn < vnodes; vn++) {
+        string point = name + '#' + to_string(vn);
+        ring.push_back(make_pair(shardHash(point.data(), point.size()), ndx));
+    }
+    sort(ring.begin(), ring.end());
+    if (db->IsConnected())
+        flags |= FLAG_CONNECTED;
+}
+Database*
+ShardedDatabase::Route(const string& key)
+{
+    if (ring.empty())
+        return 0;
+    auto it = lower_bound(ring.begin(), ring.end(),
+                          make_pair(shardHash(key.data(), key.size()), (size_t)0));
+    if (it == ring.end())
+        it = ring.begin();
+    return shards[it->second].db;
+}
+Database*
+ShardedDatabase::current()
+{
+    if (!active)
+        SetLastError("ShardedDatabase: shard key has not been set.");
+    return active;
+}
+
+// -------------------------------------------------------------------------------------------------
+RDBM
+ShardedDatabase::GetType()
+{
+    return shards.empty() ? RDBM::POSTGRES : shards[0].db->GetType();
+}
+bool
+ShardedDatabase::Connect(const char*)
+{
+    SetLastError("ShardedDatabase: add connected databases with AddShard.");
+    return false;
+}
+bool
+ShardedDatabase::Disconnect()
+{
+    for (Shard& shard : shards)
+        shard.db->Disconnect();
+    flags &= ~FLAG_CONNECTED;
+    return true;
+}
+bool
+ShardedDatabase::IsConnectOK()
+{
+    for (Shard& shard : shards) {
+        if (!shard.db->IsConnectOK())
+            return false;
+    }
+    return !shards.empty();
+}
+bool
+ShardedDatabase::ResetConnection()
+{
+    bool rv = true;
+    for (Shard& shard : shards) {
+        if (!shard.db->ResetConnection()) {
+            copyError(shard.db);
+            rv = false;
+        }
+    }
+    return rv;
+}
+bool
+ShardedDatabase::SetStatementTimeout(unsigned int ms)
+{
+    stmt_timeout = ms;
+    for (Shard& shard : shards)
+        shard.db->SetStatementTimeout(ms);
+    return true;
+}
+bool
+ShardedDatabase::Cancel()
+/*!
+  Cancels the running statements on all shards. Can be called from another thread.
+*/
+{
+    bool rv = true;
+    for (Shard& shard : shards) {
+        if (!shard.db->Cancel())
+            rv = false;
+    }
+    return rv;
+}
+
+// -------------------------------------------------------------------------------------------------
+RowSet*
+ShardedDatabase::CreateRowSet()
+{
+    return new ShardedRowSet(this);
+}
+bool
+ShardedDatabase::CreateRowSet(RSInterface* cif)
+{
+    cif->PostCreate(new ShardedRowSet(this));
+    return true;
+}
+string
+ShardedDatabase::GetErrorDescription(RowSet*)
+{
+    return string(GetLastError());
+}
+
+// -------------------------------------------------------------------------------------------------
+// Calls that need the shard key.
+#define SHARD_CALL(call, failed)                                                                   \
+    Database* db = current();                                                                      \
+    if (!db)                                                                                       \
+        return failed;                                                                             \
+    auto rv = db->call;                                                                            \
+    if (rv == failed)                                                                              \
+        copyError(db);                                                                             \
+    return rv;
+
+bool
+ShardedDatabase::StartTransaction()
+{
+    SHARD_CALL(StartTransaction(), false)
+}
+bool
+ShardedDatabase::Commit()
+{
+    SHARD_CALL(Commit(), false)
+}
+bool
+ShardedDatabase::RollBack()
+{
+    SHARD_CALL(RollBack(), false)
+}
+bool
+ShardedDatabase::ExecuteIntFunction(const string& query, int& val)
+{
+    SHARD_CALL(ExecuteIntFunction(query, val), false)
+}
+bool
+ShardedDatabase::ExecuteLongFunction(const string& query, long& val)
+{
+    SHARD_CALL(ExecuteLongFunction(query, val), false)
+}
+bool
+ShardedDatabase::ExecuteDoubleFunction(const string& query, double& val)
+{
+    SHARD_CALL(ExecuteDoubleFunction(query, val), false)
+}
+bool
+ShardedDatabase::ExecuteBoolFunction(const string& query, bool& val)
+{
+    SHARD_CALL(ExecuteBoolFunction(query, val), false)
+}
+bool
+ShardedDatabase::ExecuteStrFunction(const string& query, string& result)
+{
+    SHARD_CALL(ExecuteStrFunction(query, result), false)
+}
+bool
+ShardedDatabase::ExecuteDateFunction(const string& query, tm& val)
+{
+    SHARD_CALL(ExecuteDateFunction(query, val), false)
+}
+unsigned long
+ShardedDatabase::GetInsertId()
+{
+    Database* db = current();
+    return db ? db->GetInsertId() : 0;
+}
+bool
+ShardedDatabase::FindSchemaItem(ST stype, const char* name)
+{
+    SHARD_CALL(FindSchemaItem(stype, name), false)
+}
+int
+ShardedDatabase::ExecuteBulk(const string& query, const BulkParams& params, vector<int>* affected)
+{
+    SHARD_CALL(ExecuteBulk(query, params, affected), -1)
+}
+bool
+ShardedDatabase::ExecuteInsert(const string& insert, const char* keys, vector<long long>& ids)
+{
+    SHARD_CALL(ExecuteInsert(insert, keys, ids), false)
+}
+int
+ShardedDatabase::ExecuteBulkInsert(const string& insert,
+                                   const BulkParams& params,
+                                   const char* keys,
+                                   vector<long long>& ids)
+{
+    SHARD_CALL(ExecuteBulkInsert(insert, params, keys, ids), -1)
+}
+
+// -------------------------------------------------------------------------------------------------
+int
+ShardedDatabase::ExecuteModify(const string& query)
+{
+    SHARD_CALL(ExecuteModify(query), -1)
+}
+bool
+ShardedDatabase::UpdateStructure(const string& command)
+{
+    SHARD_CALL(UpdateStructure(command), false)
+}
+
+// -------------------------------------------------------------------------------------------------
+int
+ShardedDatabase::ExecuteModifyAll(const string& query)
+/*!
+  Runs the statement on every shard regardless of the shard key.
+  \retval int Sum of the affected rows, -1 if any shard failed.
+*/
+{
+    int total = 0;
+    for (Shard& shard : shards) {
+        int rv = shard.db->ExecuteModify(query);
+        if (rv < 0) {
+            copyError(shard.db);
+            total = -1;
+        } else if (total >= 0)
+            total += rv;
+    }
+    return total;
+}
+bool
+ShardedDatabase::UpdateStructureAll(const string& command)
+{
+    bool rv = true;
+    for (Shard& shard : shards) {
+        if (!shard.db->UpdateStructure(command)) {
+            copyError(shard.db);
+            rv = false;
+        }
+    }
+    return rv;
+}
+
+// =================================================================================================
+ShardedRowSet::ShardedRowSet(ShardedDatabase* sdb_in)
+  : sdb(sdb_in)
+{
+    direct = 0;
+    chunk_pos = 0;
+    part_ndx = 0;
+    stop = false;
+}
+ShardedRowSet::~ShardedRowSet()
+{
+    Reset();
+}
+// -------------------------------------------------------------------------------------------------
+void
+ShardedRowSet::Reset()
+/*!
+  Stops the shard threads. A thread stops when it has read its next chunk of rows.
+*/
+{
+    cached.reset();
+    delete direct;
+    direct = 0;
+    {
+        lock_guard<mutex> lock(part_mutex);
+        stop = true;
+    }
+    space_cv.notify_all();
+    for (thread& worker : workers)
+        worker.join();
+    workers.clear();
+    for (Part& part : parts)
+        delete part.rs;
+    parts.clear();
+    chunk.clear();
+    chunk_pos = 0;
+    part_ndx = 0;
+    stop = false;
+}
+// -------------------------------------------------------------------------------------------------
+bool
+ShardedRowSet::Query()
+{
+    if (!fieldRoot) {
+        sdb->SetLastError("Query called without bound variables.");
+        return false;
+    }
+    Reset();
+    row_count = 0;
+    failed = false;
+    if (sdb->active) {
+        direct = sdb->active->CreateRowSet();
+        if (!direct) {
+            sdb->copyError(sdb->active);
+            return false;
+        }
+        for (BoundField* field = fieldRoot; field; field = field->next)
+            direct->Bind(*field);
+        direct->query.Append(query.GetText(), query.GetLength());
+        if (!direct->Query()) {
+            sdb->copyError(sdb->active);
+            return false;
+        }
+        return true;
+    }
+    return gather();
+}
+// -------------------------------------------------------------------------------------------------
+long
+ShardedRowSet::WriteJson(JsonWriter& out)
+{
+    Reset();
+    if (!sdb->active) {
+        sdb->SetLastError("WriteJson needs a shard key.");
+        return -1;
+    }
+    direct = sdb->active->CreateRowSet();
+    if (!direct) {
+        sdb->copyError(sdb->active);
+        return -1;
+    }
+    direct->query.Append(query.GetText(), query.GetLength());
+    long rv = direct->WriteJson(out);
+    if (rv < 0)
+        sdb->copyError(sdb->active);
+    row_count = rv < 0 ? 0 : rv;
+    return rv;
+}
+// -------------------------------------------------------------------------------------------------
+bool
+ShardedRowSet::gather()
+/*!
+  Each shard's rows are read by its own thread. Databases are not thread safe but each shard is
+  used by one thread only. Query returns when all shards have run their query so that a failed
+  query fails the Query call.
+*/
+{
+    size_t fields = 0;
+    for (BoundField* field = fieldRoot; field; field = field->next)
+        fields++;
+    parts.resize(sdb->shards.size());
+    for (size_t ndx = 0; ndx < parts.size(); ndx++) {
+        Part& part = parts[ndx];
+        part.db = sdb->shards[ndx].db;
+        part.started = false;
+        part.queried = false;
+        part.done = false;
+        part.ok = false;
+        part.rs = part.db->CreateRowSet();
+        if (!part.rs) {
+            sdb->copyError(part.db);
+            Reset();
+            return false;
+        }
+        part.values.resize(fields);
+        size_t fn = 0;
+        for (BoundField* field = fieldRoot; field; field = field->next, fn++)
+            part.rs->Bind(field->type, part.values[fn].Address(field->type),
+                          &part.values[fn].null);
+        part.rs->query.Append(query.GetText(), query.GetLength());
+    }
+    for (Part& part : parts)
+        workers.emplace_back(&ShardedRowSet::run, this, &part);
+
+    Database* failed_db = 0;
+    {
+        unique_lock<mutex> lock(part_mutex);
+        for (Part& part : parts) {
+            data_cv.wait(lock, [&part] { return part.started; });
+            if (!part.queried && !failed_db)
+                failed_db = part.db;
+        }
+    }
+    if (failed_db) {
+        // Error is copied when the threads have stopped.
+        Reset();
+        sdb->copyError(failed_db);
+        return false;
+    }
+    return true;
+}
+// -------------------------------------------------------------------------------------------------
+void
+ShardedRowSet::run(Part* part)
+/*!
+  Shard thread. Packs the rows into chunks and hands them over to the reader.
+*/
+{
+    bool ok = part->rs->Query();
+    {
+        lock_guard<mutex> lock(part_mutex);
+        part->started = true;
+        part->queried = ok;
+    }
+    data_cv.notify_all();
+    string rows;
+    size_t rows_in = 0;
+    for (int count; ok && (count = part->rs->GetNext()) > 0;) {
+        rows.append((const char*)&count, sizeof(count));
+        BoundField* field = fieldRoot;
+        for (size_t fn = 0; field; field = field->next, fn++) {
+            ValueSlot& slot = part->values[fn];
+            PackField(rows, field->type, slot.Address(field->type), slot.null);
+        }
+        if (++rows_in < SHARD_CHUNK_ROWS)
+            continue;
+        unique_lock<mutex> lock(part_mutex);
+        space_cv.wait(lock,
+                      [this, part] { return stop || part->chunks.size() < SHARD_MAX_CHUNKS; });
+        if (stop)
+            return;
+        part->chunks.push_back(move(rows));
+        lock.unlock();
+        data_cv.notify_all();
+        rows.clear();
+        rows_in = 0;
+    }
+    if (ok && part->rs->IsFailed())
+        ok = false;
+    {
+        lock_guard<mutex> lock(part_mutex);
+        if (!rows.empty())
+            part->chunks.push_back(move(rows));
+        part->ok = ok;
+        part->done = true;
+    }
+    data_cv.notify_all();
+}
+// -------------------------------------------------------------------------------------------------
+bool
+ShardedRowSet::nextChunk()
+/*!
+  Waits for the next chunk. Shards are visited round robin so that a fast shard does not starve
+  the others.
+  \retval bool False at the end of the rows or on error. Error sets the failed flag.
+*/
+{
+    unique_lock<mutex> lock(part_mutex);
+    for (;;) {
+        bool pending = false;
+        for (size_t nth = 0; nth < parts.size(); nth++) {
+            size_t ndx = (part_ndx + nth) % parts.size();
+            Part& part = parts[ndx];
+            if (!part.chunks.empty()) {
+                chunk = move(part.chunks.front());
+                part.chunks.pop_front();
+                chunk_pos = 0;
+                part_ndx = ndx + 1;
+                space_cv.notify_all();
+                return true;
+            }
+            if (!part.done)
+                pending = true;
+            else if (!part.ok) {
+                // Shard's thread has finished so its database can be read here.
+                failed = true;
+                sdb->copyError(part.db);
+                return false;
+            }
+        }
+        if (!pending)
+            return false;
+        data_cv.wait(lock);
+    }
+}
+// -------------------------------------------------------------------------------------------------
+int
+ShardedRowSet::GetNext()
+{
+    if (cached)
+        return GetNextCached();
+    if (direct) {
+        int rv = direct->GetNext();
+        if (rv)
+            row_count++;
+        else if (direct->IsFailed()) {
+            failed = true;
+            sdb->copyError(sdb->active);
+        }
+        return rv;
+    }
+    if (parts.empty() || failed)
+        return 0;
+    if (chunk_pos >= chunk.size() && !nextChunk()) {
+        Reset();
+        return 0;
+    }
+    const char* data = chunk.data() + chunk_pos;
+    int count;
+    memcpy(&count, data, sizeof(count));
+    data += sizeof(count);
+    for (BoundField* field = fieldRoot; field; field = field->next)
+        data = UnpackField(data, field);
+    chunk_pos = data - chunk.data();
+    row_count++;
+    return count;
+}
+
+}; // namespace ddb
@@ -9,6 +9,9 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <ctype.h>
+#include <strings.h>
+#include <sstream>
 #include <cpp4scripts.hpp>
 
 #define __DDB_SQLITE3__
@@ -24,11 +27,14 @@ Sqlite::Sqlite()
   Constructs database object for the connection to the Sqlite databases.
 */
 {
+    feat_support |= FEATURE_TRANSACTIONS;
     feat_support |= FEATURE_AUTOTRIM;
+    feat_on |= FEATURE_TRANSACTIONS;
     feat_on |= FEATURE_AUTOTRIM;
     flags |= FLAG_INITIALIZED;
     connection = 0;
     errval = 0;
+    cancel_flag = false;
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -42,31 +48,315 @@ Sqlite::~Sqlite()
 }
 
 // -------------------------------------------------------------------------------------------------
+SqliteOptions::SqliteOptions()
+{
+    read_only = false;
+    create = true;
+    mutex = MUTEX_DEFAULT;
+    cache_size = 0;
+    mmap_size = -1;
+    page_size = 0;
+    busy_timeout = 0;
+    wal_autocheckpoint = -1;
+}
+
+// -------------------------------------------------------------------------------------------------
+static bool
+IsOneOf(const string& value, const char* const* list)
+{
+    for (; *list; list++) {
+        if (!strcasecmp(value.c_str(), *list))
+            return true;
+    }
+    return false;
+}
+static bool
+IsTrue(const string& value)
+{
+    return value == "1" || !strcasecmp(value.c_str(), "yes") || !strcasecmp(value.c_str(), "on") ||
+           !strcasecmp(value.c_str(), "true");
+}
+
+static const char* const journal_modes[] = { "DELETE", "TRUNCATE", "PERSIST", "MEMORY",
+                                             "WAL",    "OFF",      0 };
+static const char* const sync_modes[] = { "OFF", "NORMAL", "FULL", "EXTRA", 0 };
+static const char* const temp_stores[] = { "DEFAULT", "FILE", "MEMORY", 0 };
+static const char* const option_keys[] = {
+    "file",              "read_only",         "create",            "mutex",
+    "journal_mode",      "synchronous",       "temp_store",        "cache_size",
+    "mmap_size",         "page_size",         "busy_timeout",      "wal_autocheckpoint",
+    0
+};
+
+// Connection string has options if it starts with one of the option keys and '='. Other strings,
+// e.g. "/data/a=b.db" or "file:app.db?mode=ro", are file names as before.
+static bool
+HasOptions(const char* constr)
+{
+    while (isspace(*constr))
+        constr++;
+    const char* end = constr;
+    while (*end && *end != '=' && !isspace(*end))
+        end++;
+    return *end == '=' && IsOneOf(string(constr, end - constr), option_keys);
+}
+
 bool
-Sqlite::Connect(const char* filename)
+SqliteOptions::Parse(const char* constr, string& filename, string& error)
+/*!
+  Parses 'key=value' pairs separated by white space. Values with spaces can be enclosed
+  in single quotes. Values for the modes are validated since they end up in PRAGMA statements.
+  String that does not start with a known key is taken as plain file name.
+  \param constr Connection string.
+  \param filename Database file name from the 'file' key.
+  \param error Description of the first error.
+  \retval bool True if all the keys and values were valid.
+*/
 {
-    if (!filename) {
+    if (!HasOptions(constr)) {
+        filename = constr;
+        return true;
+    }
+    const char* ptr = constr;
+    string key, value;
+    while (*ptr) {
+        while (isspace(*ptr))
+            ptr++;
+        if (!*ptr)
+            break;
+        key.clear();
+        value.clear();
+        while (*ptr && *ptr != '=' && !isspace(*ptr))
+            key += *ptr++;
+        if (*ptr != '=') {
+            error = "Missing value for key: " + key;
+            return false;
+        }
+        ptr++;
+        if (*ptr == '\'') {
+            for (ptr++; *ptr && *ptr != '\''; ptr++)
+                value += *ptr;
+            if (*ptr)
+                ptr++;
+        } else {
+            while (*ptr && !isspace(*ptr))
+                value += *ptr++;
+        }
+
+        if (key == "file")
+            filename = value;
+        else if (key == "read_only")
+            read_only = IsTrue(value);
+        else if (key == "create")
+            create = IsTrue(value);
+        else if (key == "mutex") {
+            if (!strcasecmp(value.c_str(), "no"))
+                mutex = MUTEX_NO;
+            else if (!strcasecmp(value.c_str(), "full"))
+                mutex = MUTEX_FULL;
+            else if (!strcasecmp(value.c_str(), "default"))
+                mutex = MUTEX_DEFAULT;
+            else {
+                error = "Invalid mutex mode (no, full, default): " + value;
+                return false;
+            }
+        } else if (key == "journal_mode") {
+            if (!IsOneOf(value, journal_modes)) {
+                error = "Invalid journal_mode: " + value;
+                return false;
+            }
+            journal_mode = value;
+        } else if (key == "synchronous") {
+            if (!IsOneOf(value, sync_modes)) {
+                error = "Invalid synchronous mode: " + value;
+                return false;
+            }
+            synchronous = value;
+        } else if (key == "temp_store") {
+            if (!IsOneOf(value, temp_stores)) {
+                error = "Invalid temp_store: " + value;
+                return false;
+            }
+            temp_store = value;
+        } else if (key == "cache_size")
+            cache_size = strtol(value.c_str(), 0, 10);
+        else if (key == "mmap_size")
+            mmap_size = strtoll(value.c_str(), 0, 10);
+        else if (key == "page_size")
+            page_size = (int)strtol(value.c_str(), 0, 10);
+        else if (key == "busy_timeout")
+            busy_timeout = (int)strtol(value.c_str(), 0, 10);
+        else if (key == "wal_autocheckpoint")
+            wal_autocheckpoint = (int)strtol(value.c_str(), 0, 10);
+        else {
+            error = "Unknown connection option: " + key;
+            return false;
+        }
+    }
+    if (filename.empty()) {
+        error = "Database file name (file=) missing.";
+        return false;
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+Sqlite::Connect(const char* constr)
+{
+    if (!constr) {
+        SetLastError("Empty or incorrect connections string.");
+        return false;
+    }
+    SqliteOptions opt;
+    string file, error;
+    if (!opt.Parse(constr, file, error)) {
+        SetLastError("Connect: ");
+        AppendLastError(error.c_str());
+        return false;
+    }
+    return Connect(file.c_str(), opt);
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+Sqlite::Connect(const char* file, const SqliteOptions& opt)
+/*!
+  Opens the database file and applies the given options. Options are only validated
+  when parsed from connection string.
+  \param file Database file name.
+  \param opt Connection options.
+*/
+{
+    if (!file) {
         SetLastError("Empty or incorrect connections string.");
         return false;
     }
+    int open_flags;
+    if (opt.read_only)
+        open_flags = SQLITE_OPEN_READONLY;
+    else {
+        open_flags = SQLITE_OPEN_READWRITE;
+        if (opt.create)
+            open_flags |= SQLITE_OPEN_CREATE;
+    }
+    if (opt.mutex == SqliteOptions::MUTEX_NO)
+        open_flags |= SQLITE_OPEN_NOMUTEX;
+    else if (opt.mutex == SqliteOptions::MUTEX_FULL)
+        open_flags |= SQLITE_OPEN_FULLMUTEX;
 
-    errval = sqlite3_open_v2(filename, &connection, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 0);
+    errval = sqlite3_open_v2(file, &connection, open_flags, 0);
     if (errval != SQLITE_OK) {
         sqlite3_close_v2(connection);
         connection = 0;
         SetLastError("Connection failure. Check the initialization parameters.");
         return false;
     }
+    options = opt;
+    filename = file;
+    sqlite3_progress_handler(connection, 1000, &Sqlite::progressHandler, this);
+    if (!applyOptions()) {
+        sqlite3_close_v2(connection);
+        connection = 0;
+        return false;
+    }
     flags |= FLAG_CONNECTED;
     return true;
 }
 
+// -------------------------------------------------------------------------------------------------
+bool
+Sqlite::applyOptions()
+/*!
+  Page size needs to be set before WAL mode since it cannot be changed after that. Journal mode
+  is read back since SQLite keeps the old mode if it cannot switch, e.g. in-memory databases
+  cannot use WAL.
+*/
+{
+    char* errmsg;
+    ostringstream pragmas;
+    if (options.busy_timeout > 0)
+        sqlite3_busy_timeout(connection, options.busy_timeout);
+    if (options.wal_autocheckpoint >= 0)
+        sqlite3_wal_autocheckpoint(connection, options.wal_autocheckpoint);
+    if (!options.read_only) {
+        if (options.page_size > 0)
+            pragmas << "PRAGMA page_size=" << options.page_size << ';';
+    }
+    if (!options.synchronous.empty())
+        pragmas << "PRAGMA synchronous=" << options.synchronous << ';';
+    if (options.cache_size)
+        pragmas << "PRAGMA cache_size=" << options.cache_size << ';';
+    if (options.mmap_size >= 0)
+        pragmas << "PRAGMA mmap_size=" << options.mmap_size << ';';
+    if (!options.temp_store.empty())
+        pragmas << "PRAGMA temp_store=" << options.temp_store << ';';
+    if (pragmas.tellp() > 0 &&
+        sqlite3_exec(connection, pragmas.str().c_str(), 0, 0, &errmsg) != SQLITE_OK) {
+        SetLastError("Connect - unable to apply options: ");
+        AppendLastError(errmsg);
+        sqlite3_free(errmsg);
+        return false;
+    }
+    if (options.read_only || options.journal_mode.empty())
+        return true;
+    string sql = "PRAGMA journal_mode=" + options.journal_mode;
+    string mode;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(connection, sql.c_str(), -1, &stmt, 0) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0))
+            mode = (const char*)sqlite3_column_text(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    if (strcasecmp(mode.c_str(), options.journal_mode.c_str())) {
+        SetLastError("Connect - unable to set journal_mode ");
+        AppendLastError(options.journal_mode.c_str());
+        AppendLastError(mode.empty() ? ": " : ". Database is in mode ");
+        AppendLastError(mode.empty() ? sqlite3_errmsg(connection) : mode.c_str());
+        return false;
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+int
+Sqlite::progressHandler(void* ptr)
+/*!
+  Sqlite calls this every 1000 virtual machine instructions. Non-zero return interrupts the
+  statement with SQLITE_INTERRUPT.
+*/
+{
+    Sqlite* db = (Sqlite*)ptr;
+    if (db->cancel_flag ||
+        (db->stmt_timeout && std::chrono::steady_clock::now() >= db->deadline)) {
+        db->timed_out = true;
+        return 1;
+    }
+    return 0;
+}
+bool
+Sqlite::SetStatementTimeout(unsigned int ms)
+{
+    stmt_timeout = ms;
+    return true;
+}
+bool
+Sqlite::Cancel()
+{
+    cancel_flag = true;
+    return true;
+}
+
 // -------------------------------------------------------------------------------------------------
 bool
 Sqlite::Disconnect()
 {
+    for (auto& cached : stmt_cache)
+        sqlite3_finalize(cached.second);
+    stmt_cache.clear();
     if (connection)
         sqlite3_close_v2(connection);
+    connection = 0;
     flags &= ~FLAG_CONNECTED;
     return true;
 }
@@ -98,7 +388,9 @@ Sqlite::GetErrorDescription(RowSet*)
 {
     string errorMsg;
 
-    errorMsg = GetLastError();
+    if (timed_out)
+        errorMsg = "Statement timeout. ";
+    errorMsg += GetLastError();
     if (connection) {
         errorMsg += "\n";
         errorMsg += sqlite3_errmsg(connection);
@@ -106,6 +398,60 @@ Sqlite::GetErrorDescription(RowSet*)
     return errorMsg;
 }
 
+// -------------------------------------------------------------------------------------------------
+bool
+Sqlite::StartTransaction()
+{
+    if (!(flags & FLAG_CONNECTED)) {
+        SetLastError("Attempt to use member functions without a connection to the database.");
+        return false;
+    }
+    if (flags & FLAG_TRANSACT_ON) {
+        SetLastError("Transaction start: Transaction is already on.");
+        return false;
+    }
+    if (!UpdateStructure("BEGIN"))
+        return false;
+    flags |= FLAG_TRANSACT_ON;
+    return true;
+}
+// -------------------------------------------------------------------------------------------------
+bool
+Sqlite::Commit()
+{
+    if (!(flags & FLAG_CONNECTED)) {
+        SetLastError("Attempt to use member functions without a connection to the database.");
+        return false;
+    }
+    if (!(flags & FLAG_TRANSACT_ON)) {
+        SetLastError("Commit/RollBack: The transaction has not been started.");
+        return false;
+    }
+    // Failed COMMIT (e.g. SQLITE_BUSY) can leave the transaction open. It stays on until
+    // RollBack or a successful Commit.
+    bool rv = UpdateStructure("COMMIT");
+    if (rv || sqlite3_get_autocommit(connection))
+        flags &= ~FLAG_TRANSACT_ON;
+    return rv;
+}
+// -------------------------------------------------------------------------------------------------
+bool
+Sqlite::RollBack()
+{
+    if (!(flags & FLAG_CONNECTED)) {
+        SetLastError("Attempt to use member functions without a connection to the database.");
+        return false;
+    }
+    if (!(flags & FLAG_TRANSACT_ON)) {
+        SetLastError("Commit/RollBack: The transaction has not been started.");
+        return false;
+    }
+    bool rv = UpdateStructure("ROLLBACK");
+    if (rv || sqlite3_get_autocommit(connection))
+        flags &= ~FLAG_TRANSACT_ON;
+    return rv;
+}
+
 // -------------------------------------------------------------------------------------------------
 int
 ExecIntCb(void* valptr, int cols, char** value, char** /*col name*/)
@@ -126,6 +472,7 @@ Sqlite::ExecuteIntFunction(const string& query, int& val)
 
     if (query.length() == 0)
         return false;
+    ArmTimeout();
     if (sqlite3_exec(connection, query.c_str(), &ExecIntCb, &data, &errmsg) != SQLITE_OK) {
         SetLastError("ExecuteIntFunction failed: ");
         AppendLastError(errmsg);
@@ -154,6 +501,7 @@ Sqlite::ExecuteLongFunction(const string& query, long& val)
     ExecData data(&val);
     if (query.length() == 0)
         return false;
+    ArmTimeout();
     if (sqlite3_exec(connection, query.c_str(), &ExecLongCb, &data, &errmsg) != SQLITE_OK) {
         SetLastError("ExecuteLongFunction failed: ");
         AppendLastError(errmsg);
@@ -182,6 +530,7 @@ Sqlite::ExecuteDoubleFunction(const string& query, double& val)
     ExecData data(&val);
     if (query.length() == 0)
         return false;
+    ArmTimeout();
     if (sqlite3_exec(connection, query.c_str(), &ExecDoubleCb, &val, &errmsg) != SQLITE_OK) {
         SetLastError("ExecuteDoubleFunction failed: ");
         AppendLastError(errmsg);
@@ -212,6 +561,7 @@ Sqlite::ExecuteBoolFunction(const string& query, bool& val)
 
     if (query.length() == 0)
         return false;
+    ArmTimeout();
     if (sqlite3_exec(connection, query.c_str(), &ExecBoolCb, &data, &errmsg) != SQLITE_OK) {
         SetLastError("ExecuteDoubleFunction failed: ");
         AppendLastError(errmsg);
@@ -243,6 +593,7 @@ Sqlite::ExecuteStrFunction(const string& query, string& answer)
 
     if (query.length() == 0)
         return false;
+    ArmTimeout();
     if (sqlite3_exec(connection, query.c_str(), &ExecStringCb, &data, &errmsg) != SQLITE_OK) {
         SetLastError("ExecuteStrFunction failed: ");
         AppendLastError(errmsg);
@@ -275,6 +626,7 @@ Sqlite::ExecuteDateFunction(const string& query, tm& val)
 
     if (query.length() == 0)
         return false;
+    ArmTimeout();
     if (sqlite3_exec(connection, query.c_str(), &ExecDateTimeCb, &data, &errmsg) != SQLITE_OK) {
         SetLastError("ExecuteDateFunction failed: ");
         AppendLastError(errmsg);
@@ -291,6 +643,7 @@ Sqlite::ExecuteModify(const string& modify)
     char* errmsg;
     if (modify.length() == 0)
         return -1;
+    ArmTimeout();
     if (sqlite3_exec(connection, modify.c_str(), 0, 0, &errmsg) != SQLITE_OK) {
         SetLastError("ExecuteModify failed: ");
         AppendLastError(errmsg);
@@ -305,6 +658,7 @@ Sqlite::UpdateStructure(const string& command)
     char* errmsg;
     if (command.length() == 0)
         return -1;
+    ArmTimeout();
     if (sqlite3_exec(connection, command.c_str(), 0, 0, &errmsg) != SQLITE_OK) {
         SetLastError("UpdateStructure failed: ");
         AppendLastError(errmsg);
@@ -313,6 +667,224 @@ Sqlite::UpdateStructure(const string& command)
     return true;
 }
 // -------------------------------------------------------------------------------------------------
+sqlite3_stmt*
+Sqlite::prepareCached(const string& query)
+/*!
+  Returns prepared statement for the query. Statements are kept until disconnect.
+*/
+{
+    auto it = stmt_cache.find(query);
+    if (it != stmt_cache.end())
+        return it->second;
+    sqlite3_stmt* stmt;
+    int rv = sqlite3_prepare_v3(connection, query.c_str(), query.size() + 1,
+                                SQLITE_PREPARE_PERSISTENT, &stmt, 0);
+    if (rv != SQLITE_OK) {
+        SetLastError("Prepare failed: ");
+        AppendLastError(sqlite3_errmsg(connection));
+        return 0;
+    }
+    stmt_cache[query] = stmt;
+    return stmt;
+}
+// -------------------------------------------------------------------------------------------------
+bool
+Sqlite::bindRow(sqlite3_stmt* stmt, const BulkParams& params, size_t row)
+{
+    int rv = SQLITE_OK;
+    for (size_t col = 0; col < params.GetColumns() && rv == SQLITE_OK; col++) {
+        const BulkParams::Column& column = params.GetColumn(col);
+        int ndx = col + 1;
+        switch (column.type) {
+        case DT::INT:
+            rv = sqlite3_bind_int(stmt, ndx, ((const int*)column.data)[row]);
+            break;
+        case DT::LONG:
+            rv = sqlite3_bind_int64(stmt, ndx, ((const long*)column.data)[row]);
+            break;
+        case DT::NUM:
+            rv = sqlite3_bind_double(stmt, ndx, ((const double*)column.data)[row]);
+            break;
+        case DT::BOOL:
+            rv = sqlite3_bind_int(stmt, ndx, ((const bool*)column.data)[row] ? 1 : 0);
+            break;
+        case DT::STR: {
+            const string& str = ((const string*)column.data)[row];
+            rv = sqlite3_bind_text(stmt, ndx, str.data(), str.size(), SQLITE_STATIC);
+            break;
+        }
+        case DT::CHR:
+        case DT::BIT:
+            rv = sqlite3_bind_text(stmt, ndx, (const char*)column.data + row, 1, SQLITE_STATIC);
+            break;
+        case DT::TIME:
+        case DT::DAY:
+            text_buffer.clear();
+            params.FormatText(row, col, text_buffer);
+            rv = sqlite3_bind_text(stmt, ndx, text_buffer.data(), text_buffer.size() - 1,
+                                   SQLITE_TRANSIENT);
+            break;
+        case DT::BLOB: {
+            // Null pointer would bind NULL instead of an empty blob.
+            const Blob& blob = ((const Blob*)column.data)[row];
+            if (blob.data)
+                rv = sqlite3_bind_blob64(stmt, ndx, blob.data, blob.size, SQLITE_STATIC);
+            else
+                rv = sqlite3_bind_zeroblob(stmt, ndx, 0);
+            break;
+        }
+        case DT::DEC: {
+            // Sent as text so that TEXT columns keep the value exact.
+            const Decimal& dec = ((const Decimal*)column.data)[row];
+            if (dec.scale == 0) {
+                rv = sqlite3_bind_int64(stmt, ndx, dec.units);
+                break;
+            }
+            char buffer[Decimal::MAX_TEXT];
+            rv = sqlite3_bind_text(stmt, ndx, buffer, dec.Format(buffer) - buffer,
+                                   SQLITE_TRANSIENT);
+            break;
+        }
+        case DT::VEC_LONG:
+        case DT::VEC_NUM:
+        case DT::VEC_STR: {
+            // Arrays are stored as JSON text.
+            const char* vec = (const char*)column.data;
+            size_t elem = column.type == DT::VEC_LONG  ? sizeof(vector<long>)
+                          : column.type == DT::VEC_NUM ? sizeof(vector<double>)
+                                                       : sizeof(vector<string>);
+            text_buffer.clear();
+            FormatArray(column.type, vec + row * elem, true, text_buffer);
+            rv = sqlite3_bind_text(stmt, ndx, text_buffer.data(), text_buffer.size(),
+                                   SQLITE_TRANSIENT);
+            break;
+        }
+        }
+    }
+    if (rv != SQLITE_OK) {
+        SetLastError("ExecuteBulk - bind failed: ");
+        AppendLastError(sqlite3_errstr(rv));
+        return false;
+    }
+    return true;
+}
+// -------------------------------------------------------------------------------------------------
+int
+Sqlite::ExecuteBulk(const string& query, const BulkParams& params, vector<int>* affected)
+{
+    return runBulk(query, params, affected, 0);
+}
+int
+Sqlite::ExecuteBulkInsert(const string& insert,
+                          const BulkParams& params,
+                          const char* keys,
+                          vector<long long>& ids)
+{
+    ids.clear();
+    if (!keys || !*keys) {
+        SetLastError("ExecuteBulkInsert - key columns are missing.");
+        return -1;
+    }
+    return runBulk(insert + " RETURNING " + keys, params, 0, &ids);
+}
+// -------------------------------------------------------------------------------------------------
+int
+Sqlite::runBulk(const string& query,
+                const BulkParams& params,
+                vector<int>* affected,
+                vector<long long>* ids)
+/*!
+  Runs the cached statement for each parameter row. Rows returned by the statement are collected
+  into 'ids' if given.
+*/
+{
+    if (query.length() == 0 || params.GetColumns() == 0)
+        return -1;
+    sqlite3_stmt* stmt = prepareCached(query);
+    if (!stmt)
+        return -1;
+    if (sqlite3_bind_parameter_count(stmt) != (int)params.GetColumns()) {
+        SetLastError("ExecuteBulk - parameter count does not match the bound columns.");
+        return -1;
+    }
+    bool own_tx = !IsTransaction();
+    if (own_tx && !StartTransaction())
+        return -1;
+    if (affected) {
+        affected->clear();
+        affected->reserve(params.GetRows());
+    }
+    int cols = sqlite3_column_count(stmt);
+    if (ids)
+        ids->reserve(ids->size() + params.GetRows() * cols);
+    ArmTimeout();
+    int total = 0;
+    for (size_t row = 0; row < params.GetRows(); row++) {
+        if (!bindRow(stmt, params, row)) {
+            total = -1;
+            break;
+        }
+        int rv;
+        while ((rv = sqlite3_step(stmt)) == SQLITE_ROW) {
+            for (int col = 0; ids && col < cols; col++)
+                ids->push_back(sqlite3_column_int64(stmt, col));
+        }
+        sqlite3_reset(stmt);
+        if (rv != SQLITE_DONE) {
+            SetLastError("ExecuteBulk failed: ");
+            AppendLastError(sqlite3_errmsg(connection));
+            total = -1;
+            break;
+        }
+        int changes = sqlite3_changes(connection);
+        total += changes;
+        if (affected)
+            affected->push_back(changes);
+    }
+    sqlite3_clear_bindings(stmt);
+    if (own_tx) {
+        if (total < 0)
+            RollBack();
+        else if (!Commit())
+            return -1;
+    }
+    return total;
+}
+// -------------------------------------------------------------------------------------------------
+bool
+Sqlite::ExecuteInsert(const string& insert, const char* keys, vector<long long>& ids)
+{
+    ids.clear();
+    if (insert.length() == 0)
+        return false;
+    if (!keys || !*keys) {
+        SetLastError("ExecuteInsert - key columns are missing.");
+        return false;
+    }
+    string query(insert);
+    query += " RETURNING ";
+    query += keys;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(connection, query.c_str(), query.size() + 1, &stmt, 0) != SQLITE_OK) {
+        SetLastError("ExecuteInsert - prepare failed: ");
+        AppendLastError(sqlite3_errmsg(connection));
+        return false;
+    }
+    ArmTimeout();
+    int rv, cols = sqlite3_column_count(stmt);
+    while ((rv = sqlite3_step(stmt)) == SQLITE_ROW) {
+        for (int col = 0; col < cols; col++)
+            ids.push_back(sqlite3_column_int64(stmt, col));
+    }
+    sqlite3_finalize(stmt);
+    if (rv != SQLITE_DONE) {
+        SetLastError("ExecuteInsert failed: ");
+        AppendLastError(sqlite3_errmsg(connection));
+        return false;
+    }
+    return true;
+}
+// -------------------------------------------------------------------------------------------------
 unsigned long
 Sqlite::GetInsertId()
 {
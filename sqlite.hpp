@@ -10,9 +10,49 @@
 #define SQLITE_H_FILE
 
 #include <sqlite3.h>
+#include <string.h>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
 
 namespace ddb {
 
+class SqliteBlob;
+
+// -------------------------------------------------------------------------------------------------
+//! Connection time settings for the Sqlite database.
+/*! Default values leave SQLite's own defaults in place. Options can also be given in the
+  connection string with the same names as the members, e.g.
+  "file=/var/cache/app.db journal_mode=WAL synchronous=NORMAL cache_size=-20000 mutex=no".
+  A connection string without any '=' characters is taken as plain file name.
+*/
+struct SqliteOptions
+{
+    enum MUTEX
+    {
+        MUTEX_DEFAULT, //!< Use the threading mode SQLite was compiled/started with.
+        MUTEX_NO,      //!< SQLITE_OPEN_NOMUTEX: connection is used from one thread at a time.
+        MUTEX_FULL     //!< SQLITE_OPEN_FULLMUTEX: serialized access to the connection.
+    };
+    SqliteOptions();
+    bool Parse(const char* constr, std::string& filename, std::string& error);
+
+    bool read_only;           //!< Open with SQLITE_OPEN_READONLY. Pragmas that write are skipped.
+    bool create;              //!< Create the file if it does not exist. Default true.
+    MUTEX mutex;              //!< Connection mutex mode.
+    std::string journal_mode; //!< DELETE, TRUNCATE, PERSIST, MEMORY, WAL or OFF.
+    std::string synchronous;  //!< OFF, NORMAL, FULL or EXTRA.
+    std::string temp_store;   //!< DEFAULT, FILE or MEMORY.
+    long cache_size;          //!< Pages if positive, KiB if negative. 0 = default.
+    long long mmap_size;      //!< Bytes of memory mapped I/O. -1 = default.
+    int page_size;            //!< Page size for new databases. 0 = default.
+    int busy_timeout;         //!< Milliseconds to wait for a lock. 0 = return busy at once.
+    int wal_autocheckpoint;   //!< WAL pages before automatic checkpoint. 0 = off, -1 = default.
+};
+
 // -------------------------------------------------------------------------------------------------
 //! Class defines Sqlite3 specific implementation to Database-interface.
 class Sqlite : public Database
@@ -24,6 +64,7 @@ class Sqlite : public Database
     // Database interface
     RDBM GetType() { return RDBM::SQLITE; }
     bool Connect(const char*);
+    bool Connect(const char* filename, const SqliteOptions& opt);
     bool Disconnect();
     bool IsConnectOK() { return connection ? true : false; }
     bool ResetConnection() { return true; }
@@ -31,9 +72,9 @@ class Sqlite : public Database
     RowSet* CreateRowSet();
     bool CreateRowSet(RSInterface*);
     //
-    bool StartTransaction() { return false; }
-    bool Commit() { return false; }
-    bool RollBack() { return false; }
+    bool StartTransaction();
+    bool Commit();
+    bool RollBack();
     //
     bool ExecuteIntFunction(const std::string& query, int& val);
     bool ExecuteLongFunction(const std::string& query, long& val);
@@ -47,9 +88,38 @@ class Sqlite : public Database
     bool UpdateStructure(const std::string& command);
     std::string GetErrorDescription(RowSet* rs);
     bool FindSchemaItem(ST, const char* name);
+    int ExecuteBulk(const std::string& query,
+                    const BulkParams& params,
+                    std::vector<int>* affected = 0);
+    bool ExecuteInsert(const std::string& insert, const char* keys, std::vector<long long>& ids);
+    int ExecuteBulkInsert(const std::string& insert,
+                          const BulkParams& params,
+                          const char* keys,
+                          std::vector<long long>& ids);
 
     // Unique interface
     sqlite3* GetConnection() { return connection; }
+    const SqliteOptions& GetOptions() { return options; }
+    const std::string& GetFileName() { return filename; }
+
+    bool SetStatementTimeout(unsigned int ms);
+    bool Cancel();
+    SqliteBlob* OpenBlob(const char* table,
+                         const char* column,
+                         long long rowid,
+                         bool write = false,
+                         const char* schema = "main");
+    //! Starts the statement time limit. Called once when a statement starts.
+    void ArmTimeout()
+    {
+        timed_out = false;
+        cancel_flag = false;
+        if (stmt_timeout)
+            deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(stmt_timeout);
+    }
+    //! Continues a statement started earlier with its own time limit. Cancel stays set.
+    void ResumeTimeout(const std::chrono::steady_clock::time_point& until) { deadline = until; }
+    const std::chrono::steady_clock::time_point& GetDeadline() { return deadline; }
 
     // Passing data with Sqlite call backs
     struct ExecData
@@ -64,8 +134,24 @@ class Sqlite : public Database
     };
 
   protected:
+    bool applyOptions();
+    sqlite3_stmt* prepareCached(const std::string& query);
+    bool bindRow(sqlite3_stmt* stmt, const BulkParams& params, size_t row);
+    int runBulk(const std::string& query,
+                const BulkParams& params,
+                std::vector<int>* affected,
+                std::vector<long long>* ids);
+
     sqlite3* connection;
     int errval;
+    SqliteOptions options; //!< Options used for the current connection.
+    std::string filename;  //!< Database file of the current connection.
+    std::map<std::string, sqlite3_stmt*> stmt_cache; //!< Prepared ExecuteBulk statements.
+    std::string text_buffer; //!< Conversion buffer for bulk parameters.
+    std::chrono::steady_clock::time_point deadline; //!< Current statement time limit.
+    std::atomic<bool> cancel_flag;                  //!< Set by Cancel.
+
+    static int progressHandler(void* db);
 };
 
 // -------------------------------------------------------------------------------------------------
@@ -80,13 +166,252 @@ class SqliteRowSet : public RowSet
     bool Query();
     int GetNext();
     void Reset();
+    long WriteJson(JsonWriter& out);
 
   protected:
     SqliteRowSet(Sqlite*);
+    bool prepare();
 
     Sqlite* db;           //!< Pointer to databse object.
     sqlite3_stmt* stmt;   //!< Prepared statement
     bool result_complete; //!< True if the result has been queried or reset.
+    std::chrono::steady_clock::time_point deadline; //!< Time limit of the whole query.
+};
+
+// -------------------------------------------------------------------------------------------------
+//! Handle for reading and writing one BLOB value in parts.
+/*! Created by Sqlite::OpenBlob. Reads and writes go straight to the database pages, i.e. there is
+  no SQL to parse and only the requested part is in memory. Blob size cannot be changed through
+  the handle: insert zeroblob(size) first and then write the content. Reopen moves the handle to
+  the same column of another row, which is the cheap way to go through many rows.
+
+  Handle becomes invalid (reads fail with 'abort') if its row is changed or deleted by other
+  means. It must be deleted before the database is disconnected. Errors are set to the database.
+*/
+class SqliteBlob
+{
+    friend class Sqlite;
+
+  public:
+    ~SqliteBlob();
+
+    size_t GetSize() { return size; }
+    //! Reads from the current position. \retval int Bytes read, 0 at the end and -1 on error.
+    int Read(void* buffer, int length);
+    //! Writes at the current position. Writing past the end of the blob fails.
+    bool Write(const void* buffer, int length);
+    //! Reads length bytes from the given offset.
+    bool ReadAt(void* buffer, int length, size_t offset);
+    bool WriteAt(const void* buffer, int length, size_t offset);
+    void Seek(size_t offset) { position = offset < size ? offset : size; }
+    size_t Tell() { return position; }
+    //! Moves the handle to another row and rewinds the position.
+    bool Reopen(long long rowid);
+
+  protected:
+    SqliteBlob(Sqlite* db_in, sqlite3_blob* blob_in);
+    bool check(int rv, const char* call);
+
+    Sqlite* db;
+    sqlite3_blob* blob;
+    size_t size;     //!< Size of the current blob.
+    size_t position; //!< Read/write position of Read and Write.
+};
+
+// -------------------------------------------------------------------------------------------------
+//! Sqlite database with one writer and several read only connections.
+/*! Pool lets multiple threads read a WAL mode database in parallel. Each query and
+  Execute...Function runs on a free reader connection; caller blocks if all readers are busy.
+  Reads nested in an open row set of the same thread reuse that row set's reader.
+  ExecuteModify, UpdateStructure and transactions are serialized on the single writer
+  connection. While a thread has a transaction open its reads also go to the writer so that
+  it sees its own uncommitted changes. Other threads that want to write wait until the
+  transaction ends.
+
+  Row sets created by the pool hold a reader only from Query until the result has been read or
+  reset. Row set objects themselves must not be shared between threads. Use journal_mode=WAL,
+  otherwise the writer and readers block each other. In-memory databases cannot be pooled.
+*/
+class SqlitePool : public Database
+{
+    friend class SqlitePoolRowSet;
+
+  public:
+    SqlitePool(unsigned int readers = 4);
+    ~SqlitePool();
+
+    // Database interface
+    RDBM GetType() { return RDBM::SQLITE; }
+    bool Connect(const char*);
+    bool Connect(const char* filename, const SqliteOptions& opt);
+    bool Disconnect();
+    bool IsConnectOK() { return writer.IsConnectOK(); }
+    bool ResetConnection() { return true; }
+    //
+    RowSet* CreateRowSet();
+    bool CreateRowSet(RSInterface*);
+    //
+    bool StartTransaction();
+    bool Commit();
+    bool RollBack();
+    //
+    bool ExecuteIntFunction(const std::string& query, int& val);
+    bool ExecuteLongFunction(const std::string& query, long& val);
+    bool ExecuteDoubleFunction(const std::string& query, double& val);
+    bool ExecuteBoolFunction(const std::string& query, bool& val);
+    bool ExecuteStrFunction(const std::string& query, std::string& result);
+    bool ExecuteDateFunction(const std::string& query, tm& val);
+    //
+    int ExecuteModify(const std::string& query);
+    unsigned long GetInsertId();
+    bool UpdateStructure(const std::string& command);
+    std::string GetErrorDescription(RowSet* rs);
+    bool FindSchemaItem(ST, const char* name);
+    int ExecuteBulk(const std::string& query,
+                    const BulkParams& params,
+                    std::vector<int>* affected = 0);
+    bool ExecuteInsert(const std::string& insert, const char* keys, std::vector<long long>& ids);
+    int ExecuteBulkInsert(const std::string& insert,
+                          const BulkParams& params,
+                          const char* keys,
+                          std::vector<long long>& ids);
+
+    bool SetStatementTimeout(unsigned int ms);
+
+    // Unique interface
+    Sqlite* GetWriter() { return &writer; }
+    size_t GetReaderCount() { return readers.size(); }
+
+  protected:
+    Sqlite* acquire();
+    void release(Sqlite*);
+    void copyError(Sqlite*);
+    bool isTxOwner() { return tx_owner.load() == std::this_thread::get_id(); }
+
+    unsigned int reader_count;   //!< Number of readers to open.
+    Sqlite writer;               //!< The only connection that modifies the database.
+    std::vector<Sqlite*> readers; //!< Read only connections.
+    std::vector<Sqlite*> idle;    //!< Readers that are currently free.
+    struct Lease
+    {
+        Sqlite* db;
+        int count; //!< Number of row sets and calls of the thread that use the reader.
+    };
+    std::map<std::thread::id, Lease> leases; //!< Readers in use by thread.
+    std::mutex pool_mutex;        //!< Guards the idle list and leases.
+    std::condition_variable pool_cv;
+    std::recursive_mutex write_mutex; //!< Held for each write and during transaction.
+    std::atomic<std::thread::id> tx_owner; //!< Thread that has the transaction open.
+    std::mutex error_mutex;
+};
+
+// -------------------------------------------------------------------------------------------------
+//! When and how hard SqliteCheckpointer checkpoints the WAL.
+struct CheckpointPolicy
+{
+    CheckpointPolicy();
+
+    unsigned int poll_ms;       //!< How often the WAL is checked.
+    unsigned int interval_ms;   //!< Passive checkpoint at least this often if pages are pending.
+    unsigned int passive_pages; //!< Passive checkpoint when this many pages are pending.
+    unsigned int restart_pages; //!< RESTART checkpoint when this many pages are pending.
+    long long truncate_bytes;   //!< TRUNCATE checkpoint when WAL file is this large.
+    int busy_timeout;           //!< Milliseconds RESTART/TRUNCATE wait for readers and writer.
+};
+
+//! Checkpoint counters and measurements. Times are in milliseconds.
+struct CheckpointStats
+{
+    CheckpointStats() { memset(this, 0, sizeof(CheckpointStats)); }
+
+    unsigned long passive;   //!< Number of PASSIVE checkpoints run.
+    unsigned long restart;   //!< Number of RESTART checkpoints run.
+    unsigned long truncate;  //!< Number of TRUNCATE checkpoints run.
+    unsigned long busy;      //!< Checkpoints that could not complete due to locks.
+    unsigned long failed;    //!< Checkpoints that failed with an error.
+    double last_ms;          //!< Duration of the last checkpoint.
+    double max_ms;           //!< Longest checkpoint.
+    double total_ms;         //!< Sum of all checkpoint durations.
+    int wal_pages;           //!< Pages in WAL after the last checkpoint.
+    int checkpointed_pages;  //!< Pages copied back to database by the last checkpoint.
+    long long wal_bytes;     //!< WAL file size at the last check.
+    long long max_wal_bytes; //!< Largest WAL size seen.
+};
+
+// -------------------------------------------------------------------------------------------------
+//! Runs WAL checkpoints on a background thread with its own connection.
+/*! Start turns automatic checkpoints off on the given writer so that commits never
+  pay for a checkpoint. The writer's commits are counted with a WAL hook. The background thread
+  checks every poll_ms how many pages are not yet checkpointed and escalates from PASSIVE to
+  RESTART as they grow, see CheckpointPolicy. WAL file size is used only for the TRUNCATE limit.
+  RESTART and TRUNCATE also bring the WAL back to the start when readers hold old snapshots,
+  which keeps the file from growing without a limit. Nothing is done while the WAL is fully
+  checkpointed and without new commits, and a checkpoint blocked by readers is retried at most
+  once per interval_ms until there are new commits.
+
+  Only commits through the writer given to Start are seen. Stop must be called before the
+  writer is disconnected.
+*/
+class SqliteCheckpointer
+{
+  public:
+    SqliteCheckpointer();
+    ~SqliteCheckpointer() { Stop(); }
+
+    bool Start(Sqlite* writer, const CheckpointPolicy& policy = CheckpointPolicy());
+    void Stop();
+    bool IsRunning() { return running; }
+    //! Runs a checkpoint right away. Mode is one of SQLITE_CHECKPOINT_...
+    bool Checkpoint(int mode);
+    CheckpointStats GetStats();
+    std::string GetLastError();
+
+  protected:
+    void run();
+    long long walSize();
+    long long pendingPages(long long bytes, bool& idle);
+    static int walHook(void* arg, sqlite3*, const char*, int frames);
+
+    sqlite3* connection;   //!< Connection used only for checkpoints.
+    sqlite3* writer_conn;  //!< Writer's connection that has the WAL hook.
+    std::atomic<long long> wal_frames;     //!< Frames in the WAL after the writer's last commit.
+    std::atomic<unsigned long> commits;    //!< Number of commits seen by the hook.
+    // Result of the last checkpoint, guarded by cp_mutex. ckpt_log is -1 before the first one.
+    long long ckpt_log, ckpt_done;
+    unsigned long ckpt_commits;
+    std::string wal_file;  //!< Path of the WAL file.
+    CheckpointPolicy policy;
+    CheckpointStats stats;
+    std::string last_error;
+    int page_size;
+    bool running;
+    bool stop;
+    std::thread worker;
+    std::mutex cp_mutex;   //!< Guards connection, stats and last error.
+    std::mutex wait_mutex;
+    std::condition_variable wait_cv;
+};
+
+// -------------------------------------------------------------------------------------------------
+//! Row set that borrows a reader from SqlitePool for the duration of a query.
+class SqlitePoolRowSet : public SqliteRowSet
+{
+    friend class SqlitePool;
+
+  public:
+    ~SqlitePoolRowSet();
+
+    bool Query();
+    int GetNext();
+    void Reset();
+    long WriteJson(JsonWriter& out);
+
+  protected:
+    SqlitePoolRowSet(SqlitePool*);
+    void release();
+
+    SqlitePool* pool;
+    bool leased; //!< True if db points to a reader borrowed from the pool.
 };
 
 }; // namespace ddb
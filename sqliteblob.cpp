@@ -0,0 +1,127 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <string.h>
+#include <stdlib.h>
+
+#define __DDB_SQLITE3__
+#include "directdb.hpp"
+
+using namespace std;
+
+namespace ddb {
+
+// -------------------------------------------------------------------------------------------------
+SqliteBlob*
+Sqlite::OpenBlob(const char* table,
+                 const char* column,
+                 long long rowid,
+                 bool write,
+                 const char* schema)
+/*!
+  Opens a handle to a BLOB (or text) value.
+  \param table Table name.
+  \param column Column name.
+  \param rowid Row id (INTEGER PRIMARY KEY) of the row.
+  \param write Open for writing.
+  \param schema Database name, 'main' or the name of an attached database.
+  \retval SqliteBlob* New handle that the caller deletes, or null on error.
+*/
+{
+    if (!connection) {
+        SetLastError("Attempt to use member functions without a connection to the database.");
+        return 0;
+    }
+    sqlite3_blob* blob;
+    int rv = sqlite3_blob_open(connection, schema, table, column, rowid, write ? 1 : 0, &blob);
+    if (rv != SQLITE_OK) {
+        SetLastError("OpenBlob failed: ");
+        AppendLastError(sqlite3_errmsg(connection));
+        sqlite3_blob_close(blob);
+        return 0;
+    }
+    return new SqliteBlob(this, blob);
+}
+
+// =================================================================================================
+SqliteBlob::SqliteBlob(Sqlite* db_in, sqlite3_blob* blob_in)
+  : db(db_in)
+  , blob(blob_in)
+{
+    size = sqlite3_blob_bytes(blob);
+    position = 0;
+}
+SqliteBlob::~SqliteBlob()
+{
+    sqlite3_blob_close(blob);
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+SqliteBlob::check(int rv, const char* call)
+{
+    if (rv == SQLITE_OK)
+        return true;
+    db->SetLastError(call);
+    db->AppendLastError(sqlite3_errmsg(db->GetConnection()));
+    return false;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+SqliteBlob::ReadAt(void* buffer, int length, size_t offset)
+{
+    return check(sqlite3_blob_read(blob, buffer, length, offset), "SqliteBlob read failed: ");
+}
+bool
+SqliteBlob::WriteAt(const void* buffer, int length, size_t offset)
+{
+    return check(sqlite3_blob_write(blob, buffer, length, offset), "SqliteBlob write failed: ");
+}
+
+// -------------------------------------------------------------------------------------------------
+int
+SqliteBlob::Read(void* buffer, int length)
+{
+    if ((size_t)length > size - position)
+        length = size - position;
+    if (!length)
+        return 0;
+    if (!ReadAt(buffer, length, position))
+        return -1;
+    position += length;
+    return length;
+}
+bool
+SqliteBlob::Write(const void* buffer, int length)
+{
+    if (!WriteAt(buffer, length, position))
+        return false;
+    position += length;
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+SqliteBlob::Reopen(long long rowid)
+/*!
+  Uses sqlite3_blob_reopen which is faster than opening a new handle.
+  \retval bool False if the row does not exist or the value is not a blob or text. Handle is
+  unusable after a failed reopen until a successful one.
+*/
+{
+    position = 0;
+    if (!check(sqlite3_blob_reopen(blob, rowid), "SqliteBlob reopen failed: ")) {
+        size = 0;
+        return false;
+    }
+    size = sqlite3_blob_bytes(blob);
+    return true;
+}
+
+}; // namespace ddb
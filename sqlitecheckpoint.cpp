@@ -0,0 +1,282 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <cpp4scripts.hpp>
+
+#define __DDB_SQLITE3__
+#include "directdb.hpp"
+
+using namespace std;
+
+namespace ddb {
+
+// -------------------------------------------------------------------------------------------------
+CheckpointPolicy::CheckpointPolicy()
+/*!
+  Defaults checkpoint at the same WAL size as SQLite's automatic checkpoint (1000 pages) but
+  off the commit path.
+*/
+{
+    poll_ms = 100;
+    interval_ms = 1000;
+    passive_pages = 1000;
+    restart_pages = 10000;
+    truncate_bytes = 64 * 1024 * 1024;
+    busy_timeout = 100;
+}
+
+// -------------------------------------------------------------------------------------------------
+SqliteCheckpointer::SqliteCheckpointer()
+  : wal_frames(0)
+  , commits(0)
+{
+    connection = 0;
+    writer_conn = 0;
+    ckpt_log = -1;
+    ckpt_done = 0;
+    ckpt_commits = 0;
+    page_size = 4096;
+    running = false;
+    stop = false;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+SqliteCheckpointer::Start(Sqlite* writer, const CheckpointPolicy& policy_in)
+/*!
+  Disables automatic checkpoints on the writer and starts the background thread. If there are
+  other connections writing to the same file their automatic checkpoints should be turned off
+  too (wal_autocheckpoint=0 in the connection string).
+  \param writer Connected Sqlite database in WAL mode.
+  \param policy_in Checkpoint policy.
+  \retval bool True if the thread was started.
+*/
+{
+    if (running) {
+        last_error = "Checkpointer is already running.";
+        return false;
+    }
+    if (!writer || !writer->GetConnection()) {
+        last_error = "Checkpointer needs a connected database.";
+        return false;
+    }
+    int rv = sqlite3_open_v2(writer->GetFileName().c_str(), &connection,
+                             SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, 0);
+    if (rv != SQLITE_OK) {
+        last_error = "Checkpointer connection failed: ";
+        last_error += sqlite3_errstr(rv);
+        sqlite3_close_v2(connection);
+        connection = 0;
+        return false;
+    }
+    policy = policy_in;
+    sqlite3_busy_timeout(connection, policy.busy_timeout);
+    sqlite3_wal_autocheckpoint(connection, 0);
+    // Hook replaces the writer's automatic checkpoint.
+    writer_conn = writer->GetConnection();
+    wal_frames = 0;
+    commits = 0;
+    sqlite3_wal_hook(writer_conn, &SqliteCheckpointer::walHook, this);
+
+    // Connection finds out that the database is in WAL mode on the first read. Until then
+    // checkpoints would be no-ops.
+    sqlite3_exec(connection, "SELECT count(*) FROM sqlite_master", 0, 0, 0);
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(connection, "PRAGMA page_size", -1, &stmt, 0) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            page_size = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    wal_file = writer->GetFileName() + "-wal";
+    stats = CheckpointStats();
+    ckpt_log = -1;
+    ckpt_done = 0;
+    ckpt_commits = 0;
+    stop = false;
+    running = true;
+    worker = thread(&SqliteCheckpointer::run, this);
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+SqliteCheckpointer::Stop()
+{
+    if (!running)
+        return;
+    {
+        lock_guard<mutex> lock(wait_mutex);
+        stop = true;
+    }
+    wait_cv.notify_one();
+    worker.join();
+    sqlite3_wal_hook(writer_conn, 0, 0);
+    writer_conn = 0;
+    sqlite3_close_v2(connection);
+    connection = 0;
+    running = false;
+}
+
+// -------------------------------------------------------------------------------------------------
+int
+SqliteCheckpointer::walHook(void* arg, sqlite3*, const char*, int frames)
+/*!
+  Called by SQLite on the writer's thread after each commit.
+*/
+{
+    SqliteCheckpointer* cp = (SqliteCheckpointer*)arg;
+    cp->wal_frames = frames;
+    cp->commits++;
+    return SQLITE_OK;
+}
+
+// -------------------------------------------------------------------------------------------------
+long long
+SqliteCheckpointer::walSize()
+{
+    struct stat st;
+    if (stat(wal_file.c_str(), &st))
+        return 0;
+    return st.st_size;
+}
+
+// -------------------------------------------------------------------------------------------------
+long long
+SqliteCheckpointer::pendingPages(long long bytes, bool& idle)
+/*!
+  Estimates the pages in the WAL that are not checkpointed yet.
+  \param bytes WAL file size.
+  \param idle Set if nothing was committed since the last checkpoint.
+*/
+{
+    long long frames = wal_frames;
+    unsigned long count = commits;
+    lock_guard<mutex> lock(cp_mutex);
+    idle = count == ckpt_commits;
+    if (ckpt_log < 0) {
+        // Nothing known before the first checkpoint. WAL frame has 24 byte header for each page.
+        return bytes / (page_size + 24);
+    }
+    if (idle)
+        return ckpt_log - ckpt_done;
+    // Writer starts the WAL from the beginning after it has been fully checkpointed.
+    if (ckpt_done == ckpt_log || frames < ckpt_log)
+        return frames;
+    return frames - ckpt_done;
+}
+
+// -------------------------------------------------------------------------------------------------
+void
+SqliteCheckpointer::run()
+{
+    auto last = chrono::steady_clock::now();
+    unique_lock<mutex> lock(wait_mutex);
+    while (!stop) {
+        wait_cv.wait_for(lock, chrono::milliseconds(policy.poll_ms), [this] { return stop; });
+        if (stop)
+            break;
+        long long bytes = walSize();
+        {
+            lock_guard<mutex> slock(cp_mutex);
+            stats.wal_bytes = bytes;
+            if (bytes > stats.max_wal_bytes)
+                stats.max_wal_bytes = bytes;
+        }
+        bool idle;
+        long long pages = pendingPages(bytes, idle);
+        auto now = chrono::steady_clock::now();
+        bool interval = now - last >= chrono::milliseconds(policy.interval_ms);
+        // Same checkpoint would have the same result unless readers have finished since.
+        if (pages <= 0 || (idle && !interval))
+            continue;
+        int mode = -1;
+        if (policy.truncate_bytes > 0 && bytes >= policy.truncate_bytes)
+            mode = SQLITE_CHECKPOINT_TRUNCATE;
+        else if (policy.restart_pages && pages >= policy.restart_pages)
+            mode = SQLITE_CHECKPOINT_RESTART;
+        else if (pages >= policy.passive_pages || interval)
+            mode = SQLITE_CHECKPOINT_PASSIVE;
+        if (mode < 0)
+            continue;
+        lock.unlock();
+        Checkpoint(mode);
+        lock.lock();
+        last = chrono::steady_clock::now();
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+SqliteCheckpointer::Checkpoint(int mode)
+/*!
+  Can be called from any thread while the checkpointer is running.
+  \retval bool True if checkpoint ran. Busy result is counted but is not an error.
+*/
+{
+    lock_guard<mutex> lock(cp_mutex);
+    if (!connection) {
+        last_error = "Checkpointer is not running.";
+        return false;
+    }
+    int log = -1, done = -1;
+    unsigned long count = commits;
+    auto start = chrono::steady_clock::now();
+    int rv = sqlite3_wal_checkpoint_v2(connection, 0, mode, &log, &done);
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    // WAL state is known also when the checkpoint was blocked.
+    if (log >= 0 && done >= 0) {
+        ckpt_log = log;
+        ckpt_done = done;
+        ckpt_commits = count;
+    }
+
+    stats.last_ms = ms;
+    stats.total_ms += ms;
+    if (ms > stats.max_ms)
+        stats.max_ms = ms;
+    if (rv == SQLITE_BUSY) {
+        stats.busy++;
+        return true;
+    }
+    if (rv != SQLITE_OK) {
+        stats.failed++;
+        last_error = "Checkpoint failed: ";
+        last_error += sqlite3_errmsg(connection);
+        CS_VAPRT_WARN("SqliteCheckpointer - %s", last_error.c_str());
+        return false;
+    }
+    if (mode == SQLITE_CHECKPOINT_TRUNCATE)
+        stats.truncate++;
+    else if (mode == SQLITE_CHECKPOINT_PASSIVE)
+        stats.passive++;
+    else
+        stats.restart++;
+    stats.wal_pages = log;
+    stats.checkpointed_pages = done;
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+CheckpointStats
+SqliteCheckpointer::GetStats()
+{
+    lock_guard<mutex> lock(cp_mutex);
+    return stats;
+}
+string
+SqliteCheckpointer::GetLastError()
+{
+    lock_guard<mutex> lock(cp_mutex);
+    return last_error;
+}
+
+}; // namespace ddb
@@ -0,0 +1,455 @@
+/* This file is part of 'Direct Database' C++ library (directdb)
+ * https://github.com/jaaskelainen-aj/directdb
+ *
+ * Copyright (c) 2021: Antti Jääskeläinen
+ * License: http://www.gnu.org/licenses/lgpl-2.1.html
+ * Disclaimer of Warranty: Work is provided on an "as is" basis, without warranties or conditions of
+ * any kind
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <cpp4scripts.hpp>
+
+#define __DDB_SQLITE3__
+#include "directdb.hpp"
+
+using namespace std;
+
+namespace ddb {
+
+// -------------------------------------------------------------------------------------------------
+SqlitePool::SqlitePool(unsigned int readers_in)
+/*!
+  Constructs the pool. Connections are opened by Connect.
+  \param readers_in Number of read only connections. At least one is always opened.
+*/
+{
+    reader_count = readers_in ? readers_in : 1;
+    feat_support |= FEATURE_TRANSACTIONS;
+    feat_support |= FEATURE_AUTOTRIM;
+    feat_on |= FEATURE_TRANSACTIONS;
+    feat_on |= FEATURE_AUTOTRIM;
+    flags |= FLAG_INITIALIZED;
+}
+
+// -------------------------------------------------------------------------------------------------
+SqlitePool::~SqlitePool()
+{
+    if (flags & FLAG_CONNECTED)
+        Disconnect();
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+SqlitePool::Connect(const char* constr)
+{
+    if (!constr) {
+        SetLastError("Empty or incorrect connections string.");
+        return false;
+    }
+    SqliteOptions opt;
+    string file, error;
+    if (!opt.Parse(constr, file, error)) {
+        SetLastError("Connect: ");
+        AppendLastError(error.c_str());
+        return false;
+    }
+    return Connect(file.c_str(), opt);
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+SqlitePool::Connect(const char* file, const SqliteOptions& opt)
+/*!
+  Opens the writer first so that the journal mode is set before the readers attach. Readers
+  use the same options but are always opened read only.
+*/
+{
+    if (flags & FLAG_CONNECTED) {
+        SetLastError("Connect: pool is already connected.");
+        return false;
+    }
+    SqliteOptions wopt(opt);
+    wopt.read_only = false;
+    writer.SetStatementTimeout(stmt_timeout);
+    if (!writer.Connect(file, wopt)) {
+        copyError(&writer);
+        return false;
+    }
+    SqliteOptions ropt(opt);
+    ropt.read_only = true;
+    for (unsigned int ndx = 0; ndx < reader_count; ndx++) {
+        Sqlite* reader = new Sqlite();
+        reader->SetStatementTimeout(stmt_timeout);
+        if (!reader->Connect(file, ropt)) {
+            copyError(reader);
+            delete reader;
+            Disconnect();
+            return false;
+        }
+        readers.push_back(reader);
+    }
+    idle = readers;
+    flags |= FLAG_CONNECTED;
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+SqlitePool::Disconnect()
+/*!
+  All row sets should have been reset or deleted before this is called.
+*/
+{
+    {
+        lock_guard<mutex> lock(pool_mutex);
+        for (Sqlite* reader : readers)
+            delete reader;
+        readers.clear();
+        idle.clear();
+        leases.clear();
+    }
+    writer.Disconnect();
+    flags &= ~FLAG_CONNECTED;
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+Sqlite*
+SqlitePool::acquire()
+/*!
+  Returns the writer for a thread with an open transaction, otherwise waits for a free reader.
+  A thread that already has a reader, e.g. an open row set, gets the same reader again. Nested
+  reads then never wait for the other threads' readers, which would deadlock when every thread
+  holds one.
+*/
+{
+    if (isTxOwner())
+        return &writer;
+    unique_lock<mutex> lock(pool_mutex);
+    auto lease = leases.find(this_thread::get_id());
+    if (lease != leases.end()) {
+        lease->second.count++;
+        return lease->second.db;
+    }
+    pool_cv.wait(lock, [this] { return !idle.empty(); });
+    Sqlite* reader = idle.back();
+    idle.pop_back();
+    leases[this_thread::get_id()] = Lease{ reader, 1 };
+    return reader;
+}
+void
+SqlitePool::release(Sqlite* db)
+{
+    if (db == &writer)
+        return;
+    {
+        lock_guard<mutex> lock(pool_mutex);
+        auto lease = leases.find(this_thread::get_id());
+        if (lease != leases.end() && lease->second.db == db) {
+            if (--lease->second.count)
+                return;
+            leases.erase(lease);
+        } else {
+            // Row set released from another thread than the one that queried.
+            for (auto it = leases.begin(); it != leases.end(); ++it) {
+                if (it->second.db == db) {
+                    if (--it->second.count)
+                        return;
+                    leases.erase(it);
+                    break;
+                }
+            }
+        }
+        idle.push_back(db);
+    }
+    pool_cv.notify_one();
+}
+void
+SqlitePool::copyError(Sqlite* db)
+{
+    lock_guard<mutex> lock(error_mutex);
+    SetLastError(db->GetLastError());
+    timed_out = db->IsTimeout();
+}
+bool
+SqlitePool::SetStatementTimeout(unsigned int ms)
+/*!
+  Should be called while no other thread uses the pool.
+*/
+{
+    stmt_timeout = ms;
+    writer.SetStatementTimeout(ms);
+    for (Sqlite* reader : readers)
+        reader->SetStatementTimeout(ms);
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+RowSet*
+SqlitePool::CreateRowSet()
+{
+    if (!(flags & FLAG_CONNECTED)) {
+        SetLastError("Attempt to use member functions without a connection to the database.");
+        return 0;
+    }
+    return new SqlitePoolRowSet(this);
+}
+bool
+SqlitePool::CreateRowSet(RSInterface* cif)
+{
+    if (!(flags & FLAG_CONNECTED)) {
+        SetLastError("Attempt to use member functions without a connection to the database.");
+        return false;
+    }
+    cif->PostCreate(new SqlitePoolRowSet(this));
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+string
+SqlitePool::GetErrorDescription(RowSet*)
+{
+    lock_guard<mutex> lock(error_mutex);
+    return string(GetLastError());
+}
+
+// -------------------------------------------------------------------------------------------------
+bool
+SqlitePool::StartTransaction()
+/*!
+  Locks the writer for the calling thread until Commit or RollBack. These must be called from
+  the same thread.
+*/
+{
+    if (isTxOwner()) {
+        SetLastError("Transaction start: Transaction is already on.");
+        return false;
+    }
+    write_mutex.lock();
+    if (!writer.StartTransaction()) {
+        copyError(&writer);
+        write_mutex.unlock();
+        return false;
+    }
+    tx_owner = this_thread::get_id();
+    return true;
+}
+bool
+SqlitePool::Commit()
+{
+    if (!isTxOwner()) {
+        SetLastError("Commit/RollBack: The transaction has not been started.");
+        return false;
+    }
+    bool rv = writer.Commit();
+    if (!rv)
+        copyError(&writer);
+    // Writer is kept locked while SQLite is still in the transaction, i.e. until RollBack.
+    if (writer.IsTransaction())
+        return rv;
+    tx_owner = thread::id();
+    write_mutex.unlock();
+    return rv;
+}
+bool
+SqlitePool::RollBack()
+{
+    if (!isTxOwner()) {
+        SetLastError("Commit/RollBack: The transaction has not been started.");
+        return false;
+    }
+    bool rv = writer.RollBack();
+    if (!rv)
+        copyError(&writer);
+    if (writer.IsTransaction())
+        return rv;
+    tx_owner = thread::id();
+    write_mutex.unlock();
+    return rv;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Read functions run on a borrowed reader.
+#define POOL_READ(call)                                                                            \
+    Sqlite* db = acquire();                                                                        \
+    bool rv = db->call;                                                                            \
+    if (!rv)                                                                                       \
+        copyError(db);                                                                             \
+    release(db);                                                                                   \
+    return rv;
+
+bool
+SqlitePool::ExecuteIntFunction(const string& query, int& val)
+{
+    POOL_READ(ExecuteIntFunction(query, val))
+}
+bool
+SqlitePool::ExecuteLongFunction(const string& query, long& val)
+{
+    POOL_READ(ExecuteLongFunction(query, val))
+}
+bool
+SqlitePool::ExecuteDoubleFunction(const string& query, double& val)
+{
+    POOL_READ(ExecuteDoubleFunction(query, val))
+}
+bool
+SqlitePool::ExecuteBoolFunction(const string& query, bool& val)
+{
+    POOL_READ(ExecuteBoolFunction(query, val))
+}
+bool
+SqlitePool::ExecuteStrFunction(const string& query, string& result)
+{
+    POOL_READ(ExecuteStrFunction(query, result))
+}
+bool
+SqlitePool::ExecuteDateFunction(const string& query, tm& val)
+{
+    POOL_READ(ExecuteDateFunction(query, val))
+}
+bool
+SqlitePool::FindSchemaItem(ST stype, const char* name)
+{
+    POOL_READ(FindSchemaItem(stype, name))
+}
+
+// -------------------------------------------------------------------------------------------------
+int
+SqlitePool::ExecuteModify(const string& query)
+{
+    lock_guard<recursive_mutex> lock(write_mutex);
+    int rv = writer.ExecuteModify(query);
+    if (rv < 0)
+        copyError(&writer);
+    return rv;
+}
+bool
+SqlitePool::UpdateStructure(const string& command)
+{
+    lock_guard<recursive_mutex> lock(write_mutex);
+    bool rv = writer.UpdateStructure(command);
+    if (!rv)
+        copyError(&writer);
+    return rv;
+}
+int
+SqlitePool::ExecuteBulk(const string& query, const BulkParams& params, vector<int>* affected)
+{
+    lock_guard<recursive_mutex> lock(write_mutex);
+    int rv = writer.ExecuteBulk(query, params, affected);
+    if (rv < 0)
+        copyError(&writer);
+    return rv;
+}
+bool
+SqlitePool::ExecuteInsert(const string& insert, const char* keys, vector<long long>& ids)
+{
+    lock_guard<recursive_mutex> lock(write_mutex);
+    bool rv = writer.ExecuteInsert(insert, keys, ids);
+    if (!rv)
+        copyError(&writer);
+    return rv;
+}
+int
+SqlitePool::ExecuteBulkInsert(const string& insert,
+                              const BulkParams& params,
+                              const char* keys,
+                              vector<long long>& ids)
+{
+    lock_guard<recursive_mutex> lock(write_mutex);
+    int rv = writer.ExecuteBulkInsert(insert, params, keys, ids);
+    if (rv < 0)
+        copyError(&writer);
+    return rv;
+}
+unsigned long
+SqlitePool::GetInsertId()
+/*!
+  Id is read from the writer. If several threads insert at the same time call this inside
+  a transaction to be sure that the id is from this thread's insert.
+*/
+{
+    lock_guard<recursive_mutex> lock(write_mutex);
+    return writer.GetInsertId();
+}
+
+// =================================================================================================
+SqlitePoolRowSet::SqlitePoolRowSet(SqlitePool* pool_in)
+  : SqliteRowSet(&pool_in->writer)
+  , pool(pool_in)
+{
+    leased = false;
+}
+SqlitePoolRowSet::~SqlitePoolRowSet()
+{
+    release();
+}
+// -------------------------------------------------------------------------------------------------
+void
+SqlitePoolRowSet::release()
+/*!
+  Statement belongs to the connection so it is finalized before the connection is returned.
+*/
+{
+    cached.reset();
+    if (stmt) {
+        sqlite3_finalize(stmt);
+        stmt = 0;
+    }
+    if (leased) {
+        pool->release(db);
+        db = &pool->writer;
+        leased = false;
+    }
+    result_complete = true;
+}
+// -------------------------------------------------------------------------------------------------
+bool
+SqlitePoolRowSet::Query()
+{
+    release();
+    db = pool->acquire();
+    leased = db != &pool->writer;
+    if (!SqliteRowSet::Query()) {
+        pool->copyError(db);
+        release();
+        return false;
+    }
+    return true;
+}
+// -------------------------------------------------------------------------------------------------
+int
+SqlitePoolRowSet::GetNext()
+{
+    int rv = SqliteRowSet::GetNext();
+    if (rv == 0 && failed)
+        pool->copyError(db);
+    if (rv == 0 && (result_complete || failed))
+        release();
+    return rv;
+}
+// -------------------------------------------------------------------------------------------------
+void
+SqlitePoolRowSet::Reset()
+{
+    release();
+    row_count = 0;
+}
+
+// -------------------------------------------------------------------------------------------------
+long
+SqlitePoolRowSet::WriteJson(JsonWriter& out)
+{
+    release();
+    db = pool->acquire();
+    leased = db != &pool->writer;
+    long rv = SqliteRowSet::WriteJson(out);
+    if (rv < 0)
+        pool->copyError(db);
+    release();
+    return rv;
+}
+
+}; // namespace ddb
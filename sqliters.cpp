@@ -51,15 +51,25 @@ SqliteRowSet::Query()
         db->SetLastError("Query called without bound variables.");
         return false;
     }
-    if (query.tellp() < 1) {
+    return prepare();
+}
+bool
+SqliteRowSet::prepare()
+{
+    if (query.IsEmpty()) {
         db->SetLastError("SqliteRowSet::Query - Empty query string. Aborted.");
         return false;
     }
-    if (!result_complete)
+    if (!result_complete || cached)
         Reset();
-    int rv = sqlite3_prepare_v3(db->GetConnection(), /* Database handle */
-                                query.str().c_str(), /* SQL statement, UTF-8 encoded */
-                                query.tellp(),       /* Maximum length of zSql in bytes. */
+    failed = false;
+    if (stmt) {
+        sqlite3_finalize(stmt);
+        stmt = 0;
+    }
+    int rv = sqlite3_prepare_v3(db->GetConnection(),  /* Database handle */
+                                query.GetText(),      /* SQL statement, UTF-8 encoded */
+                                query.GetLength() + 1, /* Length including the terminating zero */
                                 SQLITE_PREPARE_PERSISTENT, &stmt, /* OUT: Statement handle */
                                 0 /* OUT: Pointer to unused portion of zSql */
     );
@@ -71,6 +81,9 @@ SqliteRowSet::Query()
     }
     result_complete = false;
     row_count = 0;
+    // Time limit covers all GetNext calls of the query.
+    db->ArmTimeout();
+    deadline = db->GetDeadline();
     return true;
 }
 // -------------------------------------------------------------------------------------------------
@@ -80,9 +93,12 @@ SqliteRowSet::GetNext()
     int nField, col_type;
     BoundField* field;
 
+    if (cached)
+        return GetNextCached();
     if (result_complete == true)
         return 0;
 
+    db->ResumeTimeout(deadline);
     int rv = sqlite3_step(stmt);
     if (rv == SQLITE_DONE) {
         sqlite3_reset(stmt);
@@ -91,11 +107,13 @@ SqliteRowSet::GetNext()
     }
     if (rv == SQLITE_BUSY) {
         db->SetLastError("GetNext - BUSY");
+        failed = true;
         return 0;
     }
     if (rv != SQLITE_ROW) {
         sqlite3_reset(stmt);
         result_complete = true;
+        failed = true;
         db->SetLastError("GetNext failed:");
         db->AppendLastError(sqlite3_errstr(rv));
         return 0;
@@ -103,68 +121,108 @@ SqliteRowSet::GetNext()
     row_count++;
     bool trim = db->IsFeatureOn(FEATURE_AUTOTRIM);
     nField = 0;
-    for (field = fieldRoot; field; field = field->next) {
+    for (field = fieldRoot; field; field = field->next, nField++) {
         col_type = sqlite3_column_type(stmt, nField);
+        void* data = field->Target(col_type == SQLITE_NULL);
+        if (!data)
+            continue;
         switch (field->type) {
         case DT::INT:
             if (col_type == SQLITE_NULL)
-                *(static_cast<int*>(field->data)) = 0;
+                *(static_cast<int*>(data)) = 0;
             else
-                *(static_cast<int*>(field->data)) = sqlite3_column_int(stmt, nField);
+                *(static_cast<int*>(data)) = sqlite3_column_int(stmt, nField);
             break;
 
         case DT::LONG:
             if (col_type == SQLITE_NULL)
-                *(static_cast<int*>(field->data)) = 0;
+                *(static_cast<long*>(data)) = 0;
             else
-                *(static_cast<int*>(field->data)) = sqlite3_column_int64(stmt, nField);
+                *(static_cast<long*>(data)) = sqlite3_column_int64(stmt, nField);
             break;
 
         case DT::STR:
             if (col_type == SQLITE_NULL)
-                static_cast<string*>(field->data)->clear();
+                static_cast<string*>(data)->clear();
             else {
-                *(static_cast<string*>(field->data)) =
-                    (const char*)sqlite3_column_text(stmt, nField);
+                static_cast<string*>(data)->assign(
+                    (const char*)sqlite3_column_text(stmt, nField),
+                    sqlite3_column_bytes(stmt, nField));
                 if (trim)
-                    Database::TrimTail(static_cast<std::string*>(field->data));
+                    Database::TrimTail(static_cast<std::string*>(data));
             }
             break;
 
         case DT::BOOL:
             if (col_type == SQLITE_NULL)
-                *(static_cast<bool*>(field->data)) = false;
+                *(static_cast<bool*>(data)) = false;
             else
-                *(static_cast<bool*>(field->data)) =
-                    sqlite3_column_int(stmt, nField) == 1 ? true : false;
+                *(static_cast<bool*>(data)) = sqlite3_column_int(stmt, nField) == 1 ? true : false;
             break;
 
         case DT::TIME:
         case DT::DAY:
             if (col_type == SQLITE_NULL)
-                memset(field->data, 0, sizeof(tm));
+                memset(data, 0, sizeof(tm));
             else
-                Sqlite::ExtractTimestamp((const char*)sqlite3_column_text(stmt, nField),
-                                         (tm*)field->data);
+                Sqlite::ExtractTimestamp((const char*)sqlite3_column_text(stmt, nField), (tm*)data);
             break;
 
         case DT::NUM:
             if (col_type == SQLITE_NULL)
-                *(static_cast<double*>(field->data)) = 0;
+                *(static_cast<double*>(data)) = 0;
             else
-                *(static_cast<double*>(field->data)) = sqlite3_column_double(stmt, nField);
+                *(static_cast<double*>(data)) = sqlite3_column_double(stmt, nField);
             break;
 
         case DT::CHR:
         case DT::BIT:
             if (col_type == SQLITE_NULL)
-                *(static_cast<char*>(field->data)) = 0;
+                *(static_cast<char*>(data)) = 0;
             else
-                *(static_cast<char*>(field->data)) = *sqlite3_column_text(stmt, nField);
+                *(static_cast<char*>(data)) = *sqlite3_column_text(stmt, nField);
 
             break;
+
+        case DT::BLOB:
+            if (col_type == SQLITE_NULL)
+                *(static_cast<Blob*>(data)) = Blob();
+            else {
+                // Blob pointer first, then the size (sqlite3_column_bytes documentation).
+                const void* bytes = sqlite3_column_blob(stmt, nField);
+                *(static_cast<Blob*>(data)) = Blob(bytes, sqlite3_column_bytes(stmt, nField));
+            }
+            break;
+
+        case DT::DEC:
+            // Integers are exact. Others are parsed from the text that Sqlite gives for the value.
+            if (col_type == SQLITE_INTEGER) {
+                *(static_cast<Decimal*>(data)) = Decimal(sqlite3_column_int64(stmt, nField), 0);
+            } else if (col_type == SQLITE_NULL) {
+                *(static_cast<Decimal*>(data)) = Decimal();
+            } else if (!static_cast<Decimal*>(data)->Parse(
+                           (const char*)sqlite3_column_text(stmt, nField),
+                           sqlite3_column_bytes(stmt, nField))) {
+                // Text that is not a number, Inf and values that do not fit end the read.
+                db->SetLastError("GetNext - value does not fit into Decimal. Field ");
+                db->AppendLastError(to_string(nField + 1).c_str());
+                sqlite3_reset(stmt);
+                result_complete = true;
+                failed = true;
+                row_count--;
+                return 0;
+            }
+            break;
+
+        case DT::VEC_LONG:
+        case DT::VEC_NUM:
+        case DT::VEC_STR:
+            if (col_type == SQLITE_NULL)
+                ClearValue(field->type, data);
+            else
+                ParseArray(field->type, (const char*)sqlite3_column_text(stmt, nField), data);
+            break;
         }
-        nField++;
     }
     return nField;
 }
@@ -173,14 +231,73 @@ SqliteRowSet::GetNext()
 void
 SqliteRowSet::Reset()
 {
+    cached.reset();
     if (result_complete)
         return;
     if (stmt) {
         sqlite3_finalize(stmt);
         stmt = 0;
     }
-    result_complete = false;
+    result_complete = true;
     row_count = 0;
 }
 
+// -------------------------------------------------------------------------------------------------
+long
+SqliteRowSet::WriteJson(JsonWriter& out)
+/*!
+  Values are written by their storage class, i.e. a number stored in a TEXT column is written as
+  a string.
+*/
+{
+    if (!prepare())
+        return -1;
+    int columns = sqlite3_column_count(stmt);
+    out.BeginResult();
+    for (int col = 0; col < columns; col++)
+        out.AddColumn(sqlite3_column_name(stmt, col));
+
+    bool ok = true;
+    int rv = SQLITE_DONE;
+    while (ok && (rv = sqlite3_step(stmt)) == SQLITE_ROW) {
+        out.BeginRow();
+        for (int col = 0; col < columns; col++) {
+            switch (sqlite3_column_type(stmt, col)) {
+            case SQLITE_INTEGER:
+                out.Number((long long)sqlite3_column_int64(stmt, col));
+                break;
+            case SQLITE_FLOAT:
+                out.Number(sqlite3_column_double(stmt, col));
+                break;
+            case SQLITE_TEXT: {
+                const char* text = (const char*)sqlite3_column_text(stmt, col);
+                out.String(text, sqlite3_column_bytes(stmt, col));
+                break;
+            }
+            case SQLITE_BLOB: {
+                const void* bytes = sqlite3_column_blob(stmt, col);
+                out.Binary(bytes, sqlite3_column_bytes(stmt, col));
+                break;
+            }
+            default:
+                out.Null();
+            }
+        }
+        ok = out.EndRow();
+        row_count++;
+    }
+    sqlite3_reset(stmt);
+    result_complete = true;
+    if (ok && rv != SQLITE_DONE) {
+        db->SetLastError("WriteJson failed:");
+        db->AppendLastError(sqlite3_errstr(rv));
+        return -1;
+    }
+    if (!ok || !out.EndResult()) {
+        db->SetLastError("WriteJson - output was refused.");
+        return -1;
+    }
+    return row_count;
+}
+
 }; // namespace ddb